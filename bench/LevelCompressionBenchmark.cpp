@@ -0,0 +1,210 @@
+// Reports how well the chunked RLE + LZ tile encoding compresses levels and how fast it decodes, and
+// how much faster a screen-sized region loads than the whole level. With no arguments it generates Wolfenstein-style sample maps; otherwise it measures the given level files.
+// Usage: level-compression-benchmark [level files...]
+
+#include "LevelFile.h"
+#include "TileCompression.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <sys/stat.h>
+
+// Side of the region loaded on its own
+static const int kRegionSize = 64;
+
+static double SecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static long long FileSize(const std::string& filePath) {
+    struct stat fileStat;
+    return stat(filePath.c_str(), &fileStat) == 0 ? static_cast<long long>(fileStat.st_size) : -1;
+}
+
+static void FillRect(LevelGrid& grid, int left, int top, int width, int height, short id) {
+    for (int y = top; y < top + height; y++) {
+        for (int x = left; x < left + width; x++) {
+            grid.Set(x, y, id);
+        }
+    }
+}
+
+// Rooms of solid wall texture joined by doors, with the odd decoration and a lot of open space
+static Level MakeSampleLevel(int size, unsigned seed) {
+    std::mt19937 random(seed);
+    Level level;
+    level.grid.Reset(size, size);
+
+    const int roomSize = 16;
+    for (int roomY = 0; roomY + roomSize <= size; roomY += roomSize) {
+        for (int roomX = 0; roomX + roomSize <= size; roomX += roomSize) {
+            // About a third of the map is solid rock or outdoors, left as 0
+            if (random() % 3 == 0) {
+                continue;
+            }
+
+            short wall = static_cast<short>(1 + random() % 8);
+            FillRect(level.grid, roomX, roomY, roomSize, 1, wall);
+            FillRect(level.grid, roomX, roomY + roomSize - 1, roomSize, 1, wall);
+            FillRect(level.grid, roomX, roomY, 1, roomSize, wall);
+            FillRect(level.grid, roomX + roomSize - 1, roomY, 1, roomSize, wall);
+
+            // Doors in the middle of two walls
+            level.grid.Set(roomX + roomSize / 2, roomY, 9);
+            level.grid.Set(roomX, roomY + roomSize / 2, 9);
+
+            for (int i = 0; i < 3; i++) {
+                int x = roomX + 2 + static_cast<int>(random() % (roomSize - 4));
+                int y = roomY + 2 + static_cast<int>(random() % (roomSize - 4));
+                level.grid.Set(x, y, static_cast<short>(10 + random() % 4));
+            }
+        }
+    }
+
+    for (int i = 1; i <= 13; i++) {
+        level.textureNameToTextureIdMap["texture" + std::to_string(i)] = static_cast<short>(i);
+    }
+
+    return level;
+}
+
+static bool Measure(const std::string& name, const Level& level) {
+    std::string error;
+    std::string rawPath = "level-compression-benchmark-raw.lvl";
+    std::string compressedPath = "level-compression-benchmark-compressed.lvl";
+
+    if (!SaveLevelFile(rawPath.c_str(), level, LevelFormat::Binary, error)) {
+        fprintf(stderr, "%s\n", error.c_str());
+        return false;
+    }
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    if (!SaveLevelFile(compressedPath.c_str(), level, LevelFormat::CompressedBinary, error)) {
+        fprintf(stderr, "%s\n", error.c_str());
+        return false;
+    }
+    double saveSeconds = SecondsSince(start);
+
+    // Decode every non-empty chunk in memory, repeatedly, to get a steady throughput figure
+    const LevelGrid& grid = level.grid;
+    std::vector<std::vector<unsigned char>> payloads;
+    std::vector<TileChunkMethod> methods;
+    short tiles[kLevelChunkCells];
+
+    for (int chunkY = 0; chunkY < grid.ChunkRows(); chunkY++) {
+        for (int chunkX = 0; chunkX < grid.ChunkColumns(); chunkX++) {
+            grid.ReadChunk(chunkX, chunkY, tiles);
+            std::vector<unsigned char> payload;
+            TileChunkMethod method = EncodeTileChunk(tiles, payload);
+            if (method != TileChunkMethod_Empty) {
+                payloads.push_back(payload);
+                methods.push_back(method);
+            }
+        }
+    }
+
+    const int decodePasses = 20;
+    start = std::chrono::steady_clock::now();
+    for (int pass = 0; pass < decodePasses; pass++) {
+        for (size_t i = 0; i < payloads.size(); i++) {
+            if (!DecodeTileChunk(methods[i], payloads[i].data(), payloads[i].size(), tiles)) {
+                fprintf(stderr, "Chunk %zu failed to decode\n", i);
+                return false;
+            }
+        }
+    }
+    double decodeSeconds = SecondsSince(start) / decodePasses;
+    double decodedMegabytes = static_cast<double>(payloads.size()) * kLevelChunkCells * sizeof(short) / (1024.0 * 1024.0);
+
+    // Averaged like the region load below, so both read the file from the page cache
+    const int loadPasses = 10;
+    Level loaded;
+    start = std::chrono::steady_clock::now();
+    for (int pass = 0; pass < loadPasses; pass++) {
+        if (!LoadLevelFile(compressedPath.c_str(), loaded, error)) {
+            fprintf(stderr, "%s\n", error.c_str());
+            return false;
+        }
+    }
+    double loadSeconds = SecondsSince(start) / loadPasses;
+
+    std::vector<short> expectedRow(static_cast<size_t>(grid.Width()));
+    std::vector<short> loadedRow(static_cast<size_t>(grid.Width()));
+    for (int y = 0; y < grid.Height(); y++) {
+        const short* expected = grid.ReadRow(y, expectedRow.data());
+        const short* actual = loaded.grid.ReadRow(y, loadedRow.data());
+        if (memcmp(expected, actual, sizeof(short) * grid.Width()) != 0) {
+            fprintf(stderr, "%s: row %d differs after a round trip\n", name.c_str(), y);
+            return false;
+        }
+    }
+
+    // A screen's worth of tiles from the middle, as the editor would need to show one part of a big map
+    int regionWidth = std::min(kRegionSize, grid.Width());
+    int regionHeight = std::min(kRegionSize, grid.Height());
+    int regionX = (grid.Width() - regionWidth) / 2;
+    int regionY = (grid.Height() - regionHeight) / 2;
+    LevelGrid region;
+    start = std::chrono::steady_clock::now();
+    for (int pass = 0; pass < loadPasses; pass++) {
+        if (!LoadLevelRegion(compressedPath.c_str(), regionX, regionY, regionWidth, regionHeight, region, error)) {
+            fprintf(stderr, "%s\n", error.c_str());
+            return false;
+        }
+    }
+    double regionSeconds = SecondsSince(start) / loadPasses;
+
+    for (int y = 0; y < regionHeight; y++) {
+        for (int x = 0; x < regionWidth; x++) {
+            if (region.Get(x, y) != grid.Get(regionX + x, regionY + y)) {
+                fprintf(stderr, "%s: region tile (%d, %d) differs from the level\n", name.c_str(), x, y);
+                return false;
+            }
+        }
+    }
+
+    long long rawSize = FileSize(rawPath);
+    long long compressedSize = FileSize(compressedPath);
+
+    printf("%s (%dx%d)\n", name.c_str(), grid.Width(), grid.Height());
+    printf("  raw binary   %10lld B\n", rawSize);
+    printf("  compressed   %10lld B   ratio %.1f:1\n", compressedSize, static_cast<double>(rawSize) / compressedSize);
+    printf("  save         %8.2f ms\n", saveSeconds * 1000.0);
+    printf("  chunk decode %8.1f MiB/s  (%zu non-empty chunks)\n", decodedMegabytes / decodeSeconds, payloads.size());
+    printf("  full load    %8.2f ms\n", loadSeconds * 1000.0);
+    printf("  region load  %8.2f ms  (%dx%d, %.1fx faster than a full load)\n", regionSeconds * 1000.0, regionWidth, regionHeight,
+           loadSeconds / regionSeconds);
+
+    remove(rawPath.c_str());
+    remove(compressedPath.c_str());
+    return true;
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1) {
+        for (int i = 1; i < argc; i++) {
+            Level level;
+            std::string error;
+            if (!LoadLevelFile(argv[i], level, error)) {
+                fprintf(stderr, "%s: %s\n", argv[i], error.c_str());
+                return 1;
+            }
+
+            if (!Measure(argv[i], level)) {
+                return 1;
+            }
+        }
+        return 0;
+    }
+
+    const int sizes[] = {64, 256, 1024, 4096};
+    for (int size : sizes) {
+        if (!Measure("sample " + std::to_string(size), MakeSampleLevel(size, static_cast<unsigned>(size)))) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
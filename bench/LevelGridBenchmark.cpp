@@ -0,0 +1,142 @@
+// Compares the old jagged short** level matrix with LevelGrid.
+// Usage: level-grid-benchmark [iterations]
+
+#include "LevelGrid.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+// Rough per-allocation bookkeeping cost of a general purpose malloc on 64-bit platforms
+static const size_t kMallocOverhead = 16;
+
+static double SecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+struct JaggedMatrix {
+    JaggedMatrix(int width, int height) : width(width), height(height) {
+        rows = new short*[height];
+        for (int y = 0; y < height; y++) {
+            rows[y] = new short[width]();
+        }
+    }
+
+    ~JaggedMatrix() {
+        for (int y = 0; y < height; y++) {
+            delete[] rows[y];
+        }
+        delete[] rows;
+    }
+
+    size_t MemoryUsage() const {
+        size_t rowBytes = static_cast<size_t>(width) * sizeof(short) + kMallocOverhead;
+        return sizeof(short*) * height + kMallocOverhead + rowBytes * height;
+    }
+
+    int width;
+    int height;
+    short** rows;
+};
+
+static void Seed(short& cell, int x, int y) {
+    cell = static_cast<short>((x * 7 + y * 13) & 0x1f);
+}
+
+static void RunSize(int size, int stride, int iterations) {
+    // Allocation
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) {
+        JaggedMatrix matrix(size, size);
+    }
+    double jaggedAllocate = SecondsSince(start) / iterations;
+
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) {
+        LevelGrid grid(size, size, stride);
+    }
+    double gridAllocate = SecondsSince(start) / iterations;
+
+    JaggedMatrix matrix(size, size);
+    LevelGrid grid(size, size, stride);
+    for (int y = 0; y < size; y++) {
+        for (int x = 0; x < size; x++) {
+            Seed(matrix.rows[y][x], x, y);
+            Seed(grid.At(x, y), x, y);
+        }
+    }
+
+    // Row-major full-map pass, the access pattern of save and render
+    long long jaggedSum = 0;
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) {
+        for (int y = 0; y < size; y++) {
+            for (int x = 0; x < size; x++) {
+                jaggedSum += matrix.rows[y][x];
+            }
+        }
+    }
+    double jaggedRowMajor = SecondsSince(start) / iterations;
+
+    long long gridSum = 0;
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) {
+        for (int y = 0; y < size; y++) {
+            const short* row = grid.Row(y);
+            for (int x = 0; x < size; x++) {
+                gridSum += row[x];
+            }
+        }
+    }
+    double gridRowMajor = SecondsSince(start) / iterations;
+
+    // Column-major pass, the worst case for the row-pointer chase
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) {
+        for (int x = 0; x < size; x++) {
+            for (int y = 0; y < size; y++) {
+                jaggedSum += matrix.rows[y][x];
+            }
+        }
+    }
+    double jaggedColumnMajor = SecondsSince(start) / iterations;
+
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) {
+        for (int x = 0; x < size; x++) {
+            for (int y = 0; y < size; y++) {
+                gridSum += grid.At(x, y);
+            }
+        }
+    }
+    double gridColumnMajor = SecondsSince(start) / iterations;
+
+    if (jaggedSum != gridSum) {
+        fprintf(stderr, "Checksum mismatch at %dx%d\n", size, size);
+        exit(1);
+    }
+
+    printf("%dx%d, stride %d\n", size, size, grid.Stride());
+    printf("  memory       jagged %10zu B (%d allocations)   grid %10zu B (1 allocation)\n",
+           matrix.MemoryUsage(), size + 1, grid.MemoryUsage());
+    printf("  allocate     jagged %8.3f ms   grid %8.3f ms\n", jaggedAllocate * 1000.0, gridAllocate * 1000.0);
+    printf("  row-major    jagged %8.3f ms   grid %8.3f ms   (%.2fx)\n",
+           jaggedRowMajor * 1000.0, gridRowMajor * 1000.0, jaggedRowMajor / gridRowMajor);
+    printf("  column-major jagged %8.3f ms   grid %8.3f ms   (%.2fx)\n",
+           jaggedColumnMajor * 1000.0, gridColumnMajor * 1000.0, jaggedColumnMajor / gridColumnMajor);
+}
+
+int main(int argc, char** argv) {
+    int iterations = argc > 1 ? atoi(argv[1]) : 10;
+    if (iterations < 1) {
+        iterations = 1;
+    }
+
+    // The default stride pads these sizes by a cache line; the unpadded run shows what that avoids
+    const int sizes[] = {256, 1024, 2048};
+    for (int size : sizes) {
+        RunSize(size, 0, iterations);
+        RunSize(size, size, iterations);
+    }
+
+    return 0;
+}
@@ -0,0 +1,127 @@
+// Compares the old std::ofstream/std::endl level writer with the buffered text writer,
+// and checks that both produce the same bytes.
+// Usage: level-writer-benchmark [output directory]
+
+#include "LevelFile.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <random>
+
+static double SecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// The text writer as it was in Application::SaveLevel
+static bool SaveLevelWithOfstream(const char* filePath, const Level& level) {
+    std::ofstream outfile(filePath);
+    if (!outfile) {
+        return false;
+    }
+
+    const LevelGrid& grid = level.grid;
+    outfile << grid.Width() << " " << grid.Height() << std::endl;
+    for (int y = 0; y < grid.Height(); y++) {
+        for (int x = 0; x < grid.Width(); x++) {
+            outfile << grid.At(x, y) << (x < grid.Width() - 1 ? " " : "");
+        }
+
+        outfile << std::endl;
+    }
+
+    outfile << level.enemySpawnLocations.size() << std::endl;
+    for (const EnemySpawnLocation& location : level.enemySpawnLocations) {
+        outfile << location.textureId << " " << location.x << " " << location.y << std::endl;
+    }
+
+    std::map<short, std::string> reversedMap;
+    for (const auto& entry : level.textureNameToTextureIdMap) {
+        reversedMap[entry.second] = entry.first;
+    }
+
+    for (const auto& entry: reversedMap) {
+        outfile << entry.first << " " << entry.second << std::endl;
+    }
+
+    return static_cast<bool>(outfile);
+}
+
+static std::string ReadWholeFile(const std::string& filePath) {
+    std::ifstream infile(filePath, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(infile), std::istreambuf_iterator<char>());
+}
+
+static Level MakeLevel(int size) {
+    std::mt19937 random(static_cast<unsigned>(size));
+    std::uniform_int_distribution<int> tile(0, 63);
+    std::uniform_real_distribution<float> coordinate(0.0f, static_cast<float>(size));
+
+    Level level;
+    level.grid.Reset(size, size);
+    for (int y = 0; y < size; y++) {
+        for (int x = 0; x < size; x++) {
+            level.grid.At(x, y) = static_cast<short>(tile(random));
+        }
+    }
+
+    for (int i = 0; i < 256; i++) {
+        EnemySpawnLocation location;
+        location.textureId = i % 8;
+        location.x = i % 2 == 0 ? static_cast<float>(i) : coordinate(random);
+        location.y = coordinate(random);
+        level.enemySpawnLocations.push_back(location);
+    }
+
+    for (int i = 1; i < 64; i++) {
+        level.textureNameToTextureIdMap["texture" + std::to_string(i)] = static_cast<short>(i);
+    }
+
+    return level;
+}
+
+int main(int argc, char** argv) {
+    std::string directory = argc > 1 ? argv[1] : ".";
+    std::string oldPath = directory + "/level-writer-benchmark-ofstream.lvl";
+    std::string newPath = directory + "/level-writer-benchmark-buffered.lvl";
+
+    const int sizes[] = {1024, 4096};
+    for (int size : sizes) {
+        Level level = MakeLevel(size);
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        if (!SaveLevelWithOfstream(oldPath.c_str(), level)) {
+            fprintf(stderr, "Could not write %s\n", oldPath.c_str());
+            return 1;
+        }
+        double ofstreamSeconds = SecondsSince(start);
+
+        std::string error;
+        start = std::chrono::steady_clock::now();
+        if (!SaveLevelFile(newPath.c_str(), level, LevelFormat::Text, error)) {
+            fprintf(stderr, "%s\n", error.c_str());
+            return 1;
+        }
+        double bufferedSeconds = SecondsSince(start);
+
+        std::string oldBytes = ReadWholeFile(oldPath);
+        bool identical = oldBytes == ReadWholeFile(newPath);
+        double megabytes = static_cast<double>(oldBytes.size()) / (1024.0 * 1024.0);
+
+        printf("%dx%d (%.1f MiB)\n", size, size, megabytes);
+        printf("  ofstream %8.1f ms  %7.1f MiB/s\n", ofstreamSeconds * 1000.0, megabytes / ofstreamSeconds);
+        printf("  buffered %8.1f ms  %7.1f MiB/s  (%.1fx)\n", bufferedSeconds * 1000.0, megabytes / bufferedSeconds,
+               ofstreamSeconds / bufferedSeconds);
+        printf("  output %s\n", identical ? "identical" : "DIFFERS");
+
+        if (!identical) {
+            return 1;
+        }
+    }
+
+    remove(oldPath.c_str());
+    remove(newPath.c_str());
+
+    return 0;
+}
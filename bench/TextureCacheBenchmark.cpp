@@ -0,0 +1,166 @@
+// Compares opening a sprite pack by decoding every PNG against reading the decoded pixels back from a TextureCache.
+// With no arguments it generates sample sprites; otherwise it uses the given PNG files.
+// Usage: texture-cache-benchmark [png files...]
+//
+// The generated sprites are stored uncompressed, which makes them quicker to decode than a real pack's,
+// so the speedup they show is a lower bound.
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+#include "ContentHash.h"
+#include "PngWriter.h"
+#include "TextureCache.h"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <sys/stat.h>
+#include <vector>
+
+static const int kSampleSpriteCount = 1000;
+static const int kSampleSpriteSize = 128;
+
+static double SecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static uint32_t AverageColor(const unsigned char* pixels, int width, int height) {
+    size_t pixelCount = static_cast<size_t>(width) * height;
+    uint64_t sums[4] = {0, 0, 0, 0};
+    for (size_t i = 0; i < pixelCount * 4; i++) {
+        sums[i % 4] += pixels[i];
+    }
+
+    uint32_t average = 0;
+    for (int channel = 0; channel < 4; channel++) {
+        average |= static_cast<uint32_t>(sums[channel] / pixelCount) << (channel * 8);
+    }
+    return average;
+}
+
+// Brick-ish tiles with a per-sprite tint, so no two files are the same
+static bool MakeSampleSprites(const std::string& directory, std::vector<std::string>& paths) {
+    mkdir(directory.c_str(), 0755);
+
+    std::vector<unsigned char> pixels(static_cast<size_t>(kSampleSpriteSize) * kSampleSpriteSize * 4);
+    for (int sprite = 0; sprite < kSampleSpriteCount; sprite++) {
+        for (int y = 0; y < kSampleSpriteSize; y++) {
+            for (int x = 0; x < kSampleSpriteSize; x++) {
+                unsigned char* pixel = &pixels[(static_cast<size_t>(y) * kSampleSpriteSize + x) * 4];
+                bool mortar = y % 16 == 0 || (x + (y / 16 % 2) * 16) % 32 == 0;
+                pixel[0] = static_cast<unsigned char>(mortar ? 90 : 140 + (x * 7 + y * 13 + sprite) % 60);
+                pixel[1] = static_cast<unsigned char>(mortar ? 90 : 60 + (x * 3 + sprite * 5) % 40);
+                pixel[2] = static_cast<unsigned char>(mortar ? 90 : 40 + (y * 5 + sprite * 3) % 30);
+                pixel[3] = 255;
+            }
+        }
+
+        std::string path = directory + "/sprite" + std::to_string(sprite) + ".png";
+        std::string error;
+        if (!WritePng(path.c_str(), pixels.data(), kSampleSpriteSize, kSampleSpriteSize, kSampleSpriteSize * 4, error)) {
+            fprintf(stderr, "%s\n", error.c_str());
+            return false;
+        }
+        paths.push_back(path);
+    }
+
+    return true;
+}
+
+int main(int argc, char** argv) {
+    std::vector<std::string> paths;
+    for (int i = 1; i < argc; i++) {
+        paths.push_back(argv[i]);
+    }
+
+    if (paths.empty() && !MakeSampleSprites("texture-cache-benchmark-sprites", paths)) {
+        return 1;
+    }
+
+    const std::string cachePath = "texture-cache-benchmark.pack";
+    remove(cachePath.c_str());
+
+    // Every variant copies the pixels out once, standing in for the upload to the atlas
+    std::vector<unsigned char> staging;
+    size_t pixelBytes = 0;
+
+    // Decoding alone, as the editor did before the cache
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (const std::string& path : paths) {
+        int width, height, channels;
+        unsigned char* pixels = stbi_load(path.c_str(), &width, &height, &channels, 4);
+        if (pixels == nullptr) {
+            fprintf(stderr, "%s: %s\n", path.c_str(), stbi_failure_reason());
+            return 1;
+        }
+
+        size_t size = static_cast<size_t>(width) * height * 4;
+        staging.assign(pixels, pixels + size);
+        AverageColor(pixels, width, height);
+        pixelBytes += size;
+        stbi_image_free(pixels);
+    }
+    double decodeSeconds = SecondsSince(start);
+
+    // Cold start: decode and fill the cache
+    std::string error;
+    TextureCache cache;
+    start = std::chrono::steady_clock::now();
+    if (!cache.Open(cachePath, error)) {
+        fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+
+    for (const std::string& path : paths) {
+        int width, height, channels;
+        unsigned char* pixels = stbi_load(path.c_str(), &width, &height, &channels, 4);
+        if (pixels == nullptr) {
+            fprintf(stderr, "%s: %s\n", path.c_str(), stbi_failure_reason());
+            return 1;
+        }
+
+        staging.assign(pixels, pixels + static_cast<size_t>(width) * height * 4);
+        // Hashed the way the editor's decode workers hash pixels for deduplication
+        uint64_t pixelHash = ContentHash64(pixels, static_cast<size_t>(width) * height * 4, static_cast<uint64_t>(width) << 32 | static_cast<uint32_t>(height));
+        if (!cache.Add(path, pixels, width, height, channels, AverageColor(pixels, width, height), pixelHash, error)) {
+            fprintf(stderr, "%s\n", error.c_str());
+            stbi_image_free(pixels);
+            return 1;
+        }
+        stbi_image_free(pixels);
+    }
+    cache.Close();
+    double coldSeconds = SecondsSince(start);
+
+    // Warm start: map the pack and read every image straight out of it
+    start = std::chrono::steady_clock::now();
+    if (!cache.Open(cachePath, error)) {
+        fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+
+    size_t hits = 0;
+    for (const std::string& path : paths) {
+        CachedTexture texture;
+        if (cache.Find(path, texture)) {
+            staging.assign(texture.pixels, texture.pixels + static_cast<size_t>(texture.width) * texture.height * 4);
+            hits++;
+        }
+    }
+    double warmSeconds = SecondsSince(start);
+    uint64_t packSize = cache.FileSize();
+    cache.Close();
+
+    if (hits != paths.size()) {
+        fprintf(stderr, "Only %zu of %zu images were found in the cache\n", hits, paths.size());
+        return 1;
+    }
+
+    printf("%zu images, %.1f MiB of pixels, %.1f MiB pack\n", paths.size(), pixelBytes / (1024.0 * 1024.0), packSize / (1024.0 * 1024.0));
+    printf("  decode only  %8.2f ms\n", decodeSeconds * 1000.0);
+    printf("  cold start   %8.2f ms  (decode and write the cache)\n", coldSeconds * 1000.0);
+    printf("  warm start   %8.2f ms  (map the cache, %.1fx faster than decoding)\n", warmSeconds * 1000.0, decodeSeconds / warmSeconds);
+
+    remove(cachePath.c_str());
+    return 0;
+}
@@ -1,190 +1,718 @@
 #include "Application.h"
+#include "PngWriter.h"
 #include "Texture.h"
 #include "imgui.h"
+#include "imgui_internal.h"
 #include "imgui_impl_sdl2.h"
 #include "imgui_impl_sdlrenderer.h"
 #include "portable-file-dialogs.h"
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
+#include <algorithm>
+#include <cerrno>
+#include <cfloat>
+#include <cstdint>
 #include <cstdio>
-#include <fstream>
+#include <cstring>
 #include <SDL.h>
+#include <sys/stat.h>
+
+// A texture loaded from a folder is named by its path below the folder, so "walls/brick.png" and
+// "floors/brick.png" stay apart; any other texture by its file name alone
+static std::string TextureNameFromPath(const std::string& path, const std::string& folder = std::string()) {
+    std::string textureName(path);
+
+    std::string folderPrefix = folder.empty() || folder.back() == '/' ? folder : folder + "/";
+    if (!folder.empty() && textureName.compare(0, folderPrefix.size(), folderPrefix) == 0) {
+        textureName.erase(0, folderPrefix.size());
+    } else {
+        size_t lastSlashPos = textureName.find_last_of('/');
+        textureName.erase(0, lastSlashPos + 1);// Remove everything before the last slash, so "../" doesn't count as an extension
+    }
+
+    size_t fileNamePos = textureName.find_last_of('/');
+    size_t periodPos = textureName.find('.', fileNamePos == std::string::npos ? 0 : fileNamePos + 1);
+    if (periodPos != std::string::npos) {
+        textureName.erase(periodPos);// Remove characters after the period
+    }
+
+    return textureName;
+}
 
-// Dear ImGui uses SDL_Texture* as ImTextureID
 bool Application::LoadTextureFromFile(Texture& texture, const char* fileName) {
+    DecodedTexture decoded;
+    decoded.path = fileName;
+    if (!DecodeTexture(decoded)) {
+        texture.id = -1;
+        texture.averageColor = IM_COL32_WHITE;
+        fprintf(stderr, "Failed to load image: %s\n", decoded.error.c_str());
+        return false;
+    }
+
+    return CreateTexture(texture, decoded);
+}
+
+// Dear ImGui uses SDL_Texture* as ImTextureID; every tile image is a region of one of the atlas pages
+bool Application::CreateTexture(Texture& texture, const DecodedTexture& decoded) {
+    const char* fileName = decoded.path.c_str();
     texture.id = -1;
+    texture.width = decoded.width;
+    texture.height = decoded.height;
+    texture.channels = decoded.channels;
+    texture.averageColor = decoded.averageColor;
 
-    unsigned char* data = stbi_load(fileName, &texture.width, &texture.height, &texture.channels, 0);
+    if (!textureAtlas.Add(decoded.pixels, texture.width, texture.height, texture.atlasRegion)) {
+        fprintf(stderr, "Failed to add %s to the texture atlas\n", fileName);
+    }
 
-    if (data == nullptr) {
-        fprintf(stderr, "Failed to load image: %s\n", stbi_failure_reason());
-        return false;
+    std::string textureName = TextureNameFromPath(fileName);
+
+    fprintf(stdout, "Texture name: %s\n", textureName.c_str());
+
+    texture.name = textureName;
+
+    if (level.textureNameToTextureIdMap.count(textureName) == 1) {
+        texture.id = level.textureNameToTextureIdMap[textureName];
     }
 
-    SDL_Surface* surface = SDL_CreateRGBSurfaceFrom((void*)data, texture.width, texture.height, texture.channels * 8, texture.channels * texture.width,
-                                                    0x000000ff, 0x0000ff00, 0x00ff0000, 0xff000000);
+    return true;
+}
+
+void Application::RegisterTextures(const std::vector<std::string>& paths, const std::string& folder) {
+    const TileTexture& fallback = textureRegistry.Fallback();
+    bool assigned = false;
 
-    if (surface == nullptr) {
-        fprintf(stderr, "Failed to create SDL surface: %s\n", SDL_GetError());
-        return false;
+    for (const std::string& path : paths) {
+        Texture texture = Texture();
+        texture.id = -1;
+        texture.name = TextureNameFromPath(path, folder);
+        if (texture.name == "fallback" || textureStreamer.Find(path) >= 0) {
+            continue;
+        }
+
+        // Levels refer to textures by name, so a second texture with the same one couldn't be told apart
+        if (!textureNames.insert(texture.name).second) {
+            fprintf(stderr, "Skipping %s: a texture named \"%s\" is already loaded\n", path.c_str(), texture.name.c_str());
+            continue;
+        }
+
+        texture.streamIndex = textureStreamer.Register(path);
+        texture.atlasRegion = fallback.atlasRegion;
+        texture.averageColor = fallback.averageColor;
+
+        std::map<std::string, short>::const_iterator id = level.textureNameToTextureIdMap.find(texture.name);
+        if (id != level.textureNameToTextureIdMap.end()) {
+            texture.id = id->second;
+            textureRegistry.Assign(texture.id, texture);
+            assigned = true;
+        } else {
+            palette.AddUnassigned(texture);
+        }
+        textures.push_back(texture);
     }
 
-    texture.sdlTexture = SDL_CreateTextureFromSurface(texture.sdlRenderer, surface);
+    if (assigned) {
+        tileMapView.InvalidateAll();
+    }
+}
 
-    if (texture.sdlTexture == nullptr) {
-        fprintf(stderr, "Failed to create SDL texture: %s\n", SDL_GetError());
+void Application::LoadTextureFolder(const std::string& folder) {
+    std::vector<std::string> paths;
+    std::string error;
+    if (!textureFolderWatcher.Open(folder, paths, error)) {
+        fprintf(stderr, "Error loading texture folder: %s\n", error.c_str());
+        return;
     }
 
-    SDL_FreeSurface(surface);
-    stbi_image_free(data);
+    RegisterTextures(paths, textureFolderWatcher.Folder());
+}
 
-    std::string textureName(fileName);
+void Application::PollTextureFolder() {
+    std::vector<std::string> added;
+    std::vector<std::string> changed;
+    textureFolderWatcher.Poll(added, changed);
 
-    size_t periodPos = textureName.find('.');
-    textureName.erase(periodPos);// Remove characters after the period
+    for (const std::string& path : changed) {
+        int index = textureStreamer.Find(path);
+        if (index >= 0) {
+            textureStreamer.Reload(index);
+        } else {
+            added.push_back(path);
+        }
+    }
+    RegisterTextures(added, textureFolderWatcher.Folder());
+}
 
-    size_t lastSlashPos = textureName.find_last_of('/');
-    textureName.erase(0, lastSlashPos + 1);// Remove everything before the last slash
+void Application::UpdateTextureStreaming() {
+    changedTextures.clear();
+    textureStreamer.Update(kTextureUploadBudgetMs, options.headless, changedTextures);
+    if (changedTextures.empty()) {
+        return;
+    }
 
-    fprintf(stdout, "Texture name: %s\n", textureName.c_str());
+    // The streamer's indices are positions in textures, since RegisterTextures registers in step
+    std::vector<bool> changed(textures.size(), false);
+    for (int index : changedTextures) {
+        Texture& texture = textures[static_cast<size_t>(index)];
+        texture.atlasRegion = textureStreamer.Region(index);
+        texture.averageColor = textureStreamer.AverageColor(index);
+        changed[static_cast<size_t>(index)] = true;
+    }
 
-    texture.name = textureName;
+    // The registry keeps its own copies for the map view; the palette asks the streamer directly
+    changedRegionIds.clear();
+    changedColorIds.clear();
+    for (int id = 0; id < textureRegistry.IdLimit(); id++) {
+        if (!textureRegistry.IsAssigned(static_cast<short>(id))) {
+            continue;
+        }
 
-    if (textureNameToTextureIdMap.count(textureName) == 1) {
-        texture.id = textureNameToTextureIdMap[textureName];
+        const Texture& assigned = textureRegistry.Get(static_cast<short>(id));
+        if (assigned.streamIndex < 0 || !changed[static_cast<size_t>(assigned.streamIndex)]) {
+            continue;
+        }
+
+        const Texture& texture = textures[static_cast<size_t>(assigned.streamIndex)];
+        if (texture.atlasRegion.texture != assigned.atlasRegion.texture || !SDL_RectEquals(&texture.atlasRegion.rect, &assigned.atlasRegion.rect)) {
+            changedRegionIds.push_back(static_cast<short>(id));
+        }
+        if (texture.averageColor != assigned.averageColor) {
+            changedColorIds.push_back(static_cast<short>(id));
+        }
+        textureRegistry.Assign(static_cast<short>(id), texture);
     }
 
-    return true;
+    // Only the cells showing these ids are redrawn, instead of the whole map
+    tileMapView.InvalidateTileTextures(level.grid, changedRegionIds);
+    if (!changedColorIds.empty()) {
+        tileMapView.InvalidateTileColors(changedColorIds);
+    }
+}
+
+void Application::MarkVisibleMapTextures() {
+    // The overview draws every tile as its texture's average colour, so those are wanted even though
+    // no tile is drawn with its texture
+    if (tileMapView.OverviewLevel() >= 0) {
+        for (int id = 0; id < textureRegistry.IdLimit(); id++) {
+            if (textureRegistry.IsAssigned(static_cast<short>(id))) {
+                textureStreamer.RequestAverageColor(textureRegistry.Get(static_cast<short>(id)).streamIndex);
+            }
+        }
+        return;
+    }
+
+    tileMapView.CollectVisibleTileIds(level.grid, visibleTileIds);
+    for (short id : visibleTileIds) {
+        if (textureRegistry.IsAssigned(id)) {
+            textureStreamer.MarkVisible(textureRegistry.Get(id).streamIndex);
+        }
+    }
 }
 
 void Application::ReassignTextures() {
     for (const auto& texture : textures) {
-        if (textureNameToTextureIdMap.count(texture.name) == 1) {
-            textureIdToTextureMap[textureNameToTextureIdMap[texture.name]] = texture;
+        if (level.textureNameToTextureIdMap.count(texture.name) == 1) {
+            textureRegistry.Assign(level.textureNameToTextureIdMap[texture.name], texture);
         } else {
-            unassignedTextures.push_back(texture);
+            palette.AddUnassigned(texture);
         }
     }
+
+    tileMapView.InvalidateAll();
 }
 
-void Application::AssignNewTextures() {
-    for (const auto& texture : textures) {
-        if (texture.id != -1) {
-            textureIdToTextureMap[texture.id] = texture;
+void Application::ResetLevelGrid() {
+    level.grid.Reset(mapWidth, mapHeight, sparseLevelStorage ? LevelGridLayout::Chunked : LevelGridLayout::Dense);
+    tileMapView.InvalidateAll();
+}
+
+void Application::NewLevel() {
+    journal.Close();
+    history.Clear();
+    levelFilePath.clear();
+    levelGeneration++;
+
+    ResetLevelGrid();
+    tileMapView.FitToMap();
+}
+
+void Application::SetTile(int x, int y, short id) {
+    short before = level.grid.Get(x, y);
+    if (before == id || !level.grid.InBounds(x, y)) {
+        return;
+    }
+
+    history.RecordCell(x, y, before, id);
+    ApplyTile(x, y, id);
+}
+
+void Application::FillLevel(short id) {
+    ProfileScope zone(profiler, "Fill level");
+
+    for (int y = 0; y < level.grid.Height(); y++) {
+        for (int x = 0; x < level.grid.Width(); x++) {
+            SetTile(x, y, id);
         }
     }
+
+    // A fill is one undo step on its own, whatever else is being edited
+    history.Commit();
 }
 
-void Application::ResetLevelMatrix() {
-    levelMatrix = new short*[mapHeight];
+// Cells restored by undo and redo are invalidated one by one in ApplyTile; only a command that
+// remapped texture names needs the registry and palette rebuilt
+void Application::Undo() {
+    textureNamesChanged = false;
+    if (history.Undo(*this) && textureNamesChanged) {
+        textureRegistry.Clear();
+        palette.ClearUnassigned();
+        ReassignTextures();
+    }
+}
 
-    for (int i = 0; i < mapHeight; i++) {
-        levelMatrix[i] = new short[mapWidth];
+void Application::Redo() {
+    textureNamesChanged = false;
+    if (history.Redo(*this) && textureNamesChanged) {
+        textureRegistry.Clear();
+        palette.ClearUnassigned();
+        ReassignTextures();
     }
 }
 
-void Application::NewLevel() {
-    ResetLevelMatrix();
+void Application::ApplyTile(int x, int y, short id) {
+    if (level.grid.Set(x, y, id)) {
+        journal.RecordCell(x, y, id);
+        tileMapView.InvalidateCell(x, y);
+    }
+}
+
+void Application::ApplySpawn(size_t index, const EnemySpawnLocation& location) {
+    if (index == level.enemySpawnLocations.size()) {
+        level.enemySpawnLocations.push_back(location);
+    } else {
+        level.enemySpawnLocations[index] = location;
+    }
+
+    journal.RecordSpawn(index, location);
+}
+
+void Application::RemoveLastSpawn() {
+    level.enemySpawnLocations.pop_back();
+    journal.RecordSpawnCount(level.enemySpawnLocations.size());
+}
+
+void Application::ApplyTextureName(const std::string& name, short id) {
+    level.textureNameToTextureIdMap[name] = id;
+    journal.RecordTextureName(name, id);
+    textureNamesChanged = true;
+}
+
+void Application::RemoveTextureName(const std::string& name) {
+    level.textureNameToTextureIdMap.erase(name);
+    journal.RecordTextureNameRemoval(name);
+    textureNamesChanged = true;
+}
+
+void Application::UpdateJournal() {
+    Uint32 now = SDL_GetTicks();
+    if (journal.HasPendingEdits() && now - lastJournalFlushTicks >= kJournalFlushIntervalMs) {
+        std::string error;
+        if (!journal.Flush(error)) {
+            fprintf(stderr, "Error writing edit journal: %s\n", error.c_str());
+        }
+        lastJournalFlushTicks = now;
+    }
+
+    // Fold a long journal back into the level file so replaying it stays quick, but don't start a
+    // save every frame while saving fails
+    bool retryDue = !lastSaveFailed || now - lastSaveFailureTicks >= kJournalCompactionRetryMs;
+    if (journal.IsOpen() && journal.Size() > kJournalCompactionSize && !levelSaver.IsSaving() && retryDue) {
+        SaveLevel(levelFilePath.c_str(), levelFileFormat);
+    }
+}
+
+void Application::RequestRedraw(Uint32 delayMs) {
+    Uint32 ticks = SDL_GetTicks() + delayMs;
+    if (!redrawRequested || SDL_TICKS_PASSED(redrawTicks, ticks)) {
+        redrawTicks = ticks;
+        redrawRequested = true;
+    }
+}
+
+bool Application::WaitForRedraw(SDL_Event& event) {
+    if (!redrawRequested) {
+        return SDL_WaitEvent(&event) == 1;
+    }
+
+    Uint32 now = SDL_GetTicks();
+    if (!SDL_TICKS_PASSED(now, redrawTicks) && SDL_WaitEventTimeout(&event, static_cast<int>(redrawTicks - now)) == 1) {
+        return true;
+    }
+
+    return false;
+}
+
+void Application::UpdateCpuUsage() {
+    Uint32 now = SDL_GetTicks();
+    if (now - cpuSampleTicks < 1000) {
+        return;
+    }
+
+    std::clock_t clock = std::clock();
+    if (cpuSampleTicks != 0) {
+        double cpuSeconds = static_cast<double>(clock - cpuSampleClock) / CLOCKS_PER_SEC;
+        cpuUsage = static_cast<float>(cpuSeconds * 1000.0 / (now - cpuSampleTicks));
+    }
+
+    cpuSampleClock = clock;
+    cpuSampleTicks = now;
 }
 
-bool Application::SaveLevel(const char* filePath) {
+void Application::DrawProfiler() {
+    if (!showProfiler) {
+        return;
+    }
+
+    if (ImGui::Begin("Profiler", &showProfiler)) {
+        int count = profiler.HistoryCount();
+        int offset = profiler.HistoryOffset();
+        ImVec2 plotSize(0.0f, 48.0f);
+        char overlay[64];
+
+        ImGui::Text("Frame time p50 %.2f ms, p99 %.2f ms over %d frames", profiler.FrameTimePercentile(0.5f), profiler.FrameTimePercentile(0.99f), count);
+        snprintf(overlay, sizeof(overlay), "max %.2f ms", profiler.FrameTimePercentile(1.0f));
+        ImGui::PlotHistogram("Frame", profiler.FrameTimes().data(), count, offset, overlay, 0.0f, FLT_MAX, plotSize);
+
+        for (const FrameProfiler::Phase& phase : profiler.Phases()) {
+            float total = 0.0f;
+            for (int i = 0; i < count; i++) {
+                total += phase.times[i];
+            }
+            snprintf(overlay, sizeof(overlay), "avg %.3f ms", count > 0 ? total / count : 0.0f);
+            ImGui::PlotHistogram(phase.name, phase.times.data(), count, offset, overlay, 0.0f, FLT_MAX, plotSize);
+        }
+    }
+    ImGui::End();
+}
+
+void Application::ExportFrameTrace() {
+    pfd::save_file traceFileDialog = pfd::save_file("Export frame trace", "", {"Trace Files", "*.json"});
+    if (traceFileDialog.result().empty()) {
+        return;
+    }
+
+    std::string error;
+    if (!profiler.WriteChromeTrace(traceFileDialog.result().c_str(), kProfilerTraceSeconds, error)) {
+        fprintf(stderr, "%s\n", error.c_str());
+    }
+}
+
+bool Application::SaveLevel(const char* filePath, LevelFormat format) {
+    ProfileScope zone(profiler, "Save level");
+
     assert(mapWidth >= 3);
     assert(mapHeight >= 3);
 
-    std::ofstream outfile(filePath);
-    if (!outfile) {
-        fprintf(stderr, "Error saving level: %s\n", filePath);
+    if (filePath[0] == '\0') {
         return false;
     }
 
-    outfile << mapWidth << " " << mapHeight << std::endl;
-    for (size_t y = 0; y < mapHeight; y++) {
-        for (size_t x = 0; x < mapWidth; x++) {
-            outfile << levelMatrix[y][x] << (x < mapHeight - 1 ? " " : "");
-        }
+    std::string error;
+    if (!journal.Flush(error)) {
+        fprintf(stderr, "Error writing edit journal: %s\n", error.c_str());
+    }
 
-        outfile << std::endl;
+    // The worker writes a copy, so editing can carry on. Dense grids are copied outright;
+    // chunked grids share their chunks until the editor next writes to one.
+    if (!levelSaver.Start(level, filePath, format)) {
+        fprintf(stderr, "Error saving level: a save to %s is still running\n", levelSaver.FilePath().c_str());
+        return false;
     }
 
-    outfile <<  enemySpawnLocations.size() << std::endl;
-    for (int i = 0; i < enemySpawnLocations.size(); i++) {
-        EnemySpawnLocation& location = enemySpawnLocations[i];
-        outfile << location.textureId << " " << location.x << " " << location.y << std::endl;
+    // Edits journaled from here on aren't in the snapshot and have to survive the save
+    saveJournalOffset = journal.Size();
+    saveLevelGeneration = levelGeneration;
+    saveStatus.clear();
+    return true;
+}
+
+void Application::PollLevelSave() {
+    bool succeeded = false;
+    std::string error;
+    if (!levelSaver.Poll(succeeded, error)) {
+        return;
     }
 
-    std::map<short, std::string> reversedMap;
+    lastSaveFailed = !succeeded;
+    if (succeeded) {
+        saveStatus = "Saved " + levelSaver.FilePath();
 
-    for (const auto& entry : textureNameToTextureIdMap) {
-        reversedMap[entry.second] = entry.first;
+        // The level that was saved is still the one being edited, so its journal moves to the saved file
+        if (saveLevelGeneration == levelGeneration) {
+            levelFilePath = levelSaver.FilePath();
+            levelFileFormat = levelSaver.Format();
+            if (!journal.Rebase(levelFilePath, saveJournalOffset, error)) {
+                fprintf(stderr, "Error starting edit journal: %s\n", error.c_str());
+            }
+        }
+    } else {
+        fprintf(stderr, "Error saving level: %s\n", error.c_str());
+        saveStatus = "Save failed: " + error;
+        lastSaveFailureTicks = SDL_GetTicks();
     }
+}
 
-    for (const auto& entry: reversedMap) {
-        outfile << entry.first << " " << entry.second << std::endl;
+void Application::RegisterLevelCameraSettings() {
+    ImGuiSettingsHandler handler;
+    handler.TypeName = "LevelCamera";
+    handler.TypeHash = ImHashStr(handler.TypeName);
+    handler.UserData = this;
+
+    handler.ReadOpenFn = [](ImGuiContext*, ImGuiSettingsHandler* handler, const char* name) -> void* {
+        Application* application = static_cast<Application*>(handler->UserData);
+        return &application->levelCameras[name];
+    };
+
+    handler.ReadLineFn = [](ImGuiContext*, ImGuiSettingsHandler*, void* entry, const char* line) {
+        MapCamera* camera = static_cast<MapCamera*>(entry);
+        float value;
+        if (sscanf(line, "X=%f", &value) == 1) {
+            camera->x = value;
+        } else if (sscanf(line, "Y=%f", &value) == 1) {
+            camera->y = value;
+        } else if (sscanf(line, "Zoom=%f", &value) == 1) {
+            camera->zoom = value;
+        }
+    };
+
+    handler.WriteAllFn = [](ImGuiContext*, ImGuiSettingsHandler* handler, ImGuiTextBuffer* buffer) {
+        const Application* application = static_cast<const Application*>(handler->UserData);
+        for (const auto& entry : application->levelCameras) {
+            buffer->appendf("[%s][%s]\n", handler->TypeName, entry.first.c_str());
+            buffer->appendf("X=%g\nY=%g\nZoom=%g\n\n", entry.second.x, entry.second.y, entry.second.zoom);
+        }
+    };
+
+    ImGui::AddSettingsHandler(&handler);
+}
+
+void Application::RememberLevelCamera() {
+    if (levelFilePath.empty()) {
+        return;
     }
 
-    return true;
+    const MapCamera& camera = tileMapView.Camera();
+    MapCamera& saved = levelCameras[levelFilePath];
+    if (saved.x != camera.x || saved.y != camera.y || saved.zoom != camera.zoom) {
+        saved = camera;
+        ImGui::MarkIniSettingsDirty();
+    }
 }
 
-bool Application::LoadLevel(const char* filePath) {
-    std::ifstream infile(filePath);
-    if (!infile) {
-        fprintf(stderr, "Error loading level: %s\n", filePath);
+void Application::PlaceHeadlessWindow(float x, float y, float width, float height) {
+    if (!options.headless) {
+        return;
+    }
+
+    // Fractions of the work area below the main menu bar
+    const ImGuiViewport* viewport = ImGui::GetMainViewport();
+    ImGui::SetNextWindowPos(ImVec2(viewport->WorkPos.x + viewport->WorkSize.x * x, viewport->WorkPos.y + viewport->WorkSize.y * y));
+    ImGui::SetNextWindowSize(ImVec2(viewport->WorkSize.x * width, viewport->WorkSize.y * height));
+    ImGui::SetNextWindowCollapsed(false);
+}
+
+bool Application::CaptureFrame(SDL_Renderer* renderer, int frame) {
+    ProfileScope zone(profiler, "Capture");
+
+    int width = 0;
+    int height = 0;
+    if (SDL_GetRendererOutputSize(renderer, &width, &height) != 0 || width <= 0 || height <= 0) {
+        fprintf(stderr, "Error capturing frame %d: %s\n", frame, SDL_GetError());
         return false;
     }
 
-    infile >> mapWidth;
-    infile >> mapHeight;
+    std::vector<unsigned char> pixels(static_cast<size_t>(width) * height * 4);
+    int pitch = width * 4;
+    if (SDL_RenderReadPixels(renderer, nullptr, SDL_PIXELFORMAT_RGBA32, pixels.data(), pitch) != 0) {
+        fprintf(stderr, "Error capturing frame %d: %s\n", frame, SDL_GetError());
+        return false;
+    }
 
-    ResetLevelMatrix();
-    textureNameToTextureIdMap.clear();
-    textureIdToTextureMap.clear();
-    unassignedTextures.clear();
-    enemySpawnLocations.clear();
+    char prefix[32];
+    snprintf(prefix, sizeof(prefix), "/frame-%04d", frame);
+    std::string path = options.captureDirectory + prefix;
+    std::string error;
+    bool succeeded = WritePng((path + ".png").c_str(), pixels.data(), width, height, pitch, error);
+    if (!succeeded) {
+        fprintf(stderr, "%s\n", error.c_str());
+    }
+
+    // Each window is compared on its own, so a change to one doesn't fail every golden image
+    const char* windows[][2] = {{"Map editor", "map"}, {"Palette", "palette"}, {"Enemies", "enemies"}};
+    ImVec2 scale = ImGui::GetIO().DisplayFramebufferScale;
+    for (const auto& window : windows) {
+        ImGuiWindow* imguiWindow = ImGui::FindWindowByName(window[0]);
+        if (imguiWindow == nullptr || !imguiWindow->WasActive) {
+            continue;
+        }
 
-    for (int i = 0; i < mapHeight; i++) {
-        for (int j = 0; j < mapWidth; j++) {
-            infile >> levelMatrix[i][j];
+        int x0 = std::max(0, static_cast<int>(imguiWindow->Pos.x * scale.x));
+        int y0 = std::max(0, static_cast<int>(imguiWindow->Pos.y * scale.y));
+        int x1 = std::min(width, static_cast<int>((imguiWindow->Pos.x + imguiWindow->Size.x) * scale.x));
+        int y1 = std::min(height, static_cast<int>((imguiWindow->Pos.y + imguiWindow->Size.y) * scale.y));
+        if (x1 <= x0 || y1 <= y0) {
+            continue;
+        }
+
+        const unsigned char* crop = pixels.data() + static_cast<size_t>(y0) * pitch + static_cast<size_t>(x0) * 4;
+        if (!WritePng((path + "-" + window[1] + ".png").c_str(), crop, x1 - x0, y1 - y0, pitch, error)) {
+            fprintf(stderr, "%s\n", error.c_str());
+            succeeded = false;
         }
     }
 
-    int numEnemySpawnLocations;
-    infile >> numEnemySpawnLocations;
+    return succeeded;
+}
 
-    for (int i = 0; i < numEnemySpawnLocations; i++) {
-        EnemySpawnLocation location;
-        infile >> location.textureId;
-        infile >> location.x;
-        infile >> location.y;
+void Application::RecordFrameTimings() {
+    std::vector<float> row;
+    row.reserve(profiler.Phases().size() + 1);
+    row.push_back(profiler.LastFrameTime());
+    for (const FrameProfiler::Phase& phase : profiler.Phases()) {
+        row.push_back(phase.current);
+    }
+    frameTimings.push_back(std::move(row));
+}
 
-        enemySpawnLocations.push_back(location);
+bool Application::WriteFrameTimings() {
+    if (frameTimings.empty()) {
+        return true;
     }
 
-    while (infile.peek() != EOF) {
-        short id;
-        infile >> id;
-        std::string textureName;
-        infile >> textureName;
-        textureNameToTextureIdMap[textureName] = id;
+    std::vector<float> frameTimes;
+    for (const std::vector<float>& row : frameTimings) {
+        frameTimes.push_back(row[0]);
     }
+    std::sort(frameTimes.begin(), frameTimes.end());
+    fprintf(stdout, "%s: %zu frames, p50 %.3f ms, p99 %.3f ms, max %.3f ms\n", HeadlessScenarioName(options.scenario), frameTimes.size(),
+            frameTimes[frameTimes.size() / 2], frameTimes[std::min(frameTimes.size() - 1, frameTimes.size() * 99 / 100)], frameTimes.back());
 
-    ReassignTextures();
+    if (options.timingsPath.empty()) {
+        return true;
+    }
+
+    FILE* file = fopen(options.timingsPath.c_str(), "wb");
+    if (file == nullptr) {
+        fprintf(stderr, "Failed to open %s: %s\n", options.timingsPath.c_str(), strerror(errno));
+        return false;
+    }
+
+    // Phases are only ever added, so a phase first seen late is zero in the rows before it
+    fprintf(file, "frame,frame_ms");
+    for (const FrameProfiler::Phase& phase : profiler.Phases()) {
+        fprintf(file, ",%s", phase.name);
+    }
+    fprintf(file, "\n");
+
+    for (size_t frame = 0; frame < frameTimings.size(); frame++) {
+        const std::vector<float>& row = frameTimings[frame];
+        fprintf(file, "%zu", frame);
+        for (size_t column = 0; column <= profiler.Phases().size(); column++) {
+            fprintf(file, ",%.4f", column < row.size() ? row[column] : 0.0f);
+        }
+        fprintf(file, "\n");
+    }
+
+    bool failed = ferror(file) != 0;
+    if (fclose(file) != 0 || failed) {
+        fprintf(stderr, "Failed to write %s\n", options.timingsPath.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+bool Application::LoadLevel(const char* filePath) {
+    ProfileScope zone(profiler, "Load level");
 
-    infile.close();
+    std::string error;
+    LevelFormat format;
+    if (!DetectLevelFormat(filePath, format, error)) {
+        fprintf(stderr, "Error loading level: %s\n", error.c_str());
+        return false;
+    }
+
+    LevelGridLayout layout = sparseLevelStorage ? LevelGridLayout::Chunked : LevelGridLayout::Dense;
+    if (!LoadLevelFile(filePath, level, error, layout)) {
+        fprintf(stderr, "Error loading level: %s: %s\n", filePath, error.c_str());
+        return false;
+    }
+
+    // Recover edits that were journaled but never saved in full, e.g. because the editor crashed.
+    // Headless runs leave the level exactly as saved and don't journal their scripted edits.
+    journal.Close();
+    history.Clear();
+    size_t replayedEdits = 0;
+    if (!options.headless && !journal.Open(filePath, level, replayedEdits, error)) {
+        fprintf(stderr, "Edits to %s won't be journaled: %s\n", filePath, error.c_str());
+    } else if (replayedEdits > 0) {
+        fprintf(stdout, "Recovered %zu unsaved edits from %s\n", replayedEdits, EditJournalPath(filePath).c_str());
+    }
+
+    levelFilePath = filePath;
+    levelFileFormat = format;
+    levelGeneration++;
+
+    std::map<std::string, MapCamera>::const_iterator camera = levelCameras.find(levelFilePath);
+    if (camera != levelCameras.end()) {
+        tileMapView.SetCamera(camera->second);
+    } else {
+        tileMapView.FitToMap();
+    }
+
+    mapWidth = level.grid.Width();
+    mapHeight = level.grid.Height();
+    sparseLevelStorage = level.grid.IsChunked();
+
+    textureRegistry.Clear();
+    palette.ClearUnassigned();
+
+    ReassignTextures();
 
     return true;
 }
 
-Application::Application(int width, int height) {
+Application::Application(const EditorOptions& options) : options(options) {
     NewLevel();
 
+    // The dummy driver needs no display, and the software renderer draws the same pixels on any machine
+    if (options.headless) {
+        SDL_SetHint(SDL_HINT_VIDEODRIVER, "dummy");
+        SDL_SetHint(SDL_HINT_RENDER_DRIVER, "software");
+        redrawOnDemand = false;
+    }
+
     // Setup SDL
     if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_TIMER | SDL_INIT_GAMECONTROLLER) != 0) {
         printf("Error: %s\n", SDL_GetError());
     }
 
-    SDL_WindowFlags windowFlags = (SDL_WindowFlags)(SDL_WINDOW_RESIZABLE | SDL_WINDOW_ALLOW_HIGHDPI);
-    SDL_Window* window = SDL_CreateWindow("mini-fps-level-editor", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, width, height, windowFlags);
-    SDL_Renderer* renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_PRESENTVSYNC | SDL_RENDERER_ACCELERATED);
+    // Wakes the idle loop when inotify sees the watched texture folder change; the event itself only
+    // gets a frame drawn, which polls the watcher
+    Uint32 textureFolderEvent = SDL_RegisterEvents(1);
+    if (textureFolderEvent != static_cast<Uint32>(-1)) {
+        textureFolderWatcher.SetWakeCallback([textureFolderEvent]() {
+            SDL_Event event;
+            SDL_zero(event);
+            event.type = textureFolderEvent;
+            SDL_PushEvent(&event);
+        });
+    }
+
+    SDL_WindowFlags windowFlags = (SDL_WindowFlags)(options.headless ? SDL_WINDOW_HIDDEN : SDL_WINDOW_RESIZABLE | SDL_WINDOW_ALLOW_HIGHDPI);
+    Uint32 rendererFlags = options.headless ? SDL_RENDERER_SOFTWARE : SDL_RENDERER_PRESENTVSYNC | SDL_RENDERER_ACCELERATED;
+    SDL_Window* window = SDL_CreateWindow("mini-fps-level-editor", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, options.width, options.height, windowFlags);
+    SDL_Renderer* renderer = SDL_CreateRenderer(window, -1, rendererFlags);
 
     if (renderer == nullptr) {
         SDL_Log("Error creating SDL_Renderer!");
@@ -192,10 +720,15 @@ Application::Application(int width, int height) {
 
     // Setup Dear ImGui context
     ImGui::CreateContext();
+    RegisterLevelCameraSettings();
     ImGuiIO& io = ImGui::GetIO(); (void)io;
     io.ConfigFlags |= ImGuiConfigFlags_NavEnableKeyboard;     // Enable Keyboard Controls
     io.ConfigFlags |= ImGuiConfigFlags_NavEnableGamepad;      // Enable Gamepad Controls
     io.ConfigFlags |= ImGuiConfigFlags_DockingEnable;
+    if (options.headless) {
+        // Window positions and cameras from imgui.ini would make runs depend on each other
+        io.IniFilename = nullptr;
+    }
 
     // Setup Dear ImGui style
     ImGui::StyleColorsDark();
@@ -205,175 +738,250 @@ Application::Application(int width, int height) {
     ImGui_ImplSDL2_InitForSDLRenderer(window, renderer);
     ImGui_ImplSDLRenderer_Init(renderer);
 
-    int editorTileSize = 16;
     int paletteTileSize = 64;
     int currentTile = 0;
     ImVec4 backgroundColor = ImVec4(0.5f, 0.5f, 0.5f, 1.0f);
 
-    pfd::open_file textureFileDialog = pfd::open_file("Select textures", "", {"Image Files", "*.png"}, pfd::opt::multiselect);
+    std::vector<std::string> texturePaths = options.texturePaths;
+    if (texturePaths.empty() && !options.headless) {
+        pfd::open_file textureFileDialog = pfd::open_file("Select textures", "", {"Image Files", "*.png"}, pfd::opt::multiselect);
+        texturePaths = textureFileDialog.result();
+    }
+
+    textureAtlas.SetRenderer(renderer);
+    tileMapView.SetRenderer(renderer);
 
     Texture fallbackTexture;
-    fallbackTexture.sdlRenderer = renderer;
     Application::LoadTextureFromFile(fallbackTexture, "../Resources/sprites/fallback.png");
+    textureRegistry.SetFallback(fallbackTexture);
+    textureStreamer.SetFallback(fallbackTexture);
+
+    if (!options.textureCachePath.empty()) {
+        std::string error;
+        if (textureCache.Open(options.textureCachePath, error)) {
+            textureStreamer.SetCache(&textureCache);
+        } else {
+            fprintf(stderr, "Decoded textures won't be cached: %s\n", error.c_str());
+        }
+    }
 
     textures.clear();
-    // textures.reserve(textureFileDialog.result().size());
+    textureNames.clear();
+    textures.reserve(texturePaths.size());
 
-    for (int i = 0; i < textureFileDialog.result().size(); i++) {
-        Texture newTexture;
-        newTexture.sdlRenderer = renderer;
-        Application::LoadTextureFromFile(newTexture, textureFileDialog.result()[i].c_str());
-        if (newTexture.name != "fallback") {
-            textures.push_back(newTexture);
-            unassignedTextures.push_back(newTexture);
-        }
+    // Only the paths for now; each texture is decoded the first time it's on screen
+    RegisterTextures(texturePaths);
+
+    if (!options.levelPath.empty() && !LoadLevel(options.levelPath.c_str()) && options.headless) {
+        exitCode = 1;
+    }
+
+    // A missing capture directory is created; anything else wrong with it shows up on the first capture
+    if (options.headless && !options.captureDirectory.empty()) {
+        mkdir(options.captureDirectory.c_str(), 0755);
     }
 
-    bool done = false;
+    bool done = exitCode != 0;
+    int frame = 0;
+    auto processEvent = [&](const SDL_Event& event) {
+        ImGui_ImplSDL2_ProcessEvent(&event);
+        if (event.type == SDL_QUIT) {
+            done = true;
+        }
+
+        if (event.type == SDL_WINDOWEVENT && event.window.event == SDL_WINDOWEVENT_CLOSE && event.window.windowID == SDL_GetWindowID(window)) {
+            done = true;
+        }
+
+        // The driver dropped the contents of every render target, the cached map view included
+        if (event.type == SDL_RENDER_TARGETS_RESET || event.type == SDL_RENDER_DEVICE_RESET) {
+            tileMapView.InvalidateAll();
+        }
+
+        settleFrames = kSettleFrameCount;
+    };
+
     while (!done) {
         SDL_Event event;
+
+        // Once the last input has settled, sleep until the next event or requested redraw
+        bool woken = redrawOnDemand && settleFrames == 0 && WaitForRedraw(event);
+
+        profiler.BeginFrame();
+        profiler.BeginZone("Events");
+        if (woken) {
+            processEvent(event);
+        }
+
         while (SDL_PollEvent(&event)) {
-            ImGui_ImplSDL2_ProcessEvent(&event);
-            if (event.type == SDL_QUIT) {
-                done = true;
-            }
+            processEvent(event);
+        }
+        profiler.EndZone();
 
-            if (event.type == SDL_WINDOWEVENT && event.window.event == SDL_WINDOWEVENT_CLOSE && event.window.windowID == SDL_GetWindowID(window)) {
-                done = true;
-            }
+        if (settleFrames > 0) {
+            settleFrames--;
         }
+        redrawRequested = false;
 
         // Start the Dear ImGui frame
+        profiler.BeginZone("NewFrame");
         ImGui_ImplSDLRenderer_NewFrame();
         ImGui_ImplSDL2_NewFrame();
+        if (options.headless) {
+            io.DeltaTime = kHeadlessFrameTime;
+
+            // The map view's rectangle from the frame before; the layout is fixed, so only the first frame misses it
+            ImGuiWindow* mapWindow = ImGui::FindWindowByName("Map editor");
+            if (mapWindow != nullptr) {
+                QueueHeadlessScenarioInput(options.scenario, frame, options.frameCount, mapWindow->InnerRect.Min, mapWindow->InnerRect.Max);
+            }
+        }
         ImGui::NewFrame();
 
         ImGui::DockSpaceOverViewport(ImGui::GetMainViewport());
+        profiler.EndZone();
+
+        profiler.BeginZone("Texture streaming");
+        PollTextureFolder();
+        UpdateTextureStreaming();
+        profiler.EndZone();
 
         short currentTileShort = static_cast<short>(currentTile);
-        float editorTileSizeFloat = static_cast<float>(editorTileSize);
         float paletteTileSizeFloat = static_cast<float>(paletteTileSize);
 
-        ImGui::Begin("Map editor", nullptr);
-
-        ImGui::PushStyleVar(ImGuiStyleVar_ItemSpacing, ImVec2(1, 1));
-        ImGui::PushStyleVar(ImGuiStyleVar_FramePadding, ImVec2(1, 1));
-        ImGui::PushStyleVar(ImGuiStyleVar_FrameBorderSize, 1);
+        profiler.BeginZone("Map editor");
+        PlaceHeadlessWindow(0.0f, 0.0f, 0.65f, 0.7f);
+        ImGui::Begin("Map editor", nullptr, ImGuiWindowFlags_NoScrollbar | ImGuiWindowFlags_NoScrollWithMouse);
 
         // Display the tile map
-        for (int y = 0; y < mapHeight; ++y) {
-            for (int x = 0; x < mapWidth; ++x) {
-                short cellId = levelMatrix[y][x];
-
-                if (cellId != 0 && textureIdToTextureMap.count(cellId) == 1) {
-                    ImGui::Image(textureIdToTextureMap[cellId].sdlTexture, ImVec2(editorTileSizeFloat, editorTileSizeFloat));
-                } else if (cellId != 0) {
-                    ImGui::Image(fallbackTexture.sdlTexture, ImVec2(editorTileSizeFloat, editorTileSizeFloat));
-                } else {
-                    ImGui::Image(nullptr, ImVec2(editorTileSizeFloat, editorTileSizeFloat));
-                }
-
-                // If the tile was clicked
-                if (ImGui::IsItemClicked()) {
-                    fprintf(stderr, "(%d, %d) clicked\n", x, y);
-                    levelMatrix[y][x] = currentTileShort;
-                }
-
-                ImGui::SameLine();
-            }
-
-            ImGui::NewLine();
+        paintedCells.clear();
+        tileMapView.Draw(level.grid, textureRegistry, paintedCells);
+        MarkVisibleMapTextures();
+        RememberLevelCamera();
+        for (const TileCoordinate& cell : paintedCells) {
+            SetTile(cell.x, cell.y, currentTileShort);
         }
 
-        ImGui::PopStyleVar(3);
-
         ImGui::End();
+        profiler.EndZone();
 
+        profiler.BeginZone("Settings");
+        PlaceHeadlessWindow(0.0f, 0.7f, 0.65f, 0.3f);
         ImGui::Begin("Settings", nullptr);
 
 //        int newMapWidth = mapWidth;
 //        int newMapHeight = mapHeight;
 
         ImGui::SliderInt("Current tile", &currentTile, 0, 16);
-        ImGui::SliderInt("Editor tile size", &editorTileSize, 8, 64);
+        // Below kOverviewTileSize the map is drawn from its overview pyramid
+        float zoom = tileMapView.Camera().zoom;
+        if (ImGui::SliderFloat("Zoom", &zoom, kMinMapZoom, kMaxMapZoom, "%.3f px", ImGuiSliderFlags_Logarithmic)) {
+            tileMapView.SetZoom(zoom);
+        }
         ImGui::SliderInt("Palette tile size", &paletteTileSize, 32, 128);
+
+        if (ImGui::Checkbox("Sparse level storage", &sparseLevelStorage)) {
+            level.grid.SetLayout(sparseLevelStorage ? LevelGridLayout::Chunked : LevelGridLayout::Dense);
+        }
+        ImGui::Text("Level memory: %.1f KiB", static_cast<double>(level.grid.MemoryUsage()) / 1024.0);
+        ImGui::Text("Map cells drawn: %d / %d%s", tileMapView.DrawnCellCount(), tileMapView.VisibleCellCount(), tileMapView.IsCached() ? " (cached)" : "");
+        if (tileMapView.OverviewLevel() >= 0) {
+            ImGui::Text("Overview level %d, %.1f KiB", tileMapView.OverviewLevel(), static_cast<double>(tileMapView.OverviewMemoryUsage()) / 1024.0);
+        }
+
+        int undoBudgetMegabytes = static_cast<int>(history.MemoryBudget() / (1024 * 1024));
+        if (ImGui::SliderInt("Undo memory (MiB)", &undoBudgetMegabytes, 1, 1024)) {
+            history.SetMemoryBudget(static_cast<size_t>(undoBudgetMegabytes) * 1024 * 1024);
+        }
+        int textureBudgetMegabytes = static_cast<int>(textureStreamer.MemoryBudget() / (1024 * 1024));
+        if (ImGui::SliderInt("Texture memory (MiB)", &textureBudgetMegabytes, 16, 2048)) {
+            textureStreamer.SetMemoryBudget(static_cast<size_t>(textureBudgetMegabytes) * 1024 * 1024);
+        }
+        ImGui::Text("Textures loaded: %zu / %zu, %.1f MiB in %d atlas pages", textureStreamer.ResidentCount(), textureStreamer.TextureCount(),
+                    static_cast<double>(textureAtlas.MemoryUsage()) / (1024.0 * 1024.0), textureAtlas.PageCount());
+        if (textureStreamer.SharedCount() > 0) {
+            ImGui::Text("Duplicate textures: %zu sharing an image, %.1f MiB saved", textureStreamer.SharedCount(),
+                        static_cast<double>(textureStreamer.SharedBytes()) / (1024.0 * 1024.0));
+        }
+        if (textureFolderWatcher.IsOpen()) {
+            ImGui::Text("Watching %s%s", textureFolderWatcher.Folder().c_str(), textureFolderWatcher.IsUsingInotify() ? "" : " (rescanning)");
+        }
+        if (textureCache.IsOpen()) {
+            ImGui::Text("Texture cache: %.1f MiB, %zu images when opened", static_cast<double>(textureCache.FileSize()) / (1024.0 * 1024.0), textureCache.EntryCount());
+        }
+        ImGui::Checkbox("Redraw only on input", &redrawOnDemand);
+        ImGui::Text("CPU: %.1f%% of a core", static_cast<double>(cpuUsage) * 100.0);
+        ImGui::Text("Undo history: %zu steps, %.1f KiB", history.UndoCount(), static_cast<double>(history.MemoryUsage()) / 1024.0);
 //        ImGui::SliderInt("Map width", &newMapWidth, 3, 128);
 //        ImGui::SliderInt("Map height", &newMapHeight, 3, 128);
 
         ImGui::End();
+        profiler.EndZone();
 
+        profiler.BeginZone("Palette");
+        PlaceHeadlessWindow(0.65f, 0.0f, 0.35f, 0.7f);
         ImGui::Begin("Palette", nullptr);
-        ImGui::Text("Assigned textures");
 
-        for (const auto& entry : textureIdToTextureMap) {
-            ImGui::Text("id: %d", entry.first);
-            ImGui::SameLine();
-            ImGui::Text("name: %s", entry.second.name.c_str());
-
-            ImGui::Image(entry.second.sdlTexture, ImVec2(paletteTileSizeFloat, paletteTileSizeFloat));
-            if (ImGui::IsItemClicked()) {
-                fprintf(stdout, "Image %d clicked\n", entry.first);
-                currentTile = entry.first;
+        PaletteClick paletteClick;
+        if (palette.Draw(textureRegistry, textureStreamer, paletteTileSizeFloat, currentTileShort, paletteClick)) {
+            if (paletteClick.assigned) {
+                currentTile = paletteClick.id;
+            } else {
+                // The palette's copy doesn't follow the texture being loaded or evicted; textures does
+                Texture& texture = textures[static_cast<size_t>(palette.Unassigned()[paletteClick.unassignedIndex].streamIndex)];
+                short id = textureRegistry.FreeId();
+                texture.id = id;
+                textureRegistry.Assign(id, texture);
+                // Cells already using the id were drawn with the fallback texture
+                std::vector<short> assignedIds(1, id);
+                tileMapView.InvalidateTileTextures(level.grid, assignedIds);
+                tileMapView.InvalidateTileColors(assignedIds);
+                std::map<std::string, short>::const_iterator previous = level.textureNameToTextureIdMap.find(texture.name);
+                bool hadPrevious = previous != level.textureNameToTextureIdMap.end();
+                history.RecordTextureName(texture.name, hadPrevious, hadPrevious ? previous->second : 0, id);
+                ApplyTextureName(texture.name, id);
+                palette.RemoveUnassigned(paletteClick.unassignedIndex);
+
+                currentTile = id;
             }
-            ImGui::NewLine();
         }
-        ImGui::NewLine();
+        profiler.EndZone();
 
-        short newlyAssignedTextureId = -1;
+        profiler.BeginZone("Journal and saves");
+        PollLevelSave();
+        UpdateJournal();
+        UpdateCpuUsage();
 
-        if (!unassignedTextures.empty()) {
-            ImGui::Text("Unassigned textures");
+        // Things that change without input; each asks for the frame it needs
+        if (levelSaver.IsSaving() || ImGui::IsAnyItemActive()) {
+            RequestRedraw(kAnimationRedrawIntervalMs);
         }
-
-        for (int i = 0; i < unassignedTextures.size(); i++) {
-            ImGui::Text("name: %s", unassignedTextures[i].name.c_str());
-            ImGui::Image(unassignedTextures[i].sdlTexture, ImVec2(paletteTileSizeFloat, paletteTileSizeFloat));
-            if (ImGui::IsItemClicked()) {
-                short id = -1;
-                short potentialId = 1;
-
-                while (id == -1) {
-                    if (textureIdToTextureMap.count(potentialId) == 0) {
-                        id = potentialId;
-                        textureIdToTextureMap[id] = unassignedTextures[i];
-                        textureNameToTextureIdMap[unassignedTextures[i].name] = id;
-                        unassignedTextures[i].id = id;
-                        newlyAssignedTextureId = id;
-                    } else {
-                        potentialId++;
-                    }
-                }
-            }
-
-            ImGui::NewLine();
+        if (tileMapView.IsAnimating() || textureStreamer.IsBusy()) {
+            RequestRedraw();
+        }
+        if (textureFolderWatcher.IsOpen() && !textureFolderWatcher.WakesOnChange()) {
+            RequestRedraw(kTextureFolderCheckIntervalMs);
+        }
+        if (journal.HasPendingEdits()) {
+            Uint32 sinceFlush = SDL_GetTicks() - lastJournalFlushTicks;
+            RequestRedraw(sinceFlush < kJournalFlushIntervalMs ? kJournalFlushIntervalMs - sinceFlush : 0);
         }
 
-        if (newlyAssignedTextureId != -1) {
-            int index = -1;
-
-            // Find index in unassigned texture pool
-            for (int j = 0; j < unassignedTextures.size(); j++) {
-                if (newlyAssignedTextureId == unassignedTextures[j].id) {
-                    index = j;
-                    fprintf(stdout, "Index is %d\n", index);
-                    break;
-                }
-            }
-
-            // If the index exists, remove the item at index
-            if (index != -1) {
-                for (int h = index; h < unassignedTextures.size(); h++) {
-                    unassignedTextures[h] = unassignedTextures[h+1];
-                }
-            }
-
-            if (!unassignedTextures.empty()) {
-                unassignedTextures.pop_back();
+        // Everything changed while the mouse is held or a field is being typed into is one undo step
+        if (!ImGui::IsMouseDown(ImGuiMouseButton_Left) && !ImGui::IsAnyItemActive()) {
+            history.Commit();
+        }
+        profiler.EndZone();
+
+        profiler.BeginZone("Main menu");
+        if (!io.WantTextInput && io.KeyCtrl && ImGui::IsKeyPressed(ImGuiKey_Z, false)) {
+            if (io.KeyShift) {
+                Redo();
+            } else {
+                Undo();
             }
-
-            currentTile = newlyAssignedTextureId;
-
-            AssignNewTextures();
+        } else if (!io.WantTextInput && io.KeyCtrl && ImGui::IsKeyPressed(ImGuiKey_Y, false)) {
+            Redo();
         }
 
         if (ImGui::BeginMainMenuBar()) {
@@ -387,36 +995,108 @@ Application::Application(int width, int height) {
                     SaveLevel(newLevelFileDialog.result().c_str());
                 }
 
+                if (ImGui::MenuItem("Save as binary", "", nullptr)) {
+                    pfd::save_file newLevelFileDialog = pfd::save_file("Save level as binary", "", {"Level Files", "*.lvl"});
+                    SaveLevel(newLevelFileDialog.result().c_str(), LevelFormat::Binary);
+                }
+
+                if (ImGui::MenuItem("Save as compressed binary", "", nullptr)) {
+                    pfd::save_file newLevelFileDialog = pfd::save_file("Save level as compressed binary", "", {"Level Files", "*.lvl"});
+                    SaveLevel(newLevelFileDialog.result().c_str(), LevelFormat::CompressedBinary);
+                }
+
+                if (ImGui::MenuItem("Compact journal", "", nullptr, journal.IsOpen() && !levelSaver.IsSaving())) {
+                    SaveLevel(levelFilePath.c_str(), levelFileFormat);
+                }
+
                 if (ImGui::MenuItem("Load", "", nullptr)) {
                     pfd::open_file newLevelFileDialog = pfd::open_file("Load level", "", {"Level Files", "*.lvl"});
-                    LoadLevel(newLevelFileDialog.result()[0].c_str());
+                    if (!newLevelFileDialog.result().empty()) {
+                        LoadLevel(newLevelFileDialog.result()[0].c_str());
+                    }
+                }
+
+                ImGui::EndMenu();
+            }
+
+            if (ImGui::BeginMenu("Edit")) {
+                if (ImGui::MenuItem("Undo", "Ctrl+Z", nullptr, history.CanUndo())) {
+                    Undo();
+                }
+
+                if (ImGui::MenuItem("Redo", "Ctrl+Shift+Z", nullptr, history.CanRedo())) {
+                    Redo();
+                }
+
+                if (ImGui::MenuItem("Fill with current tile", "", nullptr)) {
+                    FillLevel(currentTileShort);
                 }
 
                 ImGui::EndMenu();
             }
 
             if (ImGui::BeginMenu("Textures")) {
+                if (ImGui::MenuItem("Import textures", "", nullptr)) {
+                    pfd::open_file importDialog = pfd::open_file("Import textures", "", {"Image Files", "*.png"}, pfd::opt::multiselect);
+                    RegisterTextures(importDialog.result());
+                }
+
                 if (ImGui::MenuItem("Load texture folder", "", nullptr)) {
                     pfd::select_folder selectTextureFolderDialog = pfd::select_folder("Load texture folder");
-                    fprintf(stderr, "Loading texture folder not yet implemented\n");
+                    if (!selectTextureFolderDialog.result().empty()) {
+                        LoadTextureFolder(selectTextureFolderDialog.result());
+                    }
+                }
+
+                ImGui::EndMenu();
+            }
+
+            if (ImGui::BeginMenu("Profiler")) {
+                ImGui::MenuItem("Show frame times", "", &showProfiler);
+
+                if (ImGui::MenuItem("Export trace", "", nullptr)) {
+                    ExportFrameTrace();
                 }
 
                 ImGui::EndMenu();
             }
 
+            if (textureStreamer.IsBusy()) {
+                size_t taken = textureStreamer.BatchTaken();
+                size_t total = textureStreamer.BatchSize();
+                ImGui::Text("Loading textures %zu/%zu", taken, total);
+                ImGui::ProgressBar(total > 0 ? static_cast<float>(taken) / total : 0.0f, ImVec2(120.0f, 0.0f));
+            }
+
+            if (levelSaver.IsSaving()) {
+                ImGui::Text("Saving %s", levelSaver.FilePath().c_str());
+                ImGui::ProgressBar(levelSaver.Progress(), ImVec2(120.0f, 0.0f));
+            } else if (!saveStatus.empty()) {
+                ImGui::TextUnformatted(saveStatus.c_str());
+            }
+
             ImGui::EndMainMenuBar();
         }
 
         ImGui::End();
+        profiler.EndZone();
 
+        profiler.BeginZone("Enemies");
+        PlaceHeadlessWindow(0.65f, 0.7f, 0.35f, 0.3f);
         ImGui::Begin("Enemies");
 
         int i = 1000;
-        for (EnemySpawnLocation& location : enemySpawnLocations) {
+        for (size_t index = 0; index < level.enemySpawnLocations.size(); index++) {
+            EnemySpawnLocation& location = level.enemySpawnLocations[index];
+            EnemySpawnLocation before = location;
             ImGui::PushID(i);
-            ImGui::InputInt("Texture ID", &location.textureId);
-            ImGui::InputFloat("X", &location.x);
-            ImGui::InputFloat("Y", &location.y);
+            bool changed = ImGui::InputInt("Texture ID", &location.textureId);
+            changed |= ImGui::InputFloat("X", &location.x);
+            changed |= ImGui::InputFloat("Y", &location.y);
+            if (changed) {
+                history.RecordSpawn(index, true, before, location);
+                journal.RecordSpawn(index, location);
+            }
             ImGui::NewLine();
             ImGui::PopID();
             i++;
@@ -427,17 +1107,47 @@ Application::Application(int width, int height) {
             EnemySpawnLocation location;
             location.textureId = -1;
             location.x = 0.0f;
-            location.x = 0.0f;
-            enemySpawnLocations.push_back(location);
+            location.y = 0.0f;
+            history.RecordSpawn(level.enemySpawnLocations.size(), false, location, location);
+            ApplySpawn(level.enemySpawnLocations.size(), location);
         }
         ImGui::End();
+        profiler.EndZone();
+
+        profiler.BeginZone("Profiler");
+        DrawProfiler();
+        profiler.EndZone();
 
+        profiler.BeginZone("ImGui::Render");
         ImGui::Render();
+        profiler.EndZone();
+
+        profiler.BeginZone("RenderDrawData");
         SDL_RenderSetScale(renderer, io.DisplayFramebufferScale.x, io.DisplayFramebufferScale.y);
         SDL_SetRenderDrawColor(renderer, (Uint8)(backgroundColor.x * 255), (Uint8)(backgroundColor.y * 255), (Uint8)(backgroundColor.z * 255), (Uint8)(backgroundColor.w * 255));
         SDL_RenderClear(renderer);
         ImGui_ImplSDLRenderer_RenderDrawData(ImGui::GetDrawData());
+        profiler.EndZone();
+
+        if (options.headless && !options.captureDirectory.empty()) {
+            // Read back before presenting, after which the back buffer's contents are undefined
+            bool lastFrame = frame == options.frameCount - 1;
+            if ((lastFrame || (options.captureInterval > 0 && frame % options.captureInterval == 0)) && !CaptureFrame(renderer, frame)) {
+                exitCode = 1;
+            }
+        }
+
+        // Includes waiting for vsync
+        profiler.BeginZone("SDL_RenderPresent");
         SDL_RenderPresent(renderer);
+        profiler.EndZone();
+        profiler.EndFrame();
+
+        frame++;
+        if (options.headless) {
+            RecordFrameTimings();
+            done |= frame >= options.frameCount;
+        }
 
 //        if (newMapWidth != mapWidth || newMapHeight != mapHeight) {
 //            mapWidth = newMapWidth;
@@ -447,6 +1157,18 @@ Application::Application(int width, int height) {
     }
 
     // Cleanup
+    // Let a save that's still in flight finish rather than leave a half-written temp file behind
+    levelSaver.Wait();
+    PollLevelSave();
+    journal.Close();
+
+    if (options.headless && !WriteFrameTimings()) {
+        exitCode = 1;
+    }
+
+    tileMapView.ReleaseRenderTarget();
+    textureAtlas.Clear();
+
     ImGui_ImplSDLRenderer_Shutdown();
     ImGui_ImplSDL2_Shutdown();
     ImGui::DestroyContext();
@@ -1,32 +1,185 @@
 #pragma once
 
+#include <ctime>
 #include <map>
+#include <set>
 #include <string>
+#include <vector>
 #include "SDL.h"
+#include "BackgroundLevelSaver.h"
+#include "EditHistory.h"
+#include "EditJournal.h"
+#include "FrameProfiler.h"
+#include "HeadlessScenario.h"
+#include "Level.h"
+#include "LevelFile.h"
 #include "Texture.h"
+#include "TextureFolderWatcher.h"
+#include "TexturePalette.h"
+#include "TextureRegistry.h"
+#include "TextureStreamer.h"
+#include "TileMapView.h"
 
-struct EnemySpawnLocation {
-    int textureId; // This should be short but eh
-    float x, y;
+// Unsaved edits are appended to the level's journal this often
+static const Uint32 kJournalFlushIntervalMs = 2000;
+// Past this size the journal is folded back into the level file with a full save
+static const uint64_t kJournalCompactionSize = 16 * 1024 * 1024;
+// After a failed save, compaction isn't tried again for this long
+static const Uint32 kJournalCompactionRetryMs = 30000;
+// Frames drawn after each input event, so ImGui interactions that take a few frames (hovering,
+// opening a menu, resizing a window) settle before the loop goes idle again
+static const int kSettleFrameCount = 3;
+// How often to redraw while something moves without input: a save's progress bar, a blinking text cursor
+static const Uint32 kAnimationRedrawIntervalMs = 100;
+// How much of the profiler's history "Export trace" writes
+static const double kProfilerTraceSeconds = 10.0;
+
+// Main thread time per frame spent adding decoded textures to the atlas while textures stream in
+static const Uint64 kTextureUploadBudgetMs = 4;
+// How often an idle editor wakes up to pick up changes in a watched texture folder it has to rescan
+static const Uint32 kTextureFolderCheckIntervalMs = 500;
+
+// The headless mode's fixed time step, so easing and scripted input play out the same on every run
+static const float kHeadlessFrameTime = 1.0f / 60.0f;
+
+// Set from the command line
+struct EditorOptions {
+    int width = 1280;
+    int height = 720;
+    // Level and textures to open at startup instead of asking for textures
+    std::string levelPath;
+    std::vector<std::string> texturePaths;
+    // Pack of decoded textures from earlier runs; empty for no cache, which headless runs default to
+    std::string textureCachePath = "texture-cache.pack";
+
+    // Run on SDL's dummy video driver and software renderer, play a scripted scenario and quit, for
+    // frame time regression checks and golden-image tests on machines without a display or GPU
+    bool headless = false;
+    HeadlessScenario scenario = HeadlessScenario::Pan;
+    int frameCount = 120;
+    // Per-frame and per-phase times as CSV; not written if empty
+    std::string timingsPath;
+    // Where PNG captures of the whole frame and the map, palette and enemies windows go; none if empty
+    std::string captureDirectory;
+    // Capture every this many frames as well as the last one; 0 for only the last
+    int captureInterval = 0;
 };
 
-class Application {
+class Application : public EditTarget {
 public:
+    // Decodes and adds one texture on the main thread; tile textures are streamed through textureStreamer instead
     bool LoadTextureFromFile(Texture& texture, const char* fileName);
-    Application(int width, int height);
+    bool CreateTexture(Texture& texture, const DecodedTexture& decoded);
+    // Registers textures with the streamer without loading them, adding each to the palette, or
+    // straight to its tile id if the level already names it. Paths registered before, and textures
+    // whose name is already taken, are skipped. Paths under folder are named by their path below it.
+    void RegisterTextures(const std::vector<std::string>& paths, const std::string& folder = std::string());
+    // Registers every image under folder and watches it for images that are added or changed
+    void LoadTextureFolder(const std::string& folder);
+    // Registers images added to the watched folder and reloads the ones that changed
+    void PollTextureFolder();
+    // Picks up textures the streamer loaded or evicted and points every copy of them at their new region
+    void UpdateTextureStreaming();
+    // Marks the textures of the tiles the map view drew as visible, or asks for the average colour of
+    // every tile's texture when it drew the overview
+    void MarkVisibleMapTextures();
+    explicit Application(const EditorOptions& options);
+    // Non-zero if a headless run failed to load its inputs or write its results
+    int ExitCode() const { return exitCode; }
     void ReassignTextures();
-    void AssignNewTextures();
-    void ResetLevelMatrix();
+    void ResetLevelGrid();
     void NewLevel();
-    bool SaveLevel(const char* filePath);
+    // Every tile edit made in the editor goes through here so it can be undone and is journaled
+    void SetTile(int x, int y, short id);
+    void FillLevel(short id);
+    void Undo();
+    void Redo();
+
+    // Apply a change without recording it for undo; used by undo and redo themselves
+    void ApplyTile(int x, int y, short id) override;
+    void ApplySpawn(size_t index, const EnemySpawnLocation& location) override;
+    void RemoveLastSpawn() override;
+    void ApplyTextureName(const std::string& name, short id) override;
+    void RemoveTextureName(const std::string& name) override;
+    // Flushes journaled edits every kJournalFlushIntervalMs and compacts the journal when it gets long
+    void UpdateJournal();
+    // Starts saving a snapshot of the level in the background; false if it couldn't be started
+    bool SaveLevel(const char* filePath, LevelFormat format = LevelFormat::Text);
+    // Picks up the result of a finished background save
+    void PollLevelSave();
     bool LoadLevel(const char* filePath);
+    // Asks for a frame within delayMs even without input; for timers and anything animating
+    void RequestRedraw(Uint32 delayMs = 0);
+    // Sleeps until there's an event or a requested redraw is due; true if it returned an event
+    bool WaitForRedraw(SDL_Event& event);
+    void UpdateCpuUsage();
+    // Per-phase frame times with histograms, when showProfiler is set
+    void DrawProfiler();
+    void ExportFrameTrace();
+    // Keeps each level's camera in imgui.ini, keyed by the level's path
+    void RegisterLevelCameraSettings();
+    void RememberLevelCamera();
+    // Pins the windows to a fixed layout so headless captures don't depend on the previous run
+    void PlaceHeadlessWindow(float x, float y, float width, float height);
+    // Writes the frame and crops of the map, palette and enemies windows into the capture directory
+    bool CaptureFrame(SDL_Renderer* renderer, int frame);
+    void RecordFrameTimings();
+    bool WriteFrameTimings();
 private:
+    EditorOptions options;
+    int exitCode = 0;
+    // Milliseconds per frame followed by each phase's, in the profiler's phase order, for every headless frame
+    std::vector<std::vector<float>> frameTimings;
+
     int mapWidth = 16;
     int mapHeight = 16;
-    short** levelMatrix;
+    // Store tiles in chunks so mostly-empty maps only pay for the chunks they use
+    bool sparseLevelStorage = false;
+    Level level;
+    BackgroundLevelSaver levelSaver;
+    // Result of the last finished save, shown in the menu bar
+    std::string saveStatus;
+    // The file the level was loaded from or last saved to; empty for a new level
+    std::string levelFilePath;
+    LevelFormat levelFileFormat = LevelFormat::Text;
+    EditJournal journal;
+    EditHistory history;
+    // Set by ApplyTextureName and RemoveTextureName, so undo and redo know whether tile ids were remapped
+    bool textureNamesChanged = false;
+    TileMapView tileMapView;
+    std::map<std::string, MapCamera> levelCameras;
+    std::vector<TileCoordinate> paintedCells;
+    Uint32 lastJournalFlushTicks = 0;
+    // Bumped whenever a different level is opened, so a save that finishes late doesn't rebase its journal
+    int levelGeneration = 0;
+    int saveLevelGeneration = 0;
+    uint64_t saveJournalOffset = 0;
+    bool lastSaveFailed = false;
+    Uint32 lastSaveFailureTicks = 0;
+    // Draw only on input or when a redraw was requested, rather than at the display's refresh rate
+    bool redrawOnDemand = true;
+    int settleFrames = kSettleFrameCount;
+    bool redrawRequested = false;
+    Uint32 redrawTicks = 0;
+    // Process CPU time over the last second, as a fraction of one core
+    float cpuUsage = 0.0f;
+    std::clock_t cpuSampleClock = 0;
+    Uint32 cpuSampleTicks = 0;
+    FrameProfiler profiler;
+    bool showProfiler = false;
+    TextureAtlas textureAtlas;
+    // Before the streamer, whose decode workers read from it until they're stopped
+    TextureCache textureCache;
+    TextureStreamer textureStreamer{textureAtlas};
+    std::vector<short> visibleTileIds;
+    std::vector<int> changedTextures;
+    // Assigned ids whose region or average colour the last streaming update changed
+    std::vector<short> changedRegionIds;
+    std::vector<short> changedColorIds;
+    TextureFolderWatcher textureFolderWatcher;
     std::vector<Texture> textures;
-    std::map<std::string, short> textureNameToTextureIdMap;
-    std::map<short, Texture> textureIdToTextureMap;
-    std::vector<Texture> unassignedTextures;
-    std::vector<EnemySpawnLocation> enemySpawnLocations;
+    // The names of everything in textures
+    std::set<std::string> textureNames;
+    TextureRegistry textureRegistry;
+    TexturePalette palette;
 };
\ No newline at end of file
@@ -0,0 +1,51 @@
+#include "BackgroundLevelSaver.h"
+#include <memory>
+
+BackgroundLevelSaver::~BackgroundLevelSaver() {
+    Wait();
+}
+
+bool BackgroundLevelSaver::Start(Level snapshot, const std::string& filePath, LevelFormat format) {
+    if (IsSaving()) {
+        return false;
+    }
+
+    this->filePath = filePath;
+    this->format = format;
+    progress.store(0.0f);
+    finished.store(false);
+    succeeded = false;
+    error.clear();
+
+    // The worker owns the snapshot; the editor is free to keep editing the live level
+    std::shared_ptr<Level> level = std::make_shared<Level>(std::move(snapshot));
+
+    worker = std::thread([this, level, format]() {
+        succeeded = SaveLevelFile(this->filePath.c_str(), *level, format, error, &progress);
+        finished.store(true, std::memory_order_release);
+    });
+
+    return true;
+}
+
+bool BackgroundLevelSaver::Poll(bool& succeeded, std::string& error) {
+    // Still set after Wait has joined the worker, so a save that finished there is reported too
+    if (!finished.load(std::memory_order_acquire)) {
+        return false;
+    }
+
+    if (worker.joinable()) {
+        worker.join();
+    }
+    finished.store(false);
+    succeeded = this->succeeded;
+    error = this->error;
+
+    return true;
+}
+
+void BackgroundLevelSaver::Wait() {
+    if (IsSaving()) {
+        worker.join();
+    }
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include "Level.h"
+#include "LevelFile.h"
+
+// Saves a snapshot of a level on a worker thread so the editor keeps drawing while it's written.
+// Only one save runs at a time; the owner polls once a frame to pick up the result.
+class BackgroundLevelSaver {
+public:
+    BackgroundLevelSaver() = default;
+    ~BackgroundLevelSaver();
+    BackgroundLevelSaver(const BackgroundLevelSaver&) = delete;
+    BackgroundLevelSaver& operator=(const BackgroundLevelSaver&) = delete;
+
+    // Takes ownership of snapshot and starts writing it. False if a save is already running.
+    bool Start(Level snapshot, const std::string& filePath, LevelFormat format);
+
+    bool IsSaving() const { return worker.joinable(); }
+    float Progress() const { return progress.load(std::memory_order_relaxed); }
+    const std::string& FilePath() const { return filePath; }
+    LevelFormat Format() const { return format; }
+
+    // Returns true once per finished save, filling in whether it worked and the error if not
+    bool Poll(bool& succeeded, std::string& error);
+    // Blocks until the running save, if any, has finished; Poll still reports its result afterwards
+    void Wait();
+
+private:
+    std::thread worker;
+    std::string filePath;
+    LevelFormat format = LevelFormat::Text;
+    std::atomic<float> progress{0.0f};
+    std::atomic<bool> finished{false};
+    bool succeeded = false;
+    std::string error;
+};
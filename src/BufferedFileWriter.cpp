@@ -0,0 +1,309 @@
+#include "BufferedFileWriter.h"
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+static const char kDigitPairs[201] =
+        "00010203040506070809"
+        "10111213141516171819"
+        "20212223242526272829"
+        "30313233343536373839"
+        "40414243444546474849"
+        "50515253545556575859"
+        "60616263646566676869"
+        "70717273747576777879"
+        "80818283848586878889"
+        "90919293949596979899";
+
+BufferedFileWriter::BufferedFileWriter(size_t capacity) : buffer(capacity < 64 ? 64 : capacity) {
+}
+
+BufferedFileWriter::~BufferedFileWriter() {
+    if (fd != -1) {
+        std::string error;
+        Close(error);
+    }
+}
+
+bool BufferedFileWriter::Open(const char* filePath, std::string& error) {
+    fd = open(filePath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1) {
+        error = std::string("Could not create ") + filePath + ": " + strerror(errno);
+        return false;
+    }
+
+    this->filePath = filePath;
+    used = 0;
+    flushedBytes = 0;
+    writeErrno = 0;
+
+    return true;
+}
+
+bool BufferedFileWriter::Close(std::string& error) {
+    if (fd == -1) {
+        return writeErrno == 0;
+    }
+
+    Flush();
+
+    // Make sure the data is on disk before callers rename the file over an older one
+    if (writeErrno == 0 && fsync(fd) != 0) {
+        writeErrno = errno;
+    }
+
+    if (close(fd) != 0 && writeErrno == 0) {
+        writeErrno = errno;
+    }
+    fd = -1;
+
+    if (writeErrno != 0) {
+        error = "Could not write " + filePath + ": " + strerror(writeErrno);
+        return false;
+    }
+
+    return true;
+}
+
+void BufferedFileWriter::Flush() {
+    const char* data = buffer.data();
+    size_t remaining = used;
+
+    while (remaining > 0 && writeErrno == 0) {
+        ssize_t written = write(fd, data, remaining);
+        if (written < 0) {
+            if (errno != EINTR) {
+                writeErrno = errno;
+            }
+            continue;
+        }
+
+        data += written;
+        remaining -= static_cast<size_t>(written);
+    }
+
+    flushedBytes += used;
+    used = 0;
+}
+
+void BufferedFileWriter::Write(const void* data, size_t size) {
+    // Empty tables hand in a null pointer, which memcpy mustn't see even with a size of 0
+    if (size == 0) {
+        return;
+    }
+
+    if (size > buffer.size() - used) {
+        Flush();
+
+        // Too big to be worth copying: hand it straight to the OS
+        if (size >= buffer.size()) {
+            const char* bytes = static_cast<const char*>(data);
+            while (size > 0 && writeErrno == 0) {
+                ssize_t written = write(fd, bytes, size);
+                if (written < 0) {
+                    if (errno != EINTR) {
+                        writeErrno = errno;
+                    }
+                    continue;
+                }
+
+                bytes += written;
+                size -= static_cast<size_t>(written);
+                flushedBytes += static_cast<size_t>(written);
+            }
+            return;
+        }
+    }
+
+    memcpy(buffer.data() + used, data, size);
+    used += size;
+}
+
+void BufferedFileWriter::WriteUnsigned(unsigned long long value) {
+    char digits[20];
+    char* end = digits + sizeof(digits);
+    char* p = end;
+
+    while (value >= 100) {
+        unsigned pair = static_cast<unsigned>(value % 100) * 2;
+        value /= 100;
+        *--p = kDigitPairs[pair + 1];
+        *--p = kDigitPairs[pair];
+    }
+
+    if (value >= 10) {
+        unsigned pair = static_cast<unsigned>(value) * 2;
+        *--p = kDigitPairs[pair + 1];
+        *--p = kDigitPairs[pair];
+    } else {
+        *--p = static_cast<char>('0' + value);
+    }
+
+    Reserve(sizeof(digits) + 1);
+    memcpy(buffer.data() + used, p, static_cast<size_t>(end - p));
+    used += static_cast<size_t>(end - p);
+}
+
+void BufferedFileWriter::WriteInt(long long value) {
+    if (value < 0) {
+        WriteChar('-');
+        // Negate in unsigned arithmetic so the most negative value doesn't overflow
+        WriteUnsigned(0ULL - static_cast<unsigned long long>(value));
+    } else {
+        WriteUnsigned(static_cast<unsigned long long>(value));
+    }
+}
+
+// Significant digits of %g's default precision
+static const int kFloatDigits = 6;
+// A float's exact value needs at most 112 decimal digits, 13 limbs of 9
+static const int kMaxFloatLimbs = 16;
+
+// Multiplies a little-endian base 10^9 number by factor, which must be below 2^32
+static void MultiplyLimbs(uint32_t* limbs, int& count, uint32_t factor) {
+    uint64_t carry = 0;
+    for (int i = 0; i < count; i++) {
+        uint64_t product = static_cast<uint64_t>(limbs[i]) * factor + carry;
+        limbs[i] = static_cast<uint32_t>(product % 1000000000);
+        carry = product / 1000000000;
+    }
+    while (carry > 0) {
+        limbs[count++] = static_cast<uint32_t>(carry % 1000000000);
+        carry /= 1000000000;
+    }
+}
+
+// Formats a finite, non-zero value like printf's %.6g in the C locale, into text, which needs room
+// for 16 characters; returns the length. A float is m * 2^k with m below 2^24, so its exact decimal
+// digits come from multiplying m by 2^k, or by 5^-k for a fraction, in a small bignum. Rounding
+// those to six digits, ties to even, gives the same digits printf does.
+static int FormatFloat(float value, char* text) {
+    int length = 0;
+    if (std::signbit(value)) {
+        text[length++] = '-';
+    }
+
+    int binaryExponent;
+    float mantissa = std::frexp(std::fabs(value), &binaryExponent);
+    uint32_t m = static_cast<uint32_t>(std::ldexp(mantissa, 24));
+    int k = binaryExponent - 24;
+    while (k < 0 && m % 2 == 0) {
+        m /= 2;
+        k++;
+    }
+
+    uint32_t limbs[kMaxFloatLimbs] = {m};
+    int limbCount = 1;
+    int fractionDigits = 0;
+    for (; k > 0; k -= std::min(k, 29)) {
+        MultiplyLimbs(limbs, limbCount, 1u << std::min(k, 29));
+    }
+    for (; k < 0; k += std::min(-k, 13)) {
+        // m * 2^k is m * 5^-k / 10^-k
+        static const uint32_t kPowersOfFive[14] = {1, 5, 25, 125, 625, 3125, 15625, 78125, 390625, 1953125, 9765625, 48828125, 244140625, 1220703125};
+        MultiplyLimbs(limbs, limbCount, kPowersOfFive[std::min(-k, 13)]);
+        fractionDigits += std::min(-k, 13);
+    }
+
+    char digits[kMaxFloatLimbs * 9];
+    int digitCount = 0;
+    for (uint32_t top = limbs[limbCount - 1]; top > 0; top /= 10) {
+        digits[digitCount++] = static_cast<char>('0' + top % 10);
+    }
+    std::reverse(digits, digits + digitCount);
+    for (int i = limbCount - 2; i >= 0; i--) {
+        uint32_t limb = limbs[i];
+        for (int digit = 8; digit >= 0; digit--) {
+            digits[digitCount + digit] = static_cast<char>('0' + limb % 10);
+            limb /= 10;
+        }
+        digitCount += 9;
+    }
+    // Power of ten of the first digit
+    int exponent = digitCount - 1 - fractionDigits;
+
+    if (digitCount > kFloatDigits) {
+        bool tail = false;
+        for (int i = kFloatDigits + 1; i < digitCount; i++) {
+            tail |= digits[i] != '0';
+        }
+        char next = digits[kFloatDigits];
+        bool roundUp = next > '5' || (next == '5' && (tail || (digits[kFloatDigits - 1] - '0') % 2 == 1));
+        digitCount = kFloatDigits;
+
+        for (int i = kFloatDigits - 1; roundUp && i >= 0; i--) {
+            roundUp = digits[i] == '9';
+            digits[i] = roundUp ? '0' : static_cast<char>(digits[i] + 1);
+        }
+        if (roundUp) {
+            digits[0] = '1';
+            exponent++;
+        }
+    }
+    while (digitCount > 1 && digits[digitCount - 1] == '0') {
+        digitCount--;
+    }
+
+    if (exponent < -4 || exponent >= kFloatDigits) {
+        text[length++] = digits[0];
+        if (digitCount > 1) {
+            text[length++] = '.';
+            memcpy(text + length, digits + 1, static_cast<size_t>(digitCount - 1));
+            length += digitCount - 1;
+        }
+        text[length++] = 'e';
+        text[length++] = exponent < 0 ? '-' : '+';
+        int magnitude = std::abs(exponent);
+        text[length++] = kDigitPairs[magnitude * 2];
+        text[length++] = kDigitPairs[magnitude * 2 + 1];
+    } else if (exponent < 0) {
+        text[length++] = '0';
+        text[length++] = '.';
+        for (int i = exponent + 1; i < 0; i++) {
+            text[length++] = '0';
+        }
+        memcpy(text + length, digits, static_cast<size_t>(digitCount));
+        length += digitCount;
+    } else {
+        for (int i = 0; i <= exponent; i++) {
+            text[length++] = i < digitCount ? digits[i] : '0';
+        }
+        if (digitCount > exponent + 1) {
+            text[length++] = '.';
+            memcpy(text + length, digits + exponent + 1, static_cast<size_t>(digitCount - exponent - 1));
+            length += digitCount - exponent - 1;
+        }
+    }
+
+    return length;
+}
+
+void BufferedFileWriter::WriteFloat(float value) {
+    // Whole numbers below 10^6 print without a decimal point or exponent under %g, like integers.
+    // That covers most spawn coordinates, so they skip the digit generation entirely.
+    if (value == std::floor(value) && std::fabs(value) < 1e6f) {
+        if (value == 0.0f && std::signbit(value)) {
+            WriteChar('-');
+        }
+        WriteInt(static_cast<long long>(value));
+        return;
+    }
+
+    if (std::isnan(value)) {
+        WriteString("nan");
+        return;
+    }
+    if (std::isinf(value)) {
+        WriteString(value < 0.0f ? "-inf" : "inf");
+        return;
+    }
+
+    char text[16];
+    Write(text, static_cast<size_t>(FormatFloat(value, text)));
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Formats into a large in-memory buffer and hands it to the OS in a few big write() calls.
+// Number formatting never consults the C or C++ locale, but matches what a default-constructed
+// std::ostream in the "C" locale produces, so text files stay byte-identical to the old iostream output.
+class BufferedFileWriter {
+public:
+    explicit BufferedFileWriter(size_t capacity = 1 << 20);
+    ~BufferedFileWriter();
+    BufferedFileWriter(const BufferedFileWriter&) = delete;
+    BufferedFileWriter& operator=(const BufferedFileWriter&) = delete;
+
+    bool Open(const char* filePath, std::string& error);
+    // Flushes what is left, syncs and closes the file; false if any write along the way failed
+    bool Close(std::string& error);
+
+    void Write(const void* data, size_t size);
+    void WriteChar(char c) {
+        if (used == buffer.size()) {
+            Flush();
+        }
+        buffer[used++] = c;
+    }
+    void WriteString(const std::string& text) { Write(text.data(), text.size()); }
+    void WriteInt(long long value);
+    void WriteUnsigned(unsigned long long value);
+    // Same digits as operator<< with the default precision of 6, i.e. printf's %g, always with a '.' whatever the locale
+    void WriteFloat(float value);
+
+    size_t BytesWritten() const { return flushedBytes + used; }
+
+private:
+    void Flush();
+    // Makes sure at least size bytes are free at the end of the buffer
+    void Reserve(size_t size) {
+        if (buffer.size() - used < size) {
+            Flush();
+        }
+    }
+
+    int fd = -1;
+    std::vector<char> buffer;
+    size_t used = 0;
+    size_t flushedBytes = 0;
+    int writeErrno = 0;
+    std::string filePath;
+};
@@ -0,0 +1,47 @@
+#include "ContentHash.h"
+#include <cstring>
+#include <string>
+#include "MappedFile.h"
+
+uint64_t ContentHash64(const void* data, size_t size, uint64_t seed) {
+    const uint64_t m = 0xc6a4a7935bd1e995ull;
+    const int r = 47;
+
+    uint64_t hash = seed ^ (size * m);
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    const unsigned char* end = p + (size & ~static_cast<size_t>(7));
+    for (; p != end; p += 8) {
+        uint64_t k;
+        memcpy(&k, p, sizeof(k));
+        k *= m;
+        k ^= k >> r;
+        k *= m;
+        hash ^= k;
+        hash *= m;
+    }
+
+    // The last one to seven bytes, mixed in the same way as MurmurHash64A's fallthrough switch
+    size_t tail = size & 7;
+    if (tail > 0) {
+        for (size_t i = 0; i < tail; i++) {
+            hash ^= static_cast<uint64_t>(p[i]) << (i * 8);
+        }
+        hash *= m;
+    }
+
+    hash ^= hash >> r;
+    hash *= m;
+    hash ^= hash >> r;
+    return hash;
+}
+
+bool ContentHashFile(const char* filePath, uint64_t& hash) {
+    MappedFile file;
+    std::string error;
+    if (!file.Open(filePath, false, error)) {
+        return false;
+    }
+
+    hash = ContentHash64(file.Data(), file.Size());
+    return true;
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// 64-bit MurmurHash2 (MurmurHash64A) of size bytes. Reads eight bytes at a time, so it runs at
+// several GB/s, which makes hashing whole image files and pixel buffers cheap next to decoding them.
+// Not cryptographic, and words are read in native byte order, so hashes are only meant to be
+// compared on the machine that made them.
+uint64_t ContentHash64(const void* data, size_t size, uint64_t seed = 0);
+
+// Hashes a whole file; false if it can't be read
+bool ContentHashFile(const char* filePath, uint64_t& hash);
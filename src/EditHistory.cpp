@@ -0,0 +1,238 @@
+#include "EditHistory.h"
+
+static const size_t kCellBlockChanges = 256;
+
+namespace {
+
+struct CellChange {
+    int x;
+    int y;
+    short before;
+    short after;
+};
+
+}
+
+static uint32_t Zigzag(int value) {
+    return (static_cast<uint32_t>(value) << 1) ^ static_cast<uint32_t>(value >> 31);
+}
+
+static int Unzigzag(uint32_t value) {
+    return static_cast<int>(value >> 1) ^ -static_cast<int>(value & 1);
+}
+
+static void AppendVarint(std::vector<unsigned char>& out, uint32_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<unsigned char>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<unsigned char>(value));
+}
+
+static uint32_t ReadVarint(const unsigned char*& p) {
+    uint32_t value = 0;
+    for (int shift = 0;; shift += 7) {
+        unsigned char byte = *p++;
+        value |= static_cast<uint32_t>(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) {
+            return value;
+        }
+    }
+}
+
+// Decodes the count changes of one block, which starts at data
+static void DecodeCellBlock(const unsigned char* data, size_t count, CellChange* changes) {
+    int x = 0;
+    int y = 0;
+    for (size_t i = 0; i < count; i++) {
+        x += Unzigzag(ReadVarint(data));
+        y += Unzigzag(ReadVarint(data));
+        changes[i].x = x;
+        changes[i].y = y;
+        changes[i].before = static_cast<short>(Unzigzag(ReadVarint(data)));
+        changes[i].after = static_cast<short>(Unzigzag(ReadVarint(data)));
+    }
+}
+
+size_t EditHistory::Command::MemoryUsage() const {
+    size_t bytes = sizeof(Command) + cells.capacity() + blockOffsets.capacity() * sizeof(size_t) +
+                   spawns.capacity() * sizeof(SpawnChange) + textureNames.capacity() * sizeof(TextureNameChange);
+    for (const TextureNameChange& change : textureNames) {
+        bytes += change.name.capacity();
+    }
+
+    return bytes;
+}
+
+EditHistory::EditHistory(size_t memoryBudget) : memoryBudget(memoryBudget) {
+}
+
+void EditHistory::RecordCell(int x, int y, short before, short after) {
+    if (before == after) {
+        return;
+    }
+
+    if (open.cellCount % kCellBlockChanges == 0) {
+        open.blockOffsets.push_back(open.cells.size());
+        open.lastX = 0;
+        open.lastY = 0;
+    }
+
+    AppendVarint(open.cells, Zigzag(x - open.lastX));
+    AppendVarint(open.cells, Zigzag(y - open.lastY));
+    AppendVarint(open.cells, Zigzag(before));
+    AppendVarint(open.cells, Zigzag(after));
+
+    open.lastX = x;
+    open.lastY = y;
+    open.cellCount++;
+}
+
+void EditHistory::RecordSpawn(size_t index, bool hadBefore, const EnemySpawnLocation& before, const EnemySpawnLocation& after) {
+    // Typing into a spawn's fields changes it a character at a time; keep just the first before and last after
+    if (!open.spawns.empty() && open.spawns.back().index == index) {
+        open.spawns.back().after = after;
+        return;
+    }
+
+    SpawnChange change;
+    change.index = index;
+    change.hadBefore = hadBefore;
+    change.before = before;
+    change.after = after;
+    open.spawns.push_back(change);
+}
+
+void EditHistory::RecordTextureName(const std::string& name, bool hadBefore, short before, short after) {
+    TextureNameChange change;
+    change.name = name;
+    change.hadBefore = hadBefore;
+    change.before = before;
+    change.after = after;
+    open.textureNames.push_back(change);
+}
+
+void EditHistory::Commit() {
+    if (!HasOpenCommand()) {
+        return;
+    }
+
+    while (commands.size() > position) {
+        memoryUsage -= commands.back().MemoryUsage();
+        commands.pop_back();
+    }
+
+    open.cells.shrink_to_fit();
+    open.blockOffsets.shrink_to_fit();
+    memoryUsage += open.MemoryUsage();
+    commands.push_back(std::move(open));
+    position = commands.size();
+    open = Command();
+
+    EvictToBudget();
+}
+
+void EditHistory::EvictToBudget() {
+    while (memoryUsage > memoryBudget && commands.size() > 1 && position > 0) {
+        memoryUsage -= commands.front().MemoryUsage();
+        commands.pop_front();
+        position--;
+    }
+}
+
+bool EditHistory::CanUndo() const {
+    return HasOpenCommand() || position > 0;
+}
+
+void EditHistory::UndoCells(const Command& command, EditTarget& target) {
+    CellChange changes[kCellBlockChanges];
+
+    // Newest block first, and newest change first within it, so a cell changed twice ends up at its first before
+    for (size_t block = command.blockOffsets.size(); block-- > 0;) {
+        size_t count = block + 1 < command.blockOffsets.size() ? kCellBlockChanges : command.cellCount - block * kCellBlockChanges;
+        DecodeCellBlock(command.cells.data() + command.blockOffsets[block], count, changes);
+
+        for (size_t i = count; i-- > 0;) {
+            target.ApplyTile(changes[i].x, changes[i].y, changes[i].before);
+        }
+    }
+}
+
+void EditHistory::RedoCells(const Command& command, EditTarget& target) {
+    CellChange changes[kCellBlockChanges];
+
+    for (size_t block = 0; block < command.blockOffsets.size(); block++) {
+        size_t count = block + 1 < command.blockOffsets.size() ? kCellBlockChanges : command.cellCount - block * kCellBlockChanges;
+        DecodeCellBlock(command.cells.data() + command.blockOffsets[block], count, changes);
+
+        for (size_t i = 0; i < count; i++) {
+            target.ApplyTile(changes[i].x, changes[i].y, changes[i].after);
+        }
+    }
+}
+
+bool EditHistory::Undo(EditTarget& target) {
+    Commit();
+    if (position == 0) {
+        return false;
+    }
+
+    position--;
+    const Command& command = commands[position];
+
+    UndoCells(command, target);
+
+    for (size_t i = command.spawns.size(); i-- > 0;) {
+        const SpawnChange& change = command.spawns[i];
+        if (change.hadBefore) {
+            target.ApplySpawn(change.index, change.before);
+        } else {
+            target.RemoveLastSpawn();
+        }
+    }
+
+    for (size_t i = command.textureNames.size(); i-- > 0;) {
+        const TextureNameChange& change = command.textureNames[i];
+        if (change.hadBefore) {
+            target.ApplyTextureName(change.name, change.before);
+        } else {
+            target.RemoveTextureName(change.name);
+        }
+    }
+
+    return true;
+}
+
+bool EditHistory::Redo(EditTarget& target) {
+    Commit();
+    if (position == commands.size()) {
+        return false;
+    }
+
+    const Command& command = commands[position];
+    position++;
+
+    RedoCells(command, target);
+
+    for (const SpawnChange& change : command.spawns) {
+        target.ApplySpawn(change.index, change.after);
+    }
+
+    for (const TextureNameChange& change : command.textureNames) {
+        target.ApplyTextureName(change.name, change.after);
+    }
+
+    return true;
+}
+
+void EditHistory::Clear() {
+    commands.clear();
+    position = 0;
+    open = Command();
+    memoryUsage = 0;
+}
+
+void EditHistory::SetMemoryBudget(size_t bytes) {
+    memoryBudget = bytes;
+    EvictToBudget();
+}
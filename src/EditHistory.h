@@ -0,0 +1,103 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+#include "Level.h"
+
+static const size_t kDefaultEditHistoryBudget = 64 * 1024 * 1024;
+
+// Where undo and redo write their changes. The editor implements this so restored cells are
+// journaled and redrawn like any other edit.
+class EditTarget {
+public:
+    virtual ~EditTarget() = default;
+
+    virtual void ApplyTile(int x, int y, short id) = 0;
+    // index == spawn count appends
+    virtual void ApplySpawn(size_t index, const EnemySpawnLocation& location) = 0;
+    virtual void RemoveLastSpawn() = 0;
+    virtual void ApplyTextureName(const std::string& name, short id) = 0;
+    virtual void RemoveTextureName(const std::string& name) = 0;
+};
+
+// Undo/redo stack of edit deltas. Nothing is ever snapshotted: each command stores only the cells,
+// spawns and texture names it changed, so undoing or redoing costs O(changes) whatever the level size.
+//
+// Edits are recorded into an open command until Commit() closes it, which is how a whole paint
+// stroke becomes a single undo step. Once the commands' memory passes the budget the oldest are
+// evicted; the newest command is always kept, however big.
+class EditHistory {
+public:
+    explicit EditHistory(size_t memoryBudget = kDefaultEditHistoryBudget);
+
+    void RecordCell(int x, int y, short before, short after);
+    // hadBefore is false when the spawn was appended
+    void RecordSpawn(size_t index, bool hadBefore, const EnemySpawnLocation& before, const EnemySpawnLocation& after);
+    // hadBefore is false when the name wasn't mapped to any id
+    void RecordTextureName(const std::string& name, bool hadBefore, short before, short after);
+
+    // Closes the open command, if it changed anything, and drops whatever could have been redone
+    void Commit();
+
+    bool CanUndo() const;
+    bool CanRedo() const { return !HasOpenCommand() && position < commands.size(); }
+    // Both commit the open command first
+    bool Undo(EditTarget& target);
+    bool Redo(EditTarget& target);
+
+    void Clear();
+
+    void SetMemoryBudget(size_t bytes);
+    size_t MemoryBudget() const { return memoryBudget; }
+    size_t MemoryUsage() const { return memoryUsage; }
+    size_t UndoCount() const { return position; }
+    size_t RedoCount() const { return commands.size() - position; }
+
+private:
+    struct SpawnChange {
+        size_t index;
+        bool hadBefore;
+        EnemySpawnLocation before;
+        EnemySpawnLocation after;
+    };
+
+    struct TextureNameChange {
+        std::string name;
+        bool hadBefore;
+        short before;
+        short after;
+    };
+
+    // Cell changes are packed as varints: zigzag x and y deltas from the previous change, then the
+    // zigzagged old and new ids. Painting and fills move one cell at a time, so a change usually
+    // takes 4 bytes. Every kCellBlockChanges changes the deltas restart from (0, 0), which lets
+    // undo walk the changes backwards a block at a time.
+    struct Command {
+        std::vector<unsigned char> cells;
+        std::vector<size_t> blockOffsets;
+        size_t cellCount = 0;
+        int lastX = 0;
+        int lastY = 0;
+        std::vector<SpawnChange> spawns;
+        std::vector<TextureNameChange> textureNames;
+
+        bool Empty() const { return cellCount == 0 && spawns.empty() && textureNames.empty(); }
+        size_t MemoryUsage() const;
+    };
+
+    bool HasOpenCommand() const { return !open.Empty(); }
+    void EvictToBudget();
+
+    static void UndoCells(const Command& command, EditTarget& target);
+    static void RedoCells(const Command& command, EditTarget& target);
+
+    std::deque<Command> commands;
+    // Commands before position can be undone; the rest can be redone
+    size_t position = 0;
+    Command open;
+    size_t memoryBudget;
+    size_t memoryUsage = 0;
+};
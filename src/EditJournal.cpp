@@ -0,0 +1,404 @@
+#include "EditJournal.h"
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const size_t kBatchHeaderSize = 8;
+
+static uint32_t Load32(const unsigned char* p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+static void Store32(unsigned char* p, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        p[i] = static_cast<unsigned char>(value >> (8 * i));
+    }
+}
+
+static void Store64(unsigned char* p, uint64_t value) {
+    Store32(p, static_cast<uint32_t>(value));
+    Store32(p + 4, static_cast<uint32_t>(value >> 32));
+}
+
+static uint32_t HashBatch(const unsigned char* data, size_t size) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ data[i]) * 16777619u;
+    }
+
+    return hash;
+}
+
+static bool WriteAll(int fd, const unsigned char* data, size_t size) {
+    while (size > 0) {
+        ssize_t written = write(fd, data, size);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+
+        data += written;
+        size -= static_cast<size_t>(written);
+    }
+
+    return true;
+}
+
+static bool ReadWholeFile(const std::string& filePath, std::vector<unsigned char>& contents) {
+    int fd = open(filePath.c_str(), O_RDONLY);
+    if (fd == -1) {
+        return false;
+    }
+
+    unsigned char buffer[64 * 1024];
+    for (;;) {
+        ssize_t count = read(fd, buffer, sizeof(buffer));
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count <= 0) {
+            close(fd);
+            return count == 0;
+        }
+
+        contents.insert(contents.end(), buffer, buffer + count);
+    }
+}
+
+// The header records which version of the level file the journal's edits apply to
+static bool MakeHeader(const std::string& levelPath, unsigned char* header, std::string& error) {
+    struct stat levelStat;
+    if (stat(levelPath.c_str(), &levelStat) != 0) {
+        error = "Could not stat " + levelPath + ": " + strerror(errno);
+        return false;
+    }
+
+    memcpy(header, kEditJournalMagic, sizeof(kEditJournalMagic));
+    Store32(header + 4, kEditJournalVersion);
+    Store64(header + 8, static_cast<uint64_t>(levelStat.st_size));
+    Store64(header + 16, static_cast<uint64_t>(levelStat.st_mtime));
+    return true;
+}
+
+// Applies one batch's records to level. Returns the number applied, stopping early at a malformed record.
+static size_t ApplyRecords(const unsigned char* data, size_t size, Level& level) {
+    const unsigned char* p = data;
+    const unsigned char* end = data + size;
+    size_t applied = 0;
+
+    while (p != end) {
+        EditJournalRecord type = static_cast<EditJournalRecord>(*p++);
+        size_t remaining = static_cast<size_t>(end - p);
+
+        if (type == EditJournalRecord_Cell && remaining >= 10) {
+            int x = static_cast<int32_t>(Load32(p));
+            int y = static_cast<int32_t>(Load32(p + 4));
+            short id = static_cast<short>(p[8] | (p[9] << 8));
+            level.grid.Set(x, y, id);
+            p += 10;
+        } else if (type == EditJournalRecord_Spawn && remaining >= 16) {
+            size_t index = Load32(p);
+            if (index > level.enemySpawnLocations.size()) {
+                break;
+            }
+
+            EnemySpawnLocation location;
+            location.textureId = static_cast<int32_t>(Load32(p + 4));
+            uint32_t bits = Load32(p + 8);
+            memcpy(&location.x, &bits, sizeof(bits));
+            bits = Load32(p + 12);
+            memcpy(&location.y, &bits, sizeof(bits));
+
+            if (index == level.enemySpawnLocations.size()) {
+                level.enemySpawnLocations.push_back(location);
+            } else {
+                level.enemySpawnLocations[index] = location;
+            }
+            p += 16;
+        } else if (type == EditJournalRecord_SpawnCount && remaining >= 4) {
+            size_t count = Load32(p);
+            if (count < level.enemySpawnLocations.size()) {
+                level.enemySpawnLocations.resize(count);
+            }
+            p += 4;
+        } else if (type == EditJournalRecord_TextureName && remaining >= 4) {
+            short id = static_cast<short>(p[0] | (p[1] << 8));
+            size_t nameLength = p[2] | (p[3] << 8);
+            if (remaining - 4 < nameLength) {
+                break;
+            }
+
+            level.textureNameToTextureIdMap[std::string(reinterpret_cast<const char*>(p + 4), nameLength)] = id;
+            p += 4 + nameLength;
+        } else if (type == EditJournalRecord_TextureNameRemoval && remaining >= 2) {
+            size_t nameLength = p[0] | (p[1] << 8);
+            if (remaining - 2 < nameLength) {
+                break;
+            }
+
+            level.textureNameToTextureIdMap.erase(std::string(reinterpret_cast<const char*>(p + 2), nameLength));
+            p += 2 + nameLength;
+        } else {
+            break;
+        }
+
+        applied++;
+    }
+
+    return applied;
+}
+
+std::string EditJournalPath(const std::string& levelPath) {
+    return levelPath + ".journal";
+}
+
+EditJournal::~EditJournal() {
+    Close();
+}
+
+bool EditJournal::Open(const std::string& levelPath, Level& level, size_t& replayedEdits, std::string& error) {
+    Close();
+    replayedEdits = 0;
+
+    unsigned char header[kEditJournalHeaderSize];
+    if (!MakeHeader(levelPath, header, error)) {
+        return false;
+    }
+
+    std::string journalPath = EditJournalPath(levelPath);
+    std::vector<unsigned char> contents;
+    size_t validSize = 0;
+
+    if (ReadWholeFile(journalPath, contents) && !contents.empty()) {
+        if (contents.size() >= kEditJournalHeaderSize && memcmp(contents.data(), header, kEditJournalHeaderSize) == 0) {
+            validSize = kEditJournalHeaderSize;
+
+            while (contents.size() - validSize >= kBatchHeaderSize) {
+                const unsigned char* batch = contents.data() + validSize;
+                uint32_t payloadSize = Load32(batch);
+                if (payloadSize > contents.size() - validSize - kBatchHeaderSize ||
+                    HashBatch(batch + kBatchHeaderSize, payloadSize) != Load32(batch + 4)) {
+                    break;
+                }
+
+                replayedEdits += ApplyRecords(batch + kBatchHeaderSize, payloadSize, level);
+                validSize += kBatchHeaderSize + payloadSize;
+            }
+
+            if (validSize != contents.size()) {
+                fprintf(stderr, "Dropping %zu bytes of incomplete edits from %s\n", contents.size() - validSize, journalPath.c_str());
+            }
+        } else {
+            fprintf(stderr, "Ignoring %s: it doesn't match the current level file\n", journalPath.c_str());
+        }
+    }
+
+    if (validSize == 0) {
+        fd = open(journalPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+        if (fd != -1 && (!WriteAll(fd, header, sizeof(header)) || fsync(fd) != 0)) {
+            error = "Could not write " + journalPath + ": " + strerror(errno);
+            close(fd);
+            fd = -1;
+            return false;
+        }
+        validSize = kEditJournalHeaderSize;
+    } else {
+        fd = open(journalPath.c_str(), O_WRONLY | O_APPEND);
+        // Cut off a torn batch so new batches aren't appended after it, where replay would never reach them
+        if (fd != -1 && validSize != contents.size() && ftruncate(fd, static_cast<off_t>(validSize)) != 0) {
+            error = "Could not truncate " + journalPath + ": " + strerror(errno);
+            close(fd);
+            fd = -1;
+            return false;
+        }
+    }
+
+    if (fd == -1) {
+        error = "Could not open " + journalPath + ": " + strerror(errno);
+        return false;
+    }
+
+    this->levelPath = levelPath;
+    size = validSize;
+    pending.clear();
+
+    return true;
+}
+
+void EditJournal::Close() {
+    if (fd != -1) {
+        std::string error;
+        if (!Flush(error)) {
+            fprintf(stderr, "Error writing edit journal: %s\n", error.c_str());
+        }
+
+        close(fd);
+        fd = -1;
+    }
+
+    levelPath.clear();
+    size = 0;
+    pending.clear();
+}
+
+void EditJournal::AppendRecordType(EditJournalRecord type) {
+    pending.push_back(type);
+}
+
+void EditJournal::Append(const void* bytes, size_t count) {
+    const unsigned char* data = static_cast<const unsigned char*>(bytes);
+    pending.insert(pending.end(), data, data + count);
+}
+
+void EditJournal::Append16(uint16_t value) {
+    pending.push_back(static_cast<unsigned char>(value));
+    pending.push_back(static_cast<unsigned char>(value >> 8));
+}
+
+void EditJournal::Append32(uint32_t value) {
+    unsigned char bytes[4];
+    Store32(bytes, value);
+    Append(bytes, sizeof(bytes));
+}
+
+void EditJournal::RecordCell(int x, int y, short id) {
+    if (fd == -1) {
+        return;
+    }
+
+    AppendRecordType(EditJournalRecord_Cell);
+    Append32(static_cast<uint32_t>(x));
+    Append32(static_cast<uint32_t>(y));
+    Append16(static_cast<uint16_t>(id));
+}
+
+void EditJournal::RecordSpawn(size_t index, const EnemySpawnLocation& location) {
+    if (fd == -1) {
+        return;
+    }
+
+    uint32_t xBits;
+    uint32_t yBits;
+    memcpy(&xBits, &location.x, sizeof(xBits));
+    memcpy(&yBits, &location.y, sizeof(yBits));
+
+    AppendRecordType(EditJournalRecord_Spawn);
+    Append32(static_cast<uint32_t>(index));
+    Append32(static_cast<uint32_t>(location.textureId));
+    Append32(xBits);
+    Append32(yBits);
+}
+
+void EditJournal::RecordSpawnCount(size_t count) {
+    if (fd == -1) {
+        return;
+    }
+
+    AppendRecordType(EditJournalRecord_SpawnCount);
+    Append32(static_cast<uint32_t>(count));
+}
+
+void EditJournal::RecordTextureName(const std::string& name, short id) {
+    if (fd == -1) {
+        return;
+    }
+
+    size_t nameLength = name.size() < 0xffff ? name.size() : 0xffff;
+
+    AppendRecordType(EditJournalRecord_TextureName);
+    Append16(static_cast<uint16_t>(id));
+    Append16(static_cast<uint16_t>(nameLength));
+    Append(name.data(), nameLength);
+}
+
+void EditJournal::RecordTextureNameRemoval(const std::string& name) {
+    if (fd == -1) {
+        return;
+    }
+
+    size_t nameLength = name.size() < 0xffff ? name.size() : 0xffff;
+
+    AppendRecordType(EditJournalRecord_TextureNameRemoval);
+    Append16(static_cast<uint16_t>(nameLength));
+    Append(name.data(), nameLength);
+}
+
+bool EditJournal::Flush(std::string& error) {
+    if (fd == -1 || pending.empty()) {
+        return true;
+    }
+
+    unsigned char batchHeader[kBatchHeaderSize];
+    Store32(batchHeader, static_cast<uint32_t>(pending.size()));
+    Store32(batchHeader + 4, HashBatch(pending.data(), pending.size()));
+
+    if (!WriteAll(fd, batchHeader, sizeof(batchHeader)) || !WriteAll(fd, pending.data(), pending.size()) || fsync(fd) != 0) {
+        error = "Could not append to " + EditJournalPath(levelPath) + ": " + strerror(errno);
+        // Drop the partial batch so a later retry lands where replay can find it
+        if (ftruncate(fd, static_cast<off_t>(size)) != 0) {
+            fprintf(stderr, "Could not truncate %s: %s\n", EditJournalPath(levelPath).c_str(), strerror(errno));
+        }
+        return false;
+    }
+
+    size += sizeof(batchHeader) + pending.size();
+    pending.clear();
+
+    return true;
+}
+
+bool EditJournal::Rebase(const std::string& levelPath, uint64_t keepFrom, std::string& error) {
+    if (!Flush(error)) {
+        return false;
+    }
+
+    std::vector<unsigned char> contents(kEditJournalHeaderSize);
+    if (!MakeHeader(levelPath, contents.data(), error)) {
+        return false;
+    }
+
+    // Batches written after the save took its snapshot aren't in the saved file yet
+    if (fd != -1 && keepFrom < size) {
+        std::vector<unsigned char> previous;
+        if (!ReadWholeFile(EditJournalPath(this->levelPath), previous) || previous.size() < size) {
+            error = "Could not read " + EditJournalPath(this->levelPath);
+            return false;
+        }
+
+        uint64_t tailStart = keepFrom < kEditJournalHeaderSize ? kEditJournalHeaderSize : keepFrom;
+        contents.insert(contents.end(), previous.begin() + static_cast<ptrdiff_t>(tailStart), previous.begin() + static_cast<ptrdiff_t>(size));
+    }
+
+    std::string journalPath = EditJournalPath(levelPath);
+    std::string temporaryPath = journalPath + ".tmp";
+
+    int newFd = open(temporaryPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+    if (newFd == -1) {
+        error = "Could not create " + temporaryPath + ": " + strerror(errno);
+        return false;
+    }
+
+    if (!WriteAll(newFd, contents.data(), contents.size()) || fsync(newFd) != 0 ||
+        rename(temporaryPath.c_str(), journalPath.c_str()) != 0) {
+        error = "Could not write " + journalPath + ": " + strerror(errno);
+        close(newFd);
+        remove(temporaryPath.c_str());
+        return false;
+    }
+
+    // The renamed descriptor now refers to the new journal, so keep appending through it
+    if (fd != -1) {
+        close(fd);
+    }
+
+    fd = newFd;
+    this->levelPath = levelPath;
+    size = contents.size();
+
+    return true;
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Level.h"
+
+// Append-only log of edits made since a level file was last saved in full, kept next to it as
+// "<level path>.journal". Replaying it over the saved level recovers edits lost to a crash, and
+// autosaving only has to append a few bytes instead of rewriting the whole level.
+//
+// File layout (little-endian):
+//   header: "MFJL", uint32 version, uint64 level file size, int64 level file mtime
+//   batches: uint32 payload size, uint32 FNV-1a hash of the payload, then the payload records
+//
+// Each record is a uint8 EditJournalRecord followed by its fields. Records hold absolute values
+// rather than deltas, so replaying one that's already part of the level is harmless. A batch that
+// was only partly written when the editor died fails its hash and is dropped along with the rest.
+//
+// The header ties the journal to one version of the level file; a journal whose level has since
+// been replaced by something else is ignored.
+enum EditJournalRecord : uint8_t {
+    // int32 x, int32 y, int16 tile id
+    EditJournalRecord_Cell = 1,
+    // uint32 index, int32 texture id, float32 x, float32 y; index == spawn count appends
+    EditJournalRecord_Spawn = 2,
+    // uint32 count; truncates the spawn list
+    EditJournalRecord_SpawnCount = 3,
+    // int16 id, uint16 name length, name bytes
+    EditJournalRecord_TextureName = 4,
+    // uint16 name length, name bytes; unmaps the name
+    EditJournalRecord_TextureNameRemoval = 5
+};
+
+static const char kEditJournalMagic[4] = {'M', 'F', 'J', 'L'};
+static const uint32_t kEditJournalVersion = 1;
+static const size_t kEditJournalHeaderSize = 24;
+
+std::string EditJournalPath(const std::string& levelPath);
+
+class EditJournal {
+public:
+    EditJournal() = default;
+    ~EditJournal();
+    EditJournal(const EditJournal&) = delete;
+    EditJournal& operator=(const EditJournal&) = delete;
+
+    // Opens levelPath's journal for appending. level must hold levelPath exactly as loaded; any
+    // edits already in a journal that matches the file are replayed over it first.
+    bool Open(const std::string& levelPath, Level& level, size_t& replayedEdits, std::string& error);
+    // Flushes the pending edits and closes the file
+    void Close();
+    bool IsOpen() const { return fd != -1; }
+    const std::string& LevelPath() const { return levelPath; }
+
+    // Edits made while no journal is open aren't recorded: there is no saved level to replay them
+    // over, and the next save holds them anyway
+    void RecordCell(int x, int y, short id);
+    void RecordSpawn(size_t index, const EnemySpawnLocation& location);
+    void RecordSpawnCount(size_t count);
+    void RecordTextureName(const std::string& name, short id);
+    void RecordTextureNameRemoval(const std::string& name);
+
+    bool HasPendingEdits() const { return !pending.empty(); }
+    // Bytes in the journal file, not counting pending edits
+    uint64_t Size() const { return size; }
+
+    // Appends the pending edits as one batch and syncs it to disk
+    bool Flush(std::string& error);
+
+    // Call after the level has been saved in full to levelPath. Starts that file's journal over,
+    // keeping the records from byte keepFrom on (an earlier Size()), which the save didn't include.
+    bool Rebase(const std::string& levelPath, uint64_t keepFrom, std::string& error);
+
+private:
+    void AppendRecordType(EditJournalRecord type);
+    void Append(const void* bytes, size_t count);
+    void Append16(uint16_t value);
+    void Append32(uint32_t value);
+
+    int fd = -1;
+    std::string levelPath;
+    uint64_t size = 0;
+    std::vector<unsigned char> pending;
+};
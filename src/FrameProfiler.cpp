@@ -0,0 +1,167 @@
+#include "FrameProfiler.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+static const char* kFrameZoneName = "Frame";
+
+static void WriteJsonString(FILE* file, const char* text) {
+    fputc('"', file);
+    for (const char* c = text; *c != '\0'; c++) {
+        if (*c == '"' || *c == '\\') {
+            fputc('\\', file);
+            fputc(*c, file);
+        } else if (static_cast<unsigned char>(*c) < 0x20) {
+            fprintf(file, "\\u%04x", static_cast<unsigned>(*c));
+        } else {
+            fputc(*c, file);
+        }
+    }
+    fputc('"', file);
+}
+
+FrameProfiler::FrameProfiler() : epoch(std::chrono::steady_clock::now()), zones(kProfilerZoneCapacity), frameTimes(kProfilerHistoryFrames, 0.0f) {
+}
+
+uint64_t FrameProfiler::Now() const {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count());
+}
+
+void FrameProfiler::BeginFrame() {
+    for (Phase& phase : phases) {
+        phase.current = 0.0f;
+    }
+
+    BeginZone(kFrameZoneName);
+}
+
+void FrameProfiler::EndFrame() {
+    uint64_t start = depth > 0 ? openZones[0].start : Now();
+    while (depth > 0) {
+        EndZone();
+    }
+    float frameTime = static_cast<float>((Now() - start) / 1e6);
+
+    int index;
+    if (historyCount < kProfilerHistoryFrames) {
+        index = historyCount++;
+    } else {
+        index = historyOffset;
+        historyOffset = (historyOffset + 1) % kProfilerHistoryFrames;
+    }
+
+    frameTimes[index] = frameTime;
+    for (Phase& phase : phases) {
+        phase.times[index] = phase.current;
+    }
+
+    frame++;
+}
+
+void FrameProfiler::BeginZone(const char* name) {
+    if (depth < kProfilerMaxDepth) {
+        openZones[depth].name = name;
+        openZones[depth].start = Now();
+    }
+    depth++;
+}
+
+void FrameProfiler::EndZone() {
+    if (depth == 0) {
+        return;
+    }
+
+    depth--;
+    if (depth >= kProfilerMaxDepth) {
+        return;
+    }
+
+    ProfileZone& zone = zones[nextZone];
+    zone.name = openZones[depth].name;
+    zone.start = openZones[depth].start;
+    zone.end = Now();
+    zone.frame = frame;
+    zone.depth = depth;
+    nextZone = (nextZone + 1) % zones.size();
+    zoneCount = std::min(zoneCount + 1, zones.size());
+
+    // The phases are the zones directly inside a frame
+    if (depth != 1) {
+        return;
+    }
+
+    std::vector<Phase>::iterator phase = std::find_if(phases.begin(), phases.end(), [&](const Phase& phase) {
+        return strcmp(phase.name, zone.name) == 0;
+    });
+    if (phase == phases.end()) {
+        Phase newPhase;
+        newPhase.name = zone.name;
+        newPhase.times.assign(kProfilerHistoryFrames, 0.0f);
+        newPhase.current = 0.0f;
+        phases.push_back(std::move(newPhase));
+        phase = phases.end() - 1;
+    }
+    phase->current += static_cast<float>((zone.end - zone.start) / 1e6);
+}
+
+float FrameProfiler::LastFrameTime() const {
+    if (historyCount == 0) {
+        return 0.0f;
+    }
+
+    return frameTimes[(historyOffset + historyCount - 1) % kProfilerHistoryFrames];
+}
+
+float FrameProfiler::FrameTimePercentile(float fraction) const {
+    if (historyCount == 0) {
+        return 0.0f;
+    }
+
+    std::vector<float> sorted(frameTimes.begin(), frameTimes.begin() + historyCount);
+    size_t rank = std::min(static_cast<size_t>(fraction * historyCount), sorted.size() - 1);
+    std::nth_element(sorted.begin(), sorted.begin() + rank, sorted.end());
+    return sorted[rank];
+}
+
+bool FrameProfiler::WriteChromeTrace(const char* path, double seconds, std::string& error) const {
+    FILE* file = fopen(path, "wb");
+    if (file == nullptr) {
+        error = std::string("Failed to open ") + path + ": " + strerror(errno);
+        return false;
+    }
+
+    uint64_t now = Now();
+    uint64_t window = static_cast<uint64_t>(seconds * 1e9);
+    uint64_t cutoff = now > window ? now - window : 0;
+
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    bool first = true;
+    size_t oldest = (nextZone + zones.size() - zoneCount) % zones.size();
+    for (size_t i = 0; i < zoneCount; i++) {
+        const ProfileZone& zone = zones[(oldest + i) % zones.size()];
+        if (zone.end < cutoff) {
+            continue;
+        }
+
+        fprintf(file, "%s{\"name\":", first ? "" : ",\n");
+        WriteJsonString(file, zone.name);
+        fprintf(file, ",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"frame\":%u}}",
+                zone.start / 1e3, (zone.end - zone.start) / 1e3, static_cast<unsigned>(zone.frame));
+        first = false;
+    }
+    fprintf(file, "\n]}\n");
+
+    if (ferror(file) != 0) {
+        error = std::string("Failed to write ") + path;
+        fclose(file);
+        return false;
+    }
+
+    if (fclose(file) != 0) {
+        error = std::string("Failed to write ") + path + ": " + strerror(errno);
+        return false;
+    }
+
+    return true;
+}
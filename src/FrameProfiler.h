@@ -0,0 +1,96 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Zones kept for trace export; at a dozen zones a frame that's well over ten seconds at 60 fps
+static const size_t kProfilerZoneCapacity = 65536;
+// Frames of per-phase history kept for the overlay's histograms and percentiles
+static const int kProfilerHistoryFrames = 240;
+static const int kProfilerMaxDepth = 16;
+
+struct ProfileZone {
+    // Must outlive the profiler; zones are meant to be named with string literals
+    const char* name;
+    // Nanoseconds since the profiler was created
+    uint64_t start;
+    uint64_t end;
+    uint32_t frame;
+    int depth;
+};
+
+// Per-phase timings of the main loop.
+//
+// Zones are opened and closed in nested pairs, and each closed zone goes into a fixed-size ring
+// buffer, so recording never allocates once the first frames have run and old zones simply fall
+// off the end. WriteChromeTrace dumps the recent part of the ring in Chrome's trace event format,
+// which chrome://tracing and Perfetto open directly.
+//
+// On top of the ring, the total time spent in each top-level zone name is kept for the last
+// kProfilerHistoryFrames frames, for histograms and frame time percentiles.
+class FrameProfiler {
+public:
+    struct Phase {
+        const char* name;
+        // Milliseconds per frame, a ring indexed like FrameTimes
+        std::vector<float> times;
+        float current;
+    };
+
+    FrameProfiler();
+
+    // A frame is a zone of its own that every other zone nests in
+    void BeginFrame();
+    void EndFrame();
+    void BeginZone(const char* name);
+    void EndZone();
+
+    // Milliseconds per frame for the last kProfilerHistoryFrames frames; HistoryOffset is the oldest
+    const std::vector<float>& FrameTimes() const { return frameTimes; }
+    const std::vector<Phase>& Phases() const { return phases; }
+    int HistoryOffset() const { return historyOffset; }
+    int HistoryCount() const { return historyCount; }
+    // Frame time below which the given fraction of the recorded frames fall, in milliseconds
+    float FrameTimePercentile(float fraction) const;
+    // Milliseconds the last finished frame took; each phase's current time stays that frame's until BeginFrame
+    float LastFrameTime() const;
+
+    // Writes the zones that ended in the last seconds as Chrome trace JSON
+    bool WriteChromeTrace(const char* path, double seconds, std::string& error) const;
+
+private:
+    struct OpenZone {
+        const char* name;
+        uint64_t start;
+    };
+
+    uint64_t Now() const;
+
+    std::chrono::steady_clock::time_point epoch;
+    std::vector<ProfileZone> zones;
+    size_t nextZone = 0;
+    size_t zoneCount = 0;
+    OpenZone openZones[kProfilerMaxDepth];
+    int depth = 0;
+    uint32_t frame = 0;
+
+    std::vector<float> frameTimes;
+    std::vector<Phase> phases;
+    int historyOffset = 0;
+    int historyCount = 0;
+};
+
+// Times the enclosing scope as a zone
+class ProfileScope {
+public:
+    ProfileScope(FrameProfiler& profiler, const char* name) : profiler(profiler) { profiler.BeginZone(name); }
+    ~ProfileScope() { profiler.EndZone(); }
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+    FrameProfiler& profiler;
+};
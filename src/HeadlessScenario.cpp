@@ -0,0 +1,89 @@
+#include "HeadlessScenario.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// Frames between wheel notches in the zoom scenario, so each ease has time to play out
+static const int kZoomNotchInterval = 6;
+// Rows the paint scenario zigzags over
+static const int kPaintStrokeRows = 6;
+
+static const float kPi = 3.14159265f;
+
+static const char* kScenarioNames[] = {"idle", "pan", "zoom", "paint"};
+
+bool ParseHeadlessScenario(const char* name, HeadlessScenario& scenario) {
+    for (int i = 0; i < static_cast<int>(sizeof(kScenarioNames) / sizeof(kScenarioNames[0])); i++) {
+        if (strcmp(name, kScenarioNames[i]) == 0) {
+            scenario = static_cast<HeadlessScenario>(i);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+const char* HeadlessScenarioName(HeadlessScenario scenario) {
+    return kScenarioNames[static_cast<int>(scenario)];
+}
+
+void QueueHeadlessScenarioInput(HeadlessScenario scenario, int frame, int frameCount, const ImVec2& viewMin, const ImVec2& viewMax) {
+    ImGuiIO& io = ImGui::GetIO();
+    ImVec2 center((viewMin.x + viewMax.x) * 0.5f, (viewMin.y + viewMax.y) * 0.5f);
+    ImVec2 extent((viewMax.x - viewMin.x) * 0.5f, (viewMax.y - viewMin.y) * 0.5f);
+
+    // The first frame lays the windows out; the second moves the mouse over the map view. Buttons
+    // go down and up on frames of their own, since ImGui handles one change per frame anyway.
+    int first = 2;
+    int last = frameCount - 2;
+    if (frame < 1 || scenario == HeadlessScenario::Idle) {
+        return;
+    }
+
+    if (frame == 1) {
+        io.AddMousePosEvent(center.x, center.y);
+    }
+
+    // Progress through the scripted part of the run, 0 to 1
+    float t = last > first ? static_cast<float>(frame - first) / (last - first) : 0.0f;
+    t = std::min(std::max(t, 0.0f), 1.0f);
+
+    switch (scenario) {
+        case HeadlessScenario::Pan: {
+            if (frame == first) {
+                io.AddMouseButtonEvent(ImGuiMouseButton_Middle, true);
+            } else if (frame > first && frame < last) {
+                float angle = t * 2.0f * kPi;
+                io.AddMousePosEvent(center.x + extent.x * 0.5f * std::sin(angle), center.y + extent.y * 0.5f * (1.0f - std::cos(angle)));
+            } else if (frame == last) {
+                io.AddMouseButtonEvent(ImGuiMouseButton_Middle, false);
+            }
+            break;
+        }
+        case HeadlessScenario::Zoom: {
+            if (frame >= first && frame < last && (frame - first) % kZoomNotchInterval == 0) {
+                io.AddMouseWheelEvent(0.0f, t < 0.5f ? 1.0f : -1.0f);
+            }
+            break;
+        }
+        case HeadlessScenario::Paint: {
+            if (frame == first) {
+                io.AddMousePosEvent(center.x - extent.x * 0.8f, center.y - extent.y * 0.8f);
+            } else if (frame == first + 1) {
+                io.AddMouseButtonEvent(ImGuiMouseButton_Left, true);
+            } else if (frame > first + 1 && frame < last) {
+                float row = std::min(t * kPaintStrokeRows, static_cast<float>(kPaintStrokeRows) - 0.001f);
+                float along = row - std::floor(row);
+                if (static_cast<int>(row) % 2 == 1) {
+                    along = 1.0f - along;
+                }
+                io.AddMousePosEvent(center.x + extent.x * 0.8f * (along * 2.0f - 1.0f), center.y + extent.y * 0.8f * (row / kPaintStrokeRows * 2.0f - 1.0f));
+            } else if (frame == last) {
+                io.AddMouseButtonEvent(ImGuiMouseButton_Left, false);
+            }
+            break;
+        }
+        case HeadlessScenario::Idle:
+            break;
+    }
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "imgui.h"
+
+// Scripted input for the headless mode
+enum class HeadlessScenario {
+    // No input at all; the cost of redrawing an unchanged editor
+    Idle,
+    // Middle-drags the map view around in a circle
+    Pan,
+    // Wheels in towards the middle of the map view, then back out
+    Zoom,
+    // Paints the current tile in a zigzag across the map view
+    Paint
+};
+
+bool ParseHeadlessScenario(const char* name, HeadlessScenario& scenario);
+const char* HeadlessScenarioName(HeadlessScenario scenario);
+
+// Queues the scenario's input for one frame of frameCount as ImGui input events. viewMin and viewMax
+// are where the map view was drawn the frame before, so the script follows the window layout.
+//
+// Nothing depends on wall-clock time, so with a fixed ImGui delta time every run of a scenario
+// produces the same frames.
+void QueueHeadlessScenarioInput(HeadlessScenario scenario, int frame, int frameCount, const ImVec2& viewMin, const ImVec2& viewMax);
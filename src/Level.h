@@ -0,0 +1,20 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+#include "LevelGrid.h"
+
+static const int kMaxLevelDimension = 65536;
+
+struct EnemySpawnLocation {
+    int textureId; // This should be short but eh
+    float x, y;
+};
+
+// Everything that gets saved to a level file
+struct Level {
+    LevelGrid grid;
+    std::vector<EnemySpawnLocation> enemySpawnLocations;
+    std::map<std::string, short> textureNameToTextureIdMap;
+};
@@ -0,0 +1,589 @@
+#include "LevelFile.h"
+#include "BufferedFileWriter.h"
+#include "MappedFile.h"
+#include "TextLevelParser.h"
+#include "TileCompression.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+
+static bool HostIsLittleEndian() {
+    const uint16_t probe = 1;
+    unsigned char firstByte;
+    memcpy(&firstByte, &probe, 1);
+    return firstByte == 1;
+}
+
+static uint16_t LoadLE16(const unsigned char* p) {
+    return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+
+static uint32_t LoadLE32(const unsigned char* p) {
+    return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+           (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+static uint64_t LoadLE64(const unsigned char* p) {
+    return static_cast<uint64_t>(LoadLE32(p)) | (static_cast<uint64_t>(LoadLE32(p + 4)) << 32);
+}
+
+static void StoreLE16(unsigned char* p, uint16_t value) {
+    p[0] = static_cast<unsigned char>(value);
+    p[1] = static_cast<unsigned char>(value >> 8);
+}
+
+static void StoreLE32(unsigned char* p, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        p[i] = static_cast<unsigned char>(value >> (8 * i));
+    }
+}
+
+static void StoreLE64(unsigned char* p, uint64_t value) {
+    StoreLE32(p, static_cast<uint32_t>(value));
+    StoreLE32(p + 4, static_cast<uint32_t>(value >> 32));
+}
+
+static uint32_t FloatBits(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+static float BitsToFloat(uint32_t bits) {
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+static uint64_t AlignUp(uint64_t value, uint64_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+bool DetectLevelFormat(const char* filePath, LevelFormat& format, std::string& error) {
+    std::ifstream infile(filePath, std::ios::binary);
+    if (!infile) {
+        error = std::string("Could not open ") + filePath;
+        return false;
+    }
+
+    unsigned char start[8] = {};
+    infile.read(reinterpret_cast<char*>(start), sizeof(start));
+
+    if (infile.gcount() < 4 || memcmp(start, kBinaryLevelMagic, sizeof(kBinaryLevelMagic)) != 0) {
+        format = LevelFormat::Text;
+    } else if (infile.gcount() == sizeof(start) && LoadLE16(start + 6) == BinaryTileEncoding_Chunked) {
+        format = LevelFormat::CompressedBinary;
+    } else {
+        format = LevelFormat::Binary;
+    }
+
+    return true;
+}
+
+bool ReadBinaryLevelHeader(const unsigned char* data, size_t size, BinaryLevelHeader& header, std::string& error) {
+    if (size < kBinaryLevelHeaderSize || memcmp(data, kBinaryLevelMagic, sizeof(kBinaryLevelMagic)) != 0) {
+        error = "Not a binary level";
+        return false;
+    }
+
+    header.version = LoadLE16(data + 4);
+    header.tileEncoding = LoadLE16(data + 6);
+    header.width = LoadLE32(data + 8);
+    header.height = LoadLE32(data + 12);
+    header.tileOffset = LoadLE64(data + 16);
+    header.tileSize = LoadLE64(data + 24);
+    header.spawnOffset = LoadLE64(data + 32);
+    header.spawnCount = LoadLE32(data + 40);
+    header.textureCount = LoadLE32(data + 44);
+    header.textureOffset = LoadLE64(data + 48);
+    header.textureSize = LoadLE64(data + 56);
+
+    if (header.version != kBinaryLevelVersion) {
+        error = "Unsupported binary level version " + std::to_string(header.version);
+        return false;
+    }
+
+    if (header.tileEncoding != BinaryTileEncoding_Raw && header.tileEncoding != BinaryTileEncoding_Chunked) {
+        error = "Unsupported tile encoding " + std::to_string(header.tileEncoding);
+        return false;
+    }
+
+    if (header.width == 0 || header.height == 0 || header.width > kMaxLevelDimension || header.height > kMaxLevelDimension) {
+        error = "Invalid level dimensions " + std::to_string(header.width) + "x" + std::to_string(header.height);
+        return false;
+    }
+
+    if (header.tileEncoding == BinaryTileEncoding_Raw) {
+        uint64_t expectedTileSize = static_cast<uint64_t>(header.width) * header.height * sizeof(int16_t);
+        if (header.tileSize != expectedTileSize || header.tileOffset % sizeof(int16_t) != 0) {
+            error = "Tile block does not match level dimensions";
+            return false;
+        }
+    } else {
+        uint64_t chunkCount = static_cast<uint64_t>((header.width + kLevelChunkSize - 1) / kLevelChunkSize) *
+                              ((header.height + kLevelChunkSize - 1) / kLevelChunkSize);
+        if (header.tileSize < chunkCount * kTileChunkIndexEntrySize) {
+            error = "Tile chunk index does not match level dimensions";
+            return false;
+        }
+    }
+
+    // Each section must lie inside the file; sizes are checked before adding so nothing can wrap
+    if (header.tileOffset > size || header.tileSize > size - header.tileOffset) {
+        error = "Tile block runs past the end of the file";
+        return false;
+    }
+
+    uint64_t spawnSize = static_cast<uint64_t>(header.spawnCount) * 12;
+    if (header.spawnOffset > size || spawnSize > size - header.spawnOffset) {
+        error = "Spawn table runs past the end of the file";
+        return false;
+    }
+
+    if (header.textureOffset > size || header.textureSize > size - header.textureOffset) {
+        error = "Texture table runs past the end of the file";
+        return false;
+    }
+
+    return true;
+}
+
+static LevelGridLayout ChooseLayout(int width, int height, LevelGridLayout requested) {
+    if (static_cast<size_t>(width) * height > kChunkedLayoutCellThreshold) {
+        return LevelGridLayout::Chunked;
+    }
+
+    return requested;
+}
+
+// Decodes chunk (chunkX, chunkY) of a chunked tile block
+static bool DecodeLevelChunk(const unsigned char* tileBlock, uint64_t tileBlockSize, int chunkColumns, int chunkX, int chunkY,
+                             short* tiles, std::string& error) {
+    const unsigned char* entry = tileBlock + (static_cast<size_t>(chunkY) * chunkColumns + chunkX) * kTileChunkIndexEntrySize;
+    uint64_t offset = LoadLE64(entry);
+    uint32_t size = LoadLE32(entry + 8);
+    TileChunkMethod method = static_cast<TileChunkMethod>(entry[12]);
+
+    if (offset > tileBlockSize || size > tileBlockSize - offset ||
+        !DecodeTileChunk(method, tileBlock + offset, size, tiles)) {
+        error = "Corrupt tile chunk at " + std::to_string(chunkX) + ", " + std::to_string(chunkY);
+        return false;
+    }
+
+    return true;
+}
+
+static bool IsEmptyLevelChunk(const unsigned char* tileBlock, int chunkColumns, int chunkX, int chunkY) {
+    size_t index = static_cast<size_t>(chunkY) * chunkColumns + chunkX;
+    return tileBlock[index * kTileChunkIndexEntrySize + 12] == TileChunkMethod_Empty;
+}
+
+static bool LoadBinaryLevel(const char* filePath, Level& level, std::string& error, LevelGridLayout layout) {
+    std::shared_ptr<MappedFile> mapping(new MappedFile());
+    if (!mapping->Open(filePath, true, error)) {
+        return false;
+    }
+
+    const unsigned char* data = mapping->Data();
+    BinaryLevelHeader header;
+    if (!ReadBinaryLevelHeader(data, mapping->Size(), header, error)) {
+        return false;
+    }
+
+    std::vector<EnemySpawnLocation> enemySpawnLocations(header.spawnCount);
+    const unsigned char* spawn = data + header.spawnOffset;
+    for (EnemySpawnLocation& location : enemySpawnLocations) {
+        location.textureId = static_cast<int32_t>(LoadLE32(spawn));
+        location.x = BitsToFloat(LoadLE32(spawn + 4));
+        location.y = BitsToFloat(LoadLE32(spawn + 8));
+        spawn += 12;
+    }
+
+    std::map<std::string, short> textureNameToTextureIdMap;
+    const unsigned char* texture = data + header.textureOffset;
+    const unsigned char* textureEnd = texture + header.textureSize;
+    for (uint32_t i = 0; i < header.textureCount; i++) {
+        if (textureEnd - texture < 4) {
+            error = "Texture table is truncated";
+            return false;
+        }
+
+        short id = static_cast<short>(LoadLE16(texture));
+        uint16_t nameLength = LoadLE16(texture + 2);
+        texture += 4;
+
+        if (textureEnd - texture < nameLength) {
+            error = "Texture table is truncated";
+            return false;
+        }
+
+        textureNameToTextureIdMap[std::string(reinterpret_cast<const char*>(texture), nameLength)] = id;
+        texture += nameLength;
+    }
+
+    int width = static_cast<int>(header.width);
+    int height = static_cast<int>(header.height);
+    short* tiles = reinterpret_cast<short*>(mapping->Data() + header.tileOffset);
+
+    layout = ChooseLayout(width, height, layout);
+
+    if (header.tileEncoding == BinaryTileEncoding_Chunked) {
+        level.grid.Reset(width, height, layout);
+        const unsigned char* tileBlock = mapping->Data() + header.tileOffset;
+        short chunkTiles[kLevelChunkCells];
+
+        for (int chunkY = 0; chunkY < level.grid.ChunkRows(); chunkY++) {
+            for (int chunkX = 0; chunkX < level.grid.ChunkColumns(); chunkX++) {
+                // The grid starts out all 0, so empty chunks are never touched
+                if (IsEmptyLevelChunk(tileBlock, level.grid.ChunkColumns(), chunkX, chunkY)) {
+                    continue;
+                }
+
+                if (!DecodeLevelChunk(tileBlock, header.tileSize, level.grid.ChunkColumns(), chunkX, chunkY, chunkTiles, error)) {
+                    return false;
+                }
+                level.grid.WriteChunk(chunkX, chunkY, chunkTiles);
+            }
+        }
+    } else if (HostIsLittleEndian() && layout == LevelGridLayout::Dense) {
+        // The tile block is already in memory order; the grid reads it straight from the mapped pages
+        level.grid.AdoptMapping(mapping, tiles, width, height);
+    } else {
+        level.grid.Reset(width, height, layout);
+        std::vector<short> row(static_cast<size_t>(width));
+        const unsigned char* tileBytes = mapping->Data() + header.tileOffset;
+
+        for (int y = 0; y < height; y++) {
+            if (HostIsLittleEndian()) {
+                level.grid.WriteRow(y, tiles + static_cast<size_t>(y) * width);
+                continue;
+            }
+
+            for (int x = 0; x < width; x++) {
+                row[x] = static_cast<short>(LoadLE16(tileBytes));
+                tileBytes += 2;
+            }
+            level.grid.WriteRow(y, row.data());
+        }
+    }
+
+    level.enemySpawnLocations.swap(enemySpawnLocations);
+    level.textureNameToTextureIdMap.swap(textureNameToTextureIdMap);
+
+    return true;
+}
+
+static bool LoadTextLevel(const char* filePath, Level& level, std::string& error, LevelGridLayout layout) {
+    MappedFile file;
+    if (!file.Open(filePath, false, error)) {
+        return false;
+    }
+
+    return ParseTextLevel(reinterpret_cast<const char*>(file.Data()), file.Size(), level, error, layout);
+}
+
+bool LoadLevelFile(const char* filePath, Level& level, std::string& error, LevelGridLayout layout) {
+    LevelFormat format;
+    if (!DetectLevelFormat(filePath, format, error)) {
+        return false;
+    }
+
+    Level loadedLevel;
+    bool loaded = format == LevelFormat::Text
+                  ? LoadTextLevel(filePath, loadedLevel, error, layout)
+                  : LoadBinaryLevel(filePath, loadedLevel, error, layout);
+
+    if (loaded) {
+        level = std::move(loadedLevel);
+    }
+
+    return loaded;
+}
+
+// Subtracts rather than adding, so a huge width or height can't overflow past the check
+static bool RegionInBounds(int x, int y, int width, int height, int levelWidth, int levelHeight) {
+    return x >= 0 && y >= 0 && width >= 0 && height >= 0 && x <= levelWidth && y <= levelHeight &&
+           width <= levelWidth - x && height <= levelHeight - y;
+}
+
+bool LoadLevelRegion(const char* filePath, int x, int y, int width, int height, LevelGrid& region, std::string& error) {
+    LevelFormat format;
+    if (!DetectLevelFormat(filePath, format, error)) {
+        return false;
+    }
+
+    if (format == LevelFormat::Text) {
+        // Text levels have no random access; parse the lot and copy the region out
+        Level level;
+        if (!LoadLevelFile(filePath, level, error, LevelGridLayout::Chunked)) {
+            return false;
+        }
+
+        if (!RegionInBounds(x, y, width, height, level.grid.Width(), level.grid.Height())) {
+            error = "Region lies outside the level";
+            return false;
+        }
+
+        region.Reset(width, height);
+        for (int row = 0; row < height; row++) {
+            for (int column = 0; column < width; column++) {
+                region.At(column, row) = level.grid.Get(x + column, y + row);
+            }
+        }
+        return true;
+    }
+
+    MappedFile file;
+    if (!file.Open(filePath, false, error)) {
+        return false;
+    }
+
+    BinaryLevelHeader header;
+    if (!ReadBinaryLevelHeader(file.Data(), file.Size(), header, error)) {
+        return false;
+    }
+
+    int levelWidth = static_cast<int>(header.width);
+    int levelHeight = static_cast<int>(header.height);
+    if (!RegionInBounds(x, y, width, height, levelWidth, levelHeight)) {
+        error = "Region lies outside the level";
+        return false;
+    }
+
+    region.Reset(width, height);
+    const unsigned char* tileBlock = file.Data() + header.tileOffset;
+
+    if (header.tileEncoding == BinaryTileEncoding_Raw) {
+        for (int row = 0; row < height; row++) {
+            const unsigned char* source = tileBlock + ((static_cast<size_t>(y) + row) * levelWidth + x) * sizeof(int16_t);
+            for (int column = 0; column < width; column++) {
+                region.At(column, row) = static_cast<short>(LoadLE16(source + column * 2));
+            }
+        }
+        return true;
+    }
+
+    if (width == 0 || height == 0) {
+        return true;
+    }
+
+    int chunkColumns = (levelWidth + kLevelChunkSize - 1) / kLevelChunkSize;
+    short chunkTiles[kLevelChunkCells];
+
+    for (int chunkY = y / kLevelChunkSize; chunkY <= (y + height - 1) / kLevelChunkSize; chunkY++) {
+        for (int chunkX = x / kLevelChunkSize; chunkX <= (x + width - 1) / kLevelChunkSize; chunkX++) {
+            if (IsEmptyLevelChunk(tileBlock, chunkColumns, chunkX, chunkY)) {
+                continue;
+            }
+
+            if (!DecodeLevelChunk(tileBlock, header.tileSize, chunkColumns, chunkX, chunkY, chunkTiles, error)) {
+                return false;
+            }
+
+            // Copy the part of the chunk that overlaps the region
+            int left = std::max(x, chunkX * kLevelChunkSize);
+            int top = std::max(y, chunkY * kLevelChunkSize);
+            int right = std::min(x + width, (chunkX + 1) * kLevelChunkSize);
+            int bottom = std::min(y + height, (chunkY + 1) * kLevelChunkSize);
+
+            for (int cellY = top; cellY < bottom; cellY++) {
+                for (int cellX = left; cellX < right; cellX++) {
+                    int chunkCell = (cellY % kLevelChunkSize) * kLevelChunkSize + cellX % kLevelChunkSize;
+                    region.At(cellX - x, cellY - y) = chunkTiles[chunkCell];
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
+static void ReportProgress(std::atomic<float>* progress, int done, int total) {
+    if (progress != nullptr && total > 0) {
+        progress->store(static_cast<float>(done) / total, std::memory_order_relaxed);
+    }
+}
+
+static void WriteTextLevel(BufferedFileWriter& writer, const Level& level, std::atomic<float>* progress) {
+    const LevelGrid& grid = level.grid;
+
+    writer.WriteInt(grid.Width());
+    writer.WriteChar(' ');
+    writer.WriteInt(grid.Height());
+    writer.WriteChar('\n');
+
+    std::vector<short> scratch(static_cast<size_t>(grid.Width()));
+    for (int y = 0; y < grid.Height(); y++) {
+        const short* row = grid.ReadRow(y, scratch.data());
+        for (int x = 0; x < grid.Width(); x++) {
+            writer.WriteInt(row[x]);
+            if (x < grid.Width() - 1) {
+                writer.WriteChar(' ');
+            }
+        }
+
+        writer.WriteChar('\n');
+        ReportProgress(progress, y + 1, grid.Height());
+    }
+
+    writer.WriteUnsigned(level.enemySpawnLocations.size());
+    writer.WriteChar('\n');
+    for (const EnemySpawnLocation& location : level.enemySpawnLocations) {
+        writer.WriteInt(location.textureId);
+        writer.WriteChar(' ');
+        writer.WriteFloat(location.x);
+        writer.WriteChar(' ');
+        writer.WriteFloat(location.y);
+        writer.WriteChar('\n');
+    }
+
+    std::map<short, std::string> reversedMap;
+
+    for (const auto& entry : level.textureNameToTextureIdMap) {
+        reversedMap[entry.second] = entry.first;
+    }
+
+    for (const auto& entry: reversedMap) {
+        writer.WriteInt(entry.first);
+        writer.WriteChar(' ');
+        writer.WriteString(entry.second);
+        writer.WriteChar('\n');
+    }
+}
+
+// Builds a chunked tile block: the index, then every non-empty chunk's payload
+static void EncodeChunkedTiles(const LevelGrid& grid, std::vector<unsigned char>& tileBlock, std::atomic<float>* progress) {
+    size_t chunkCount = static_cast<size_t>(grid.ChunkColumns()) * grid.ChunkRows();
+    tileBlock.assign(chunkCount * kTileChunkIndexEntrySize, 0);
+
+    short chunkTiles[kLevelChunkCells];
+    size_t index = 0;
+
+    for (int chunkY = 0; chunkY < grid.ChunkRows(); chunkY++) {
+        for (int chunkX = 0; chunkX < grid.ChunkColumns(); chunkX++) {
+            grid.ReadChunk(chunkX, chunkY, chunkTiles);
+
+            size_t offset = tileBlock.size();
+            TileChunkMethod method = EncodeTileChunk(chunkTiles, tileBlock);
+
+            unsigned char* entry = &tileBlock[index * kTileChunkIndexEntrySize];
+            StoreLE64(entry, method == TileChunkMethod_Empty ? 0 : offset);
+            StoreLE32(entry + 8, static_cast<uint32_t>(tileBlock.size() - offset));
+            entry[12] = method;
+            index++;
+        }
+
+        ReportProgress(progress, chunkY + 1, grid.ChunkRows());
+    }
+}
+
+static void WriteBinaryLevel(BufferedFileWriter& writer, const Level& level, bool compressTiles, std::atomic<float>* progress) {
+    const LevelGrid& grid = level.grid;
+
+    std::map<short, std::string> reversedMap;
+    for (const auto& entry : level.textureNameToTextureIdMap) {
+        reversedMap[entry.second] = entry.first;
+    }
+
+    std::vector<unsigned char> textureTable;
+    for (const auto& entry : reversedMap) {
+        size_t nameLength = entry.second.size() > 0xffff ? 0xffff : entry.second.size();
+        size_t offset = textureTable.size();
+        textureTable.resize(offset + 4 + nameLength);
+        StoreLE16(&textureTable[offset], static_cast<uint16_t>(entry.first));
+        StoreLE16(&textureTable[offset + 2], static_cast<uint16_t>(nameLength));
+        memcpy(&textureTable[offset + 4], entry.second.data(), nameLength);
+    }
+
+    std::vector<unsigned char> spawnTable(level.enemySpawnLocations.size() * 12);
+    for (size_t i = 0; i < level.enemySpawnLocations.size(); i++) {
+        const EnemySpawnLocation& location = level.enemySpawnLocations[i];
+        StoreLE32(&spawnTable[i * 12], static_cast<uint32_t>(location.textureId));
+        StoreLE32(&spawnTable[i * 12 + 4], FloatBits(location.x));
+        StoreLE32(&spawnTable[i * 12 + 8], FloatBits(location.y));
+    }
+
+    std::vector<unsigned char> compressedTiles;
+    if (compressTiles) {
+        EncodeChunkedTiles(grid, compressedTiles, progress);
+    }
+
+    uint64_t tileOffset = AlignUp(kBinaryLevelHeaderSize, kBinaryLevelTileAlignment);
+    uint64_t tileSize = compressTiles ? compressedTiles.size() : static_cast<uint64_t>(grid.CellCount()) * sizeof(int16_t);
+    uint64_t spawnOffset = tileOffset + tileSize;
+    uint64_t textureOffset = spawnOffset + spawnTable.size();
+
+    unsigned char header[kBinaryLevelHeaderSize] = {};
+    memcpy(header, kBinaryLevelMagic, sizeof(kBinaryLevelMagic));
+    StoreLE16(header + 4, kBinaryLevelVersion);
+    StoreLE16(header + 6, compressTiles ? BinaryTileEncoding_Chunked : BinaryTileEncoding_Raw);
+    StoreLE32(header + 8, static_cast<uint32_t>(grid.Width()));
+    StoreLE32(header + 12, static_cast<uint32_t>(grid.Height()));
+    StoreLE64(header + 16, tileOffset);
+    StoreLE64(header + 24, tileSize);
+    StoreLE64(header + 32, spawnOffset);
+    StoreLE32(header + 40, static_cast<uint32_t>(level.enemySpawnLocations.size()));
+    StoreLE32(header + 44, static_cast<uint32_t>(reversedMap.size()));
+    StoreLE64(header + 48, textureOffset);
+    StoreLE64(header + 56, textureTable.size());
+
+    writer.Write(header, sizeof(header));
+
+    const char padding[kBinaryLevelTileAlignment] = {};
+    writer.Write(padding, tileOffset - kBinaryLevelHeaderSize);
+
+    if (compressTiles) {
+        writer.Write(compressedTiles.data(), compressedTiles.size());
+    }
+
+    std::vector<short> scratch(static_cast<size_t>(grid.Width()));
+    std::vector<unsigned char> row(grid.Width() * sizeof(short));
+    for (int y = 0; y < grid.Height() && !compressTiles; y++) {
+        const short* tiles = grid.ReadRow(y, scratch.data());
+        if (HostIsLittleEndian()) {
+            writer.Write(tiles, grid.Width() * sizeof(short));
+        } else {
+            for (int x = 0; x < grid.Width(); x++) {
+                StoreLE16(&row[x * 2], static_cast<uint16_t>(tiles[x]));
+            }
+            writer.Write(row.data(), row.size());
+        }
+
+        ReportProgress(progress, y + 1, grid.Height());
+    }
+
+    writer.Write(spawnTable.data(), spawnTable.size());
+    writer.Write(textureTable.data(), textureTable.size());
+}
+
+bool SaveLevelFile(const char* filePath, const Level& level, LevelFormat format, std::string& error,
+                   std::atomic<float>* progress) {
+    std::string temporaryPath = std::string(filePath) + ".tmp";
+
+    BufferedFileWriter writer;
+    if (!writer.Open(temporaryPath.c_str(), error)) {
+        return false;
+    }
+
+    if (format == LevelFormat::Text) {
+        WriteTextLevel(writer, level, progress);
+    } else {
+        WriteBinaryLevel(writer, level, format == LevelFormat::CompressedBinary, progress);
+    }
+
+    if (!writer.Close(error)) {
+        remove(temporaryPath.c_str());
+        return false;
+    }
+
+    if (rename(temporaryPath.c_str(), filePath) != 0) {
+        error = std::string("Could not replace ") + filePath + ": " + strerror(errno);
+        remove(temporaryPath.c_str());
+        return false;
+    }
+
+    return true;
+}
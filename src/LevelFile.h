@@ -0,0 +1,76 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include "Level.h"
+
+// Level files come in two formats, told apart by the first four bytes:
+//
+// Text (legacy):
+//   width height
+//   width * height tile ids, one row per line
+//   spawn count, then one "textureId x y" line per spawn
+//   one "id name" line per texture
+//
+// Binary ("MFLV", little-endian throughout):
+//   BinaryLevelHeader
+//   tile block at a 64-byte aligned offset, either
+//     raw: width * height int16 tile ids, row-major, or
+//     chunked: one index entry per kLevelChunkSize chunk, row-major by chunk
+//              (uint64 payload offset from the start of the tile block, uint32 payload size,
+//              uint8 TileChunkMethod, 3 bytes padding), then the payloads
+//   spawn table: spawnCount * (int32 textureId, float32 x, float32 y)
+//   texture table: textureCount * (int16 id, uint16 name length, name bytes)
+enum class LevelFormat {
+    Text,
+    Binary,
+    // Binary with a chunked, RLE + LZ compressed tile block
+    CompressedBinary
+};
+
+static const char kBinaryLevelMagic[4] = {'M', 'F', 'L', 'V'};
+static const uint16_t kBinaryLevelVersion = 1;
+static const size_t kBinaryLevelHeaderSize = 64;
+static const size_t kBinaryLevelTileAlignment = 64;
+
+static const size_t kTileChunkIndexEntrySize = 16;
+
+enum BinaryTileEncoding : uint16_t {
+    BinaryTileEncoding_Raw = 0,
+    BinaryTileEncoding_Chunked = 1
+};
+
+// In-memory form of the 64-byte header, serialised field by field in the order below
+struct BinaryLevelHeader {
+    uint16_t version;
+    uint16_t tileEncoding;
+    uint32_t width;
+    uint32_t height;
+    uint64_t tileOffset;
+    uint64_t tileSize;
+    uint64_t spawnOffset;
+    uint32_t spawnCount;
+    uint32_t textureCount;
+    uint64_t textureOffset;
+    uint64_t textureSize;
+};
+
+// Looks at the file's first bytes only
+bool DetectLevelFormat(const char* filePath, LevelFormat& format, std::string& error);
+bool ReadBinaryLevelHeader(const unsigned char* data, size_t size, BinaryLevelHeader& header, std::string& error);
+
+// Loads either format into level. On failure level is left untouched and error says why.
+// Levels bigger than kChunkedLayoutCellThreshold are always loaded chunked.
+bool LoadLevelFile(const char* filePath, Level& level, std::string& error,
+                   LevelGridLayout layout = LevelGridLayout::Dense);
+
+// Reads just the width x height tiles at (x, y) into region. For compressed binary levels only the
+// chunks overlapping the region are decompressed; raw binary levels copy straight from the mapped file.
+bool LoadLevelRegion(const char* filePath, int x, int y, int width, int height, LevelGrid& region, std::string& error);
+
+// Writes to a temporary file next to filePath and renames it into place, so a failed save
+// never truncates the previous level and a level that is still memory-mapped stays valid.
+// If progress is given it is updated from 0 to 1 as the tiles are written.
+bool SaveLevelFile(const char* filePath, const Level& level, LevelFormat format, std::string& error,
+                   std::atomic<float>* progress = nullptr);
@@ -0,0 +1,350 @@
+#include "LevelGrid.h"
+#include "MappedFile.h"
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+
+LevelGrid::LevelGrid(int width, int height, int stride) {
+    Reset(width, height, stride);
+}
+
+LevelGrid::LevelGrid(const LevelGrid& other) {
+    CopyFrom(other);
+}
+
+LevelGrid::LevelGrid(LevelGrid&& other) noexcept {
+    *this = std::move(other);
+}
+
+LevelGrid& LevelGrid::operator=(const LevelGrid& other) {
+    if (this != &other) {
+        CopyFrom(other);
+    }
+
+    return *this;
+}
+
+LevelGrid& LevelGrid::operator=(LevelGrid&& other) noexcept {
+    if (this != &other) {
+        width = other.width;
+        height = other.height;
+        stride = other.stride;
+        // Moving a vector keeps its buffer, so tiles stays valid for owned storage too
+        tiles = other.tiles;
+        storage = std::move(other.storage);
+        mapping = std::move(other.mapping);
+        chunked = other.chunked;
+        chunkColumns = other.chunkColumns;
+        chunkRows = other.chunkRows;
+        chunks = std::move(other.chunks);
+
+        other.width = 0;
+        other.height = 0;
+        other.stride = 0;
+        other.tiles = nullptr;
+        other.storage.clear();
+        other.chunked = false;
+        other.chunkColumns = 0;
+        other.chunkRows = 0;
+        other.chunks.clear();
+    }
+
+    return *this;
+}
+
+void LevelGrid::CopyFrom(const LevelGrid& other) {
+    width = other.width;
+    height = other.height;
+    chunked = other.chunked;
+    chunkColumns = other.chunkColumns;
+    chunkRows = other.chunkRows;
+
+    if (chunked) {
+        // Chunks are shared and copied on the first write from either side
+        chunks = other.chunks;
+        mapping.reset();
+        storage.clear();
+        storage.shrink_to_fit();
+        tiles = nullptr;
+        stride = 0;
+        return;
+    }
+
+    // Dense copies always own their tiles: a private mapping is writable, so sharing it would share edits
+    chunks.clear();
+    mapping.reset();
+    stride = DefaultStride(other.width);
+    storage.resize(static_cast<size_t>(stride) * height);
+    tiles = storage.data();
+
+    for (int y = 0; y < height; y++) {
+        memcpy(Row(y), other.Row(y), sizeof(short) * width);
+    }
+}
+
+void LevelGrid::Reset(int width, int height, int stride) {
+    assert(width >= 0 && height >= 0);
+    assert(stride == 0 || stride >= width);
+
+    mapping.reset();
+    chunks.clear();
+    chunked = false;
+    chunkColumns = 0;
+    chunkRows = 0;
+    this->width = width;
+    this->height = height;
+    this->stride = stride == 0 ? DefaultStride(width) : stride;
+
+    // assign() rather than resize() so an existing buffer is reused and fully zeroed
+    storage.assign(static_cast<size_t>(this->stride) * height, 0);
+    tiles = storage.data();
+}
+
+void LevelGrid::ResetChunked(int width, int height) {
+    assert(width >= 0 && height >= 0);
+
+    mapping.reset();
+    storage.clear();
+    storage.shrink_to_fit();
+    tiles = nullptr;
+    stride = 0;
+
+    this->width = width;
+    this->height = height;
+    chunked = true;
+    chunkColumns = (width + kLevelChunkSize - 1) / kLevelChunkSize;
+    chunkRows = (height + kLevelChunkSize - 1) / kLevelChunkSize;
+
+    chunks.clear();
+    chunks.resize(static_cast<size_t>(chunkColumns) * chunkRows);
+}
+
+void LevelGrid::Reset(int width, int height, LevelGridLayout layout) {
+    if (layout == LevelGridLayout::Chunked) {
+        ResetChunked(width, height);
+    } else {
+        Reset(width, height, 0);
+    }
+}
+
+void LevelGrid::AdoptMapping(std::shared_ptr<MappedFile> mapping, short* tiles, int width, int height, int stride) {
+    assert(mapping != nullptr && mapping->IsOpen());
+    assert(reinterpret_cast<uintptr_t>(tiles) % alignof(short) == 0);
+
+    this->width = width;
+    this->height = height;
+    this->stride = stride == 0 ? width : stride;
+    this->tiles = tiles;
+    this->mapping = std::move(mapping);
+
+    storage.clear();
+    storage.shrink_to_fit();
+    chunks.clear();
+    chunked = false;
+    chunkColumns = 0;
+    chunkRows = 0;
+}
+
+void LevelGrid::Fill(short id) {
+    if (!chunked) {
+        for (int y = 0; y < height; y++) {
+            std::fill(Row(y), Row(y) + width, id);
+        }
+        return;
+    }
+
+    std::vector<short> row(static_cast<size_t>(width), id);
+    for (int y = 0; y < height; y++) {
+        WriteRow(y, row.data());
+    }
+}
+
+void LevelGrid::SetLayout(LevelGridLayout layout) {
+    if (layout == Layout()) {
+        return;
+    }
+
+    LevelGrid converted;
+    converted.Reset(width, height, layout);
+
+    std::vector<short> scratch(static_cast<size_t>(width));
+    for (int y = 0; y < height; y++) {
+        converted.WriteRow(y, ReadRow(y, scratch.data()));
+    }
+
+    *this = std::move(converted);
+}
+
+size_t LevelGrid::MemoryUsage() const {
+    if (!chunked) {
+        return storage.capacity() * sizeof(short);
+    }
+
+    return chunks.capacity() * sizeof(chunks[0]) + AllocatedChunkCount() * sizeof(LevelChunk);
+}
+
+size_t LevelGrid::AllocatedChunkCount() const {
+    size_t count = 0;
+    for (const std::shared_ptr<LevelChunk>& chunk : chunks) {
+        if (chunk != nullptr) {
+            count++;
+        }
+    }
+
+    return count;
+}
+
+LevelChunk* LevelGrid::MutableChunk(size_t chunkIndex) {
+    std::shared_ptr<LevelChunk>& chunk = chunks[chunkIndex];
+
+    if (chunk == nullptr) {
+        chunk.reset(new LevelChunk());
+    } else if (chunk.use_count() > 1) {
+        // Someone else (usually a snapshot) still reads this chunk, so write to a private copy
+        chunk.reset(new LevelChunk(*chunk));
+    }
+
+    return chunk.get();
+}
+
+void LevelGrid::SetChunked(int x, int y, short id) {
+    size_t chunkIndex = ChunkIndex(x, y);
+    int cellIndex = (y % kLevelChunkSize) * kLevelChunkSize + x % kLevelChunkSize;
+
+    const LevelChunk* current = chunks[chunkIndex].get();
+    short previous = current != nullptr ? current->tiles[cellIndex] : 0;
+    if (previous == id) {
+        return;
+    }
+
+    LevelChunk* chunk = MutableChunk(chunkIndex);
+    chunk->tiles[cellIndex] = id;
+    chunk->nonEmptyCount += (id != 0) - (previous != 0);
+
+    if (chunk->nonEmptyCount == 0) {
+        chunks[chunkIndex].reset();
+    }
+}
+
+const short* LevelGrid::ReadRow(int y, short* scratch) const {
+    if (!chunked) {
+        return Row(y);
+    }
+
+    int chunkY = y / kLevelChunkSize;
+    int rowInChunk = y % kLevelChunkSize;
+
+    for (int chunkX = 0; chunkX < chunkColumns; chunkX++) {
+        int x = chunkX * kLevelChunkSize;
+        int count = std::min(kLevelChunkSize, width - x);
+        const LevelChunk* chunk = chunks[static_cast<size_t>(chunkY) * chunkColumns + chunkX].get();
+
+        if (chunk == nullptr) {
+            std::fill(scratch + x, scratch + x + count, static_cast<short>(0));
+        } else {
+            memcpy(scratch + x, chunk->tiles + rowInChunk * kLevelChunkSize, sizeof(short) * count);
+        }
+    }
+
+    return scratch;
+}
+
+void LevelGrid::WriteRow(int y, const short* source) {
+    if (!chunked) {
+        memcpy(Row(y), source, sizeof(short) * width);
+        return;
+    }
+
+    int chunkY = y / kLevelChunkSize;
+    int rowInChunk = y % kLevelChunkSize;
+
+    for (int chunkX = 0; chunkX < chunkColumns; chunkX++) {
+        int x = chunkX * kLevelChunkSize;
+        int count = std::min(kLevelChunkSize, width - x);
+        size_t chunkIndex = static_cast<size_t>(chunkY) * chunkColumns + chunkX;
+        const short* segment = source + x;
+
+        int nonEmpty = 0;
+        for (int i = 0; i < count; i++) {
+            nonEmpty += segment[i] != 0;
+        }
+
+        // Writing zeros over a chunk that doesn't exist changes nothing
+        if (nonEmpty == 0 && chunks[chunkIndex] == nullptr) {
+            continue;
+        }
+
+        LevelChunk* chunk = MutableChunk(chunkIndex);
+        short* destination = chunk->tiles + rowInChunk * kLevelChunkSize;
+
+        int previousNonEmpty = 0;
+        for (int i = 0; i < count; i++) {
+            previousNonEmpty += destination[i] != 0;
+        }
+
+        memcpy(destination, segment, sizeof(short) * count);
+        chunk->nonEmptyCount += nonEmpty - previousNonEmpty;
+
+        if (chunk->nonEmptyCount == 0) {
+            chunks[chunkIndex].reset();
+        }
+    }
+}
+
+void LevelGrid::ReadChunk(int chunkX, int chunkY, short* out) const {
+    if (chunked) {
+        const LevelChunk* chunk = chunks[static_cast<size_t>(chunkY) * chunkColumns + chunkX].get();
+        if (chunk != nullptr) {
+            memcpy(out, chunk->tiles, sizeof(chunk->tiles));
+        } else {
+            std::fill(out, out + kLevelChunkCells, static_cast<short>(0));
+        }
+        return;
+    }
+
+    int x = chunkX * kLevelChunkSize;
+    int y = chunkY * kLevelChunkSize;
+    int columns = std::min(kLevelChunkSize, width - x);
+    int rows = std::min(kLevelChunkSize, height - y);
+
+    std::fill(out, out + kLevelChunkCells, static_cast<short>(0));
+    for (int row = 0; row < rows; row++) {
+        memcpy(out + row * kLevelChunkSize, Row(y + row) + x, sizeof(short) * columns);
+    }
+}
+
+void LevelGrid::WriteChunk(int chunkX, int chunkY, const short* source) {
+    int x = chunkX * kLevelChunkSize;
+    int y = chunkY * kLevelChunkSize;
+    int columns = std::min(kLevelChunkSize, width - x);
+    int rows = std::min(kLevelChunkSize, height - y);
+
+    if (!chunked) {
+        for (int row = 0; row < rows; row++) {
+            memcpy(Row(y + row) + x, source + row * kLevelChunkSize, sizeof(short) * columns);
+        }
+        return;
+    }
+
+    int nonEmpty = 0;
+    for (int row = 0; row < rows; row++) {
+        for (int column = 0; column < columns; column++) {
+            nonEmpty += source[row * kLevelChunkSize + column] != 0;
+        }
+    }
+
+    size_t chunkIndex = static_cast<size_t>(chunkY) * chunkColumns + chunkX;
+    if (nonEmpty == 0) {
+        chunks[chunkIndex].reset();
+        return;
+    }
+
+    // Replacing the whole chunk, so there's nothing to copy-on-write
+    std::shared_ptr<LevelChunk> chunk(new LevelChunk());
+    for (int row = 0; row < rows; row++) {
+        memcpy(chunk->tiles + row * kLevelChunkSize, source + row * kLevelChunkSize, sizeof(short) * columns);
+    }
+    chunk->nonEmptyCount = nonEmpty;
+    chunks[chunkIndex] = std::move(chunk);
+}
@@ -0,0 +1,156 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+class MappedFile;
+
+enum class LevelGridLayout {
+    // One contiguous row-major buffer
+    Dense,
+    // Fixed-size square chunks allocated on demand; all-empty chunks take no memory
+    Chunked
+};
+
+static const int kLevelChunkSize = 32;
+static const int kLevelChunkCells = kLevelChunkSize * kLevelChunkSize;
+
+// Dense rows whose width is a multiple of this many cells would all start in the same few L1 cache
+// sets, so column walks evict their own lines; those rows get kLevelRowPadding cells of padding
+static const int kLevelRowAliasCells = 256;
+// One 64-byte cache line
+static const int kLevelRowPadding = 32;
+
+// Above this many cells, levels are loaded chunked even when dense was asked for
+static const size_t kChunkedLayoutCellThreshold = static_cast<size_t>(8192) * 8192;
+
+struct LevelChunk {
+    short tiles[kLevelChunkCells];
+    // Cells that aren't 0; the chunk is released when this drops back to 0
+    int nonEmptyCount;
+};
+
+// Tile ids for a level.
+//
+// Dense grids store every cell row-major in a single contiguous buffer. Cell (x, y) lives at
+// tiles[y * stride + x]; stride is >= width so rows can be padded, and grids that own their buffer
+// pad widths that are multiples of kLevelRowAliasCells unless given a stride. The buffer is either owned by
+// the grid or borrowed from a copy-on-write file mapping, which lets binary levels back the grid
+// without a parse step.
+//
+// Chunked grids split the map into kLevelChunkSize squares. Chunks holding only tile 0 are never
+// allocated, and copying a chunked grid shares its chunks until one side writes to them, so
+// snapshots are cheap.
+//
+// Get/Set, ReadRow/WriteRow and ReadChunk/WriteChunk work with either layout. At/Row/Data are dense-only.
+class LevelGrid {
+public:
+    LevelGrid() = default;
+    LevelGrid(int width, int height, int stride = 0);
+    LevelGrid(const LevelGrid& other);
+    LevelGrid(LevelGrid&& other) noexcept;
+    LevelGrid& operator=(const LevelGrid& other);
+    LevelGrid& operator=(LevelGrid&& other) noexcept;
+
+    // Resizes the grid and sets every cell to 0; stride 0 picks DefaultStride(width)
+    void Reset(int width, int height, int stride = 0);
+    void ResetChunked(int width, int height);
+    void Reset(int width, int height, LevelGridLayout layout);
+    void Fill(short id);
+
+    // Converts the grid in place, keeping its contents
+    void SetLayout(LevelGridLayout layout);
+    LevelGridLayout Layout() const { return chunked ? LevelGridLayout::Chunked : LevelGridLayout::Dense; }
+    bool IsChunked() const { return chunked; }
+
+    // Uses tiles inside mapping as the grid's storage, keeping the mapping alive for as long as the grid uses it.
+    // tiles must be 2-byte aligned and hold stride * height native-endian shorts.
+    void AdoptMapping(std::shared_ptr<MappedFile> mapping, short* tiles, int width, int height, int stride = 0);
+    bool IsMapped() const { return mapping != nullptr; }
+
+    int Width() const { return width; }
+    int Height() const { return height; }
+    int Stride() const { return stride; }
+    static int DefaultStride(int width) {
+        return width >= kLevelRowAliasCells && width % kLevelRowAliasCells == 0 ? width + kLevelRowPadding : width;
+    }
+    size_t CellCount() const { return static_cast<size_t>(width) * height; }
+    // Heap bytes owned by the grid; mapped tiles are paged in from the file instead
+    size_t MemoryUsage() const;
+    size_t AllocatedChunkCount() const;
+
+    bool InBounds(int x, int y) const {
+        return x >= 0 && y >= 0 && x < width && y < height;
+    }
+
+    // Bounds-checked access: Get returns 0 and Set returns false outside the grid
+    short Get(int x, int y) const {
+        if (!InBounds(x, y)) {
+            return 0;
+        }
+
+        return chunked ? GetChunked(x, y) : tiles[Index(x, y)];
+    }
+
+    bool Set(int x, int y, short id) {
+        if (!InBounds(x, y)) {
+            return false;
+        }
+
+        if (chunked) {
+            SetChunked(x, y, id);
+        } else {
+            tiles[Index(x, y)] = id;
+        }
+        return true;
+    }
+
+    // Returns row y's width tiles. Dense grids return the row itself; chunked grids copy it into scratch.
+    const short* ReadRow(int y, short* scratch) const;
+    // Overwrites row y with width tiles from source
+    void WriteRow(int y, const short* source);
+
+    // Chunk-sized block access in either layout. Blocks are kLevelChunkCells row-major tiles;
+    // cells past the edge of the map read as 0 and are ignored on write.
+    int ChunkColumns() const { return (width + kLevelChunkSize - 1) / kLevelChunkSize; }
+    int ChunkRows() const { return (height + kLevelChunkSize - 1) / kLevelChunkSize; }
+    void ReadChunk(int chunkX, int chunkY, short* out) const;
+    void WriteChunk(int chunkX, int chunkY, const short* source);
+
+    // Unchecked dense-only access, for loops that already know their bounds
+    short& At(int x, int y) { return tiles[Index(x, y)]; }
+    short At(int x, int y) const { return tiles[Index(x, y)]; }
+    short* Row(int y) { return tiles + static_cast<size_t>(y) * stride; }
+    const short* Row(int y) const { return tiles + static_cast<size_t>(y) * stride; }
+    short* Data() { return tiles; }
+    const short* Data() const { return tiles; }
+
+private:
+    size_t Index(int x, int y) const { return static_cast<size_t>(y) * stride + x; }
+    size_t ChunkIndex(int x, int y) const {
+        return static_cast<size_t>(y / kLevelChunkSize) * chunkColumns + x / kLevelChunkSize;
+    }
+
+    short GetChunked(int x, int y) const {
+        const LevelChunk* chunk = chunks[ChunkIndex(x, y)].get();
+        return chunk != nullptr ? chunk->tiles[(y % kLevelChunkSize) * kLevelChunkSize + x % kLevelChunkSize] : 0;
+    }
+
+    void SetChunked(int x, int y, short id);
+    // Returns the chunk for writing, allocating it or unsharing it first as needed
+    LevelChunk* MutableChunk(size_t chunkIndex);
+    void CopyFrom(const LevelGrid& other);
+
+    int width = 0;
+    int height = 0;
+    int stride = 0;
+    short* tiles = nullptr;
+    std::vector<short> storage;
+    std::shared_ptr<MappedFile> mapping;
+
+    bool chunked = false;
+    int chunkColumns = 0;
+    int chunkRows = 0;
+    std::vector<std::shared_ptr<LevelChunk>> chunks;
+};
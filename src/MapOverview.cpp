@@ -0,0 +1,252 @@
+#include "MapOverview.h"
+#include <algorithm>
+
+// Past this many changed tiles, rebuilding is cheaper than walking up the pyramid for each one
+static const size_t kMaxOverviewInvalidCells = 16384;
+
+static uint32_t AverageColor(const uint32_t* colors, int count) {
+    uint32_t sums[4] = {0, 0, 0, 0};
+    for (int i = 0; i < count; i++) {
+        for (int channel = 0; channel < 4; channel++) {
+            sums[channel] += (colors[i] >> (channel * 8)) & 0xff;
+        }
+    }
+
+    uint32_t average = 0;
+    for (int channel = 0; channel < 4; channel++) {
+        average |= ((sums[channel] + count / 2) / count) << (channel * 8);
+    }
+    return average;
+}
+
+void MapOverview::InvalidateCell(int x, int y) {
+    if (!built) {
+        return;
+    }
+
+    if (invalidCells.size() >= kMaxOverviewInvalidCells) {
+        built = false;
+        invalidCells.clear();
+        return;
+    }
+
+    Cell cell = {x, y};
+    invalidCells.push_back(cell);
+}
+
+void MapOverview::InvalidateAll() {
+    built = false;
+    invalidCells.clear();
+    tileColorKnown.clear();
+    ClearInvalidIds();
+}
+
+void MapOverview::InvalidateTileColors(const std::vector<short>& ids) {
+    // Nothing is cached before the first Update, and a rebuild looks every colour up again anyway
+    if (tileColorKnown.empty()) {
+        return;
+    }
+
+    if (invalidIdFlags.empty()) {
+        invalidIdFlags.assign(65536, 0);
+    }
+
+    for (short id : ids) {
+        size_t index = static_cast<unsigned short>(id);
+        tileColorKnown[index] = 0;
+        if (built && !invalidIdFlags[index]) {
+            invalidIdFlags[index] = 1;
+            invalidIds.push_back(id);
+        }
+    }
+}
+
+void MapOverview::ClearInvalidIds() {
+    for (short id : invalidIds) {
+        invalidIdFlags[static_cast<unsigned short>(id)] = 0;
+    }
+    invalidIds.clear();
+}
+
+void MapOverview::InvalidateIdCells(const LevelGrid& grid) {
+    scratchRows.resize(static_cast<size_t>(gridWidth));
+    for (int y = 0; y < gridHeight && built; y++) {
+        const short* row = grid.ReadRow(y, scratchRows.data());
+        for (int x = 0; x < gridWidth && built; x++) {
+            if (invalidIdFlags[static_cast<unsigned short>(row[x])]) {
+                // Past kMaxOverviewInvalidCells this gives up and asks for a rebuild
+                InvalidateCell(x, y);
+            }
+        }
+    }
+
+    ClearInvalidIds();
+}
+
+int MapOverview::LevelWidth(int level) const {
+    return level == 0 ? gridWidth : levels[level - 1].width;
+}
+
+int MapOverview::LevelHeight(int level) const {
+    return level == 0 ? gridHeight : levels[level - 1].height;
+}
+
+size_t MapOverview::MemoryUsage() const {
+    size_t usage = tileColors.capacity() * sizeof(uint32_t) + tileColorKnown.capacity();
+    for (const Level& level : levels) {
+        usage += level.colors.capacity() * sizeof(uint32_t);
+    }
+    return usage;
+}
+
+uint32_t MapOverview::TileColor(short id, const TileColorLookup& lookup) {
+    size_t index = static_cast<unsigned short>(id);
+    if (tileColorKnown.empty()) {
+        tileColors.assign(65536, 0);
+        tileColorKnown.assign(65536, 0);
+    }
+
+    if (!tileColorKnown[index]) {
+        tileColors[index] = lookup(id);
+        tileColorKnown[index] = 1;
+    }
+
+    return tileColors[index];
+}
+
+void MapOverview::Update(const LevelGrid& grid, const TileColorLookup& lookup) {
+    if (built && !invalidIds.empty() && grid.Width() == gridWidth && grid.Height() == gridHeight) {
+        InvalidateIdCells(grid);
+    }
+
+    if (!built || grid.Width() != gridWidth || grid.Height() != gridHeight) {
+        Build(grid, lookup);
+        return;
+    }
+
+    if (invalidCells.empty()) {
+        return;
+    }
+
+    for (const Cell& cell : invalidCells) {
+        if (grid.InBounds(cell.x, cell.y)) {
+            UpdateCell(grid, cell.x, cell.y, lookup);
+        }
+    }
+
+    invalidCells.clear();
+    revision++;
+}
+
+void MapOverview::Build(const LevelGrid& grid, const TileColorLookup& lookup) {
+    gridWidth = grid.Width();
+    gridHeight = grid.Height();
+    levels.clear();
+    invalidCells.clear();
+    ClearInvalidIds();
+    built = true;
+    revision++;
+
+    int width = gridWidth;
+    int height = gridHeight;
+    while (width > 1 || height > 1) {
+        Level level;
+        level.width = (width + 1) / 2;
+        level.height = (height + 1) / 2;
+        level.colors.resize(static_cast<size_t>(level.width) * level.height);
+        levels.push_back(std::move(level));
+
+        width = levels.back().width;
+        height = levels.back().height;
+    }
+
+    if (levels.empty()) {
+        return;
+    }
+
+    // Level 1 straight from the grid, two rows at a time
+    Level& first = levels[0];
+    scratchRows.resize(static_cast<size_t>(gridWidth) * 2);
+    for (int y = 0; y < first.height; y++) {
+        int rowCount = std::min(2, gridHeight - y * 2);
+        const short* rows[2];
+        for (int row = 0; row < rowCount; row++) {
+            rows[row] = grid.ReadRow(y * 2 + row, &scratchRows[static_cast<size_t>(row) * gridWidth]);
+        }
+
+        for (int x = 0; x < first.width; x++) {
+            int columnCount = std::min(2, gridWidth - x * 2);
+            uint32_t colors[4];
+            int count = 0;
+            for (int row = 0; row < rowCount; row++) {
+                for (int column = 0; column < columnCount; column++) {
+                    colors[count++] = TileColor(rows[row][x * 2 + column], lookup);
+                }
+            }
+
+            first.colors[static_cast<size_t>(y) * first.width + x] = AverageColor(colors, count);
+        }
+    }
+
+    for (int level = 2; level <= static_cast<int>(levels.size()); level++) {
+        for (int y = 0; y < levels[level - 1].height; y++) {
+            for (int x = 0; x < levels[level - 1].width; x++) {
+                ReduceCell(level, x, y);
+            }
+        }
+    }
+}
+
+void MapOverview::UpdateCell(const LevelGrid& grid, int x, int y, const TileColorLookup& lookup) {
+    Level& first = levels[0];
+    int cellX = x / 2;
+    int cellY = y / 2;
+
+    uint32_t colors[4];
+    int count = 0;
+    for (int tileY = cellY * 2; tileY < std::min(cellY * 2 + 2, gridHeight); tileY++) {
+        for (int tileX = cellX * 2; tileX < std::min(cellX * 2 + 2, gridWidth); tileX++) {
+            colors[count++] = TileColor(grid.Get(tileX, tileY), lookup);
+        }
+    }
+    first.colors[static_cast<size_t>(cellY) * first.width + cellX] = AverageColor(colors, count);
+
+    for (int level = 2; level <= static_cast<int>(levels.size()); level++) {
+        ReduceCell(level, x >> level, y >> level);
+    }
+}
+
+void MapOverview::ReduceCell(int level, int x, int y) {
+    const Level& below = levels[level - 2];
+    Level& target = levels[level - 1];
+
+    uint32_t colors[4];
+    int count = 0;
+    for (int childY = y * 2; childY < std::min(y * 2 + 2, below.height); childY++) {
+        for (int childX = x * 2; childX < std::min(x * 2 + 2, below.width); childX++) {
+            colors[count++] = below.colors[static_cast<size_t>(childY) * below.width + childX];
+        }
+    }
+
+    target.colors[static_cast<size_t>(y) * target.width + x] = AverageColor(colors, count);
+}
+
+void MapOverview::ReadRegion(const LevelGrid& grid, int level, int x, int y, int width, int height, uint32_t* pixels, int pitch, const TileColorLookup& lookup) {
+    if (level == 0) {
+        scratchRows.resize(static_cast<size_t>(grid.Width()));
+        for (int row = 0; row < height; row++) {
+            const short* tiles = grid.ReadRow(y + row, scratchRows.data());
+            uint32_t* out = pixels + static_cast<size_t>(row) * pitch;
+            for (int column = 0; column < width; column++) {
+                out[column] = TileColor(tiles[x + column], lookup);
+            }
+        }
+        return;
+    }
+
+    const Level& source = levels[level - 1];
+    for (int row = 0; row < height; row++) {
+        const uint32_t* in = &source.colors[static_cast<size_t>(y + row) * source.width + x];
+        std::copy(in, in + width, pixels + static_cast<size_t>(row) * pitch);
+    }
+}
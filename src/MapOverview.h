@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include "LevelGrid.h"
+
+// Returns the colour a tile id stands for in the overview, as RGBA bytes in memory order
+typedef std::function<uint32_t(short id)> TileColorLookup;
+
+// A mip pyramid of average tile colours for drawing a zoomed-out map cheaply.
+//
+// Level 0 has one colour per cell, the average colour of the cell's texture, and each further level
+// averages 2x2 cells of the one below until a single cell is left. Level 0 isn't stored: it's read
+// straight from the grid through the colour lookup, which keeps a 16384x16384 map's pyramid at a
+// third of its level 0 size. Colours are cached per tile id, so the lookup runs once per id until
+// InvalidateAll.
+//
+// Update builds the pyramid on first use and afterwards only recomputes the cells above the tiles
+// passed to InvalidateCell, one cell per level. When ids change colour, as textures stream in, the
+// next Update finds the cells that use them in one pass over the grid and recomputes those, which
+// is far cheaper than rebuilding the pyramid.
+class MapOverview {
+public:
+    // The tile at (x, y) changed
+    void InvalidateCell(int x, int y);
+    // Rebuild from scratch, e.g. when tile ids were mapped to other textures or the level was replaced
+    void InvalidateAll();
+    // The colours of these ids changed
+    void InvalidateTileColors(const std::vector<short>& ids);
+
+    // Brings the pyramid up to date with the grid
+    void Update(const LevelGrid& grid, const TileColorLookup& lookup);
+
+    // Copies a width x height block of cells at (x, y) of a level into pixels, pitch pixels per row
+    void ReadRegion(const LevelGrid& grid, int level, int x, int y, int width, int height, uint32_t* pixels, int pitch, const TileColorLookup& lookup);
+
+    int LevelCount() const { return static_cast<int>(levels.size()) + 1; }
+    int LevelWidth(int level) const;
+    int LevelHeight(int level) const;
+    // Changes whenever a cell of any level does
+    unsigned Revision() const { return revision; }
+    size_t MemoryUsage() const;
+
+private:
+    struct Cell {
+        int x;
+        int y;
+    };
+
+    struct Level {
+        int width;
+        int height;
+        std::vector<uint32_t> colors;
+    };
+
+    uint32_t TileColor(short id, const TileColorLookup& lookup);
+    void Build(const LevelGrid& grid, const TileColorLookup& lookup);
+    // Recomputes the level 1 cell above tile (x, y) and everything above that
+    void UpdateCell(const LevelGrid& grid, int x, int y, const TileColorLookup& lookup);
+    void ReduceCell(int level, int x, int y);
+    // Invalidates every cell whose id is in invalidIds
+    void InvalidateIdCells(const LevelGrid& grid);
+    void ClearInvalidIds();
+
+    // Levels 1 and up
+    std::vector<Level> levels;
+    int gridWidth = 0;
+    int gridHeight = 0;
+    bool built = false;
+    unsigned revision = 0;
+    std::vector<Cell> invalidCells;
+    // Ids whose colour changed since the last Update, with a flag per id to look them up by
+    std::vector<short> invalidIds;
+    std::vector<unsigned char> invalidIdFlags;
+
+    std::vector<uint32_t> tileColors;
+    std::vector<unsigned char> tileColorKnown;
+    std::vector<short> scratchRows;
+};
@@ -0,0 +1,57 @@
+#include "MappedFile.h"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::~MappedFile() {
+    Close();
+}
+
+bool MappedFile::Open(const char* filePath, bool copyOnWrite, std::string& error) {
+    Close();
+
+    int fd = open(filePath, O_RDONLY);
+    if (fd == -1) {
+        error = std::string("Could not open ") + filePath + ": " + strerror(errno);
+        return false;
+    }
+
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) == -1) {
+        error = std::string("Could not stat ") + filePath + ": " + strerror(errno);
+        close(fd);
+        return false;
+    }
+
+    if (fileStat.st_size == 0) {
+        error = std::string("File is empty: ") + filePath;
+        close(fd);
+        return false;
+    }
+
+    int protection = copyOnWrite ? (PROT_READ | PROT_WRITE) : PROT_READ;
+    void* mapping = mmap(nullptr, static_cast<size_t>(fileStat.st_size), protection, MAP_PRIVATE, fd, 0);
+    // The mapping keeps its own reference to the file
+    close(fd);
+
+    if (mapping == MAP_FAILED) {
+        error = std::string("Could not map ") + filePath + ": " + strerror(errno);
+        return false;
+    }
+
+    data = static_cast<unsigned char*>(mapping);
+    size = static_cast<size_t>(fileStat.st_size);
+
+    return true;
+}
+
+void MappedFile::Close() {
+    if (data != nullptr) {
+        munmap(data, size);
+        data = nullptr;
+        size = 0;
+    }
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// Read-only view of a whole file through mmap.
+// With copyOnWrite the pages are mapped private and writable, so callers can edit them in place
+// without the changes ever reaching the file on disk.
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool Open(const char* filePath, bool copyOnWrite, std::string& error);
+    void Close();
+
+    bool IsOpen() const { return data != nullptr; }
+    unsigned char* Data() const { return data; }
+    size_t Size() const { return size; }
+
+private:
+    unsigned char* data = nullptr;
+    size_t size = 0;
+};
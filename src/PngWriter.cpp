@@ -0,0 +1,113 @@
+#include "PngWriter.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+// Largest payload of a stored deflate block
+static const size_t kMaxStoredBlockSize = 65535;
+
+static uint32_t Crc32(const unsigned char* data, size_t size, uint32_t crc = 0) {
+    static uint32_t table[256];
+    static bool tableReady = false;
+    if (!tableReady) {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t value = i;
+            for (int bit = 0; bit < 8; bit++) {
+                value = (value & 1) != 0 ? 0xedb88320u ^ (value >> 1) : value >> 1;
+            }
+            table[i] = value;
+        }
+        tableReady = true;
+    }
+
+    crc = ~crc;
+    for (size_t i = 0; i < size; i++) {
+        crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+static void AppendBigEndian32(std::vector<unsigned char>& out, uint32_t value) {
+    out.push_back(static_cast<unsigned char>(value >> 24));
+    out.push_back(static_cast<unsigned char>(value >> 16));
+    out.push_back(static_cast<unsigned char>(value >> 8));
+    out.push_back(static_cast<unsigned char>(value));
+}
+
+static void AppendChunk(std::vector<unsigned char>& out, const char* type, const std::vector<unsigned char>& data) {
+    AppendBigEndian32(out, static_cast<uint32_t>(data.size()));
+    size_t typeOffset = out.size();
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), data.begin(), data.end());
+    AppendBigEndian32(out, Crc32(&out[typeOffset], out.size() - typeOffset));
+}
+
+bool WritePng(const char* path, const unsigned char* pixels, int width, int height, int pitch, std::string& error) {
+    if (width <= 0 || height <= 0) {
+        error = "Empty image";
+        return false;
+    }
+
+    // Every row is a filter type byte (0, none) and the row's pixels
+    size_t rowSize = static_cast<size_t>(width) * 4 + 1;
+    std::vector<unsigned char> raw(rowSize * height);
+    for (int y = 0; y < height; y++) {
+        raw[y * rowSize] = 0;
+        memcpy(&raw[y * rowSize + 1], pixels + static_cast<size_t>(y) * pitch, rowSize - 1);
+    }
+
+    std::vector<unsigned char> header;
+    AppendBigEndian32(header, static_cast<uint32_t>(width));
+    AppendBigEndian32(header, static_cast<uint32_t>(height));
+    header.push_back(8);  // Bits per channel
+    header.push_back(6);  // RGBA
+    header.push_back(0);  // Deflate
+    header.push_back(0);  // Adaptive filtering
+    header.push_back(0);  // Not interlaced
+
+    // A zlib stream of stored blocks, then the Adler-32 of the uncompressed data
+    std::vector<unsigned char> data;
+    data.reserve(raw.size() + raw.size() / kMaxStoredBlockSize * 5 + 16);
+    data.push_back(0x78);
+    data.push_back(0x01);
+    uint32_t adlerA = 1;
+    uint32_t adlerB = 0;
+    for (size_t offset = 0; offset < raw.size(); offset += kMaxStoredBlockSize) {
+        size_t size = std::min(kMaxStoredBlockSize, raw.size() - offset);
+        data.push_back(offset + size == raw.size() ? 1 : 0);
+        data.push_back(static_cast<unsigned char>(size));
+        data.push_back(static_cast<unsigned char>(size >> 8));
+        data.push_back(static_cast<unsigned char>(~size));
+        data.push_back(static_cast<unsigned char>(~size >> 8));
+        data.insert(data.end(), raw.begin() + offset, raw.begin() + offset + size);
+
+        for (size_t i = offset; i < offset + size; i++) {
+            adlerA = (adlerA + raw[i]) % 65521;
+            adlerB = (adlerB + adlerA) % 65521;
+        }
+    }
+    AppendBigEndian32(data, (adlerB << 16) | adlerA);
+
+    static const unsigned char kSignature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+    std::vector<unsigned char> file(kSignature, kSignature + sizeof(kSignature));
+    AppendChunk(file, "IHDR", header);
+    AppendChunk(file, "IDAT", data);
+    AppendChunk(file, "IEND", std::vector<unsigned char>());
+
+    FILE* out = fopen(path, "wb");
+    if (out == nullptr) {
+        error = std::string("Failed to open ") + path + ": " + strerror(errno);
+        return false;
+    }
+
+    bool written = fwrite(file.data(), 1, file.size(), out) == file.size();
+    if (fclose(out) != 0 || !written) {
+        error = std::string("Failed to write ") + path;
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+#include <string>
+
+// Writes 8-bit RGBA pixels as a PNG, pitch bytes per row.
+//
+// The image data is stored in uncompressed deflate blocks: files are about as big as the raw pixels,
+// but the writer is small, has no dependencies and produces the same bytes for the same pixels,
+// which is what golden-image captures need.
+bool WritePng(const char* path, const unsigned char* pixels, int width, int height, int pitch, std::string& error);
@@ -0,0 +1,538 @@
+#include "TextLevelParser.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+// Below this many tiles, starting threads costs more than it saves
+static const size_t kParallelTileThreshold = 1 << 16;
+
+struct ParseError {
+    size_t line = 0;
+    size_t column = 0;
+    std::string message;
+
+    bool IsSet() const { return line != 0; }
+};
+
+static void SetError(ParseError& error, size_t line, size_t column, const std::string& message) {
+    error.line = line;
+    error.column = column;
+    error.message = message;
+}
+
+static std::string FormatError(const ParseError& error) {
+    return "line " + std::to_string(error.line) + ", column " + std::to_string(error.column) + ": " + error.message;
+}
+
+static bool IsBlank(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+static bool IsDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+// True if an integer starts at p, so a parse failure there means it was out of range
+static bool StartsNumber(const char* p, const char* end) {
+    if (p != end && (*p == '-' || *p == '+')) {
+        p++;
+    }
+
+    return p != end && IsDigit(*p);
+}
+
+static std::string Describe(char c) {
+    if (c == '\n') {
+        return "end of line";
+    }
+
+    if (static_cast<unsigned char>(c) < 0x20 || static_cast<unsigned char>(c) >= 0x7f) {
+        char hex[8];
+        snprintf(hex, sizeof(hex), "0x%02x", static_cast<unsigned char>(c));
+        return hex;
+    }
+
+    return std::string("'") + c + "'";
+}
+
+// Walks the buffer keeping track of the current line and column for error messages
+struct Cursor {
+    const char* data;
+    const char* end;
+    const char* position;
+    const char* lineStart;
+    size_t line;
+
+    size_t Column() const { return static_cast<size_t>(position - lineStart) + 1; }
+    bool AtEnd() const { return position == end; }
+
+    void SkipBlanks() {
+        while (position != end && IsBlank(*position)) {
+            position++;
+        }
+    }
+
+    // Skips blanks and newlines, the way operator>> would
+    void SkipWhitespace() {
+        while (position != end && (IsBlank(*position) || *position == '\n')) {
+            if (*position == '\n') {
+                NextLine(position + 1);
+            } else {
+                position++;
+            }
+        }
+    }
+
+    void NextLine(const char* start) {
+        position = start;
+        lineStart = start;
+        line++;
+    }
+
+    // Consumes the rest of the current line, which must be blank
+    bool EndLine(ParseError& error) {
+        SkipBlanks();
+        if (position == end) {
+            return true;
+        }
+
+        if (*position != '\n') {
+            SetError(error, line, Column(), "unexpected " + Describe(*position) + " at end of line");
+            return false;
+        }
+
+        NextLine(position + 1);
+        return true;
+    }
+};
+
+// Parses an optionally signed decimal integer in [minimum, maximum] starting at position
+static bool ParseInteger(const char*& position, const char* end, long minimum, long maximum, long& value) {
+    const char* p = position;
+    bool negative = false;
+
+    if (p != end && (*p == '-' || *p == '+')) {
+        negative = *p == '-';
+        p++;
+    }
+
+    if (p == end || !IsDigit(*p)) {
+        return false;
+    }
+
+    long magnitude = 0;
+    while (p != end && IsDigit(*p)) {
+        magnitude = magnitude * 10 + (*p - '0');
+        // Bail out early so long inputs can't overflow
+        if (magnitude > maximum + 1L && magnitude > -minimum) {
+            return false;
+        }
+        p++;
+    }
+
+    value = negative ? -magnitude : magnitude;
+    if (value < minimum || value > maximum) {
+        return false;
+    }
+
+    position = p;
+    return true;
+}
+
+// Exact powers of ten as doubles; 10^23 is the first that isn't
+static const double kExactPowersOfTen[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                           1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+static const int kMaxExactPowerOfTen = 22;
+// Digits past this many can't change a float, and more would overflow the mantissa
+static const int kMaxFloatMantissaDigits = 19;
+
+static bool MatchesIgnoringCase(const char* p, const char* end, const char* word) {
+    for (; *word != '\0'; p++, word++) {
+        if (p == end || (*p | 0x20) != *word) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Parses [sign] digits [. digits] [e [sign] digits], or inf, infinity or nan, starting at position
+// and leaves position where the number ends; false, with position where it stopped, if there's no
+// number there. Unlike strtod it ignores LC_NUMERIC, so what BufferedFileWriter::WriteFloat writes
+// reads back the same under any locale. With up to 15 significant digits and an exponent within
+// ±22, which covers everything the editor writes, the result is the correctly rounded double, as
+// from strtod; beyond that it can be a unit off in the last place of the double.
+static bool ParseFloat(const char*& position, const char* end, double& value) {
+    const char* p = position;
+    bool negative = false;
+    if (p != end && (*p == '-' || *p == '+')) {
+        negative = *p == '-';
+        p++;
+    }
+
+    static const char* const kSpecialValues[] = {"infinity", "inf", "nan"};
+    for (const char* special : kSpecialValues) {
+        if (MatchesIgnoringCase(p, end, special)) {
+            value = special[0] == 'n' ? NAN : (negative ? -HUGE_VAL : HUGE_VAL);
+            position = p + strlen(special);
+            return true;
+        }
+    }
+
+    // The number is mantissa * 10^exponent
+    uint64_t mantissa = 0;
+    int mantissaDigits = 0;
+    int exponent = 0;
+    bool anyDigits = false;
+    bool fraction = false;
+    for (; p != end; p++) {
+        if (*p == '.' && !fraction) {
+            fraction = true;
+            continue;
+        }
+        if (!IsDigit(*p)) {
+            break;
+        }
+
+        anyDigits = true;
+        if (mantissaDigits < kMaxFloatMantissaDigits) {
+            mantissa = mantissa * 10 + static_cast<uint64_t>(*p - '0');
+            // Leading zeros aren't significant
+            mantissaDigits += mantissa != 0 ? 1 : 0;
+            exponent -= fraction ? 1 : 0;
+        } else {
+            exponent += fraction ? 0 : 1;
+        }
+    }
+
+    if (!anyDigits) {
+        position = p;
+        return false;
+    }
+
+    if (p != end && (*p == 'e' || *p == 'E')) {
+        const char* q = p + 1;
+        bool negativeExponent = false;
+        if (q != end && (*q == '-' || *q == '+')) {
+            negativeExponent = *q == '-';
+            q++;
+        }
+
+        // Like strtod, an 'e' without digits after it isn't part of the number
+        if (q != end && IsDigit(*q)) {
+            int written = 0;
+            for (; q != end && IsDigit(*q); q++) {
+                // Far past where every double is zero or infinite, so the sum below can't overflow
+                written = std::min(written * 10 + (*q - '0'), 100000);
+            }
+            exponent += negativeExponent ? -written : written;
+            p = q;
+        }
+    }
+
+    double result = static_cast<double>(mantissa);
+    if (mantissa != 0) {
+        exponent = std::max(-400, std::min(exponent, 400));
+        for (; exponent > kMaxExactPowerOfTen; exponent -= kMaxExactPowerOfTen) {
+            result *= kExactPowersOfTen[kMaxExactPowerOfTen];
+        }
+        for (; exponent < -kMaxExactPowerOfTen; exponent += kMaxExactPowerOfTen) {
+            result /= kExactPowersOfTen[kMaxExactPowerOfTen];
+        }
+        result = exponent >= 0 ? result * kExactPowersOfTen[exponent] : result / kExactPowersOfTen[-exponent];
+    }
+
+    value = negative ? -result : result;
+    position = p;
+    return true;
+}
+
+static bool ReadInteger(Cursor& cursor, long minimum, long maximum, const char* what, long& value, ParseError& error) {
+    cursor.SkipWhitespace();
+    if (cursor.AtEnd()) {
+        SetError(error, cursor.line, cursor.Column(), std::string("expected ") + what + ", found end of file");
+        return false;
+    }
+
+    const char* start = cursor.position;
+    if (!ParseInteger(cursor.position, cursor.end, minimum, maximum, value)) {
+        SetError(error, cursor.line, cursor.Column(),
+                 StartsNumber(start, cursor.end) ? std::string(what) + " out of range" : std::string("expected ") + what + ", found " + Describe(*start));
+        return false;
+    }
+
+    if (!cursor.AtEnd() && !IsBlank(*cursor.position) && *cursor.position != '\n') {
+        SetError(error, cursor.line, cursor.Column(), std::string("unexpected ") + Describe(*cursor.position) + " in " + what);
+        return false;
+    }
+
+    return true;
+}
+
+static bool ReadFloat(Cursor& cursor, const char* what, float& value, ParseError& error) {
+    cursor.SkipWhitespace();
+    const char* start = cursor.position;
+    while (!cursor.AtEnd() && !IsBlank(*cursor.position) && *cursor.position != '\n') {
+        cursor.position++;
+    }
+
+    if (cursor.position == start) {
+        SetError(error, cursor.line, cursor.Column(), std::string("expected ") + what);
+        return false;
+    }
+
+    const char* parsedEnd = start;
+    double parsed = 0.0;
+    if (!ParseFloat(parsedEnd, cursor.position, parsed) || parsedEnd != cursor.position) {
+        size_t column = static_cast<size_t>(parsedEnd - cursor.lineStart) + 1;
+        SetError(error, cursor.line, column, std::string("malformed ") + what);
+        return false;
+    }
+
+    value = static_cast<float>(parsed);
+    return true;
+}
+
+struct RowSpan {
+    const char* begin;
+    const char* end;
+};
+
+// Parses one line of exactly width tile ids into row
+static bool ParseRow(const RowSpan& span, size_t line, int width, short* row, ParseError& error) {
+    const char* p = span.begin;
+    int count = 0;
+
+    for (;;) {
+        while (p != span.end && IsBlank(*p)) {
+            p++;
+        }
+
+        if (p == span.end) {
+            break;
+        }
+
+        long value;
+        const char* start = p;
+        if (!ParseInteger(p, span.end, -32768, 32767, value)) {
+            std::string message = StartsNumber(start, span.end)
+                                  ? "tile id out of range"
+                                  : "unexpected " + Describe(*start);
+            SetError(error, line, static_cast<size_t>(start - span.begin) + 1, message);
+            return false;
+        }
+
+        if (p != span.end && !IsBlank(*p)) {
+            SetError(error, line, static_cast<size_t>(p - span.begin) + 1, "unexpected " + Describe(*p) + " in tile id");
+            return false;
+        }
+
+        if (count == width) {
+            SetError(error, line, static_cast<size_t>(start - span.begin) + 1,
+                     "row has more than the " + std::to_string(width) + " tiles given in the header");
+            return false;
+        }
+
+        row[count++] = static_cast<short>(value);
+    }
+
+    if (count != width) {
+        SetError(error, line, static_cast<size_t>(p - span.begin) + 1,
+                 "expected " + std::to_string(width) + " tiles, found " + std::to_string(count));
+        return false;
+    }
+
+    return true;
+}
+
+// Parses rows [first, last) and stops at the first bad one
+// Chunked grids are parsed into a scratch row and copied over, so callers must give each thread
+// whole chunk rows; threads then never touch the same chunk.
+static void ParseRows(const std::vector<RowSpan>& rows, size_t first, size_t last, size_t firstLine, LevelGrid& grid,
+                      ParseError& error) {
+    std::vector<short> scratch(grid.IsChunked() ? static_cast<size_t>(grid.Width()) : 0);
+
+    for (size_t y = first; y < last; y++) {
+        int row = static_cast<int>(y);
+        short* destination = grid.IsChunked() ? scratch.data() : grid.Row(row);
+
+        if (!ParseRow(rows[y], firstLine + y, grid.Width(), destination, error)) {
+            return;
+        }
+
+        if (grid.IsChunked()) {
+            grid.WriteRow(row, destination);
+        }
+    }
+}
+
+static bool ParseTiles(Cursor& cursor, LevelGrid& grid, ParseError& error) {
+    int height = grid.Height();
+
+    // Find every row boundary up front so the rows can be split between threads
+    std::vector<RowSpan> rows(static_cast<size_t>(height));
+    size_t firstLine = cursor.line;
+    const char* position = cursor.position;
+
+    for (int y = 0; y < height; y++) {
+        if (position == cursor.end) {
+            SetError(error, firstLine + y, 1,
+                     "expected " + std::to_string(height) + " rows, found " + std::to_string(y));
+            return false;
+        }
+
+        const char* newline = static_cast<const char*>(memchr(position, '\n', static_cast<size_t>(cursor.end - position)));
+        const char* lineEnd = newline != nullptr ? newline : cursor.end;
+        rows[y].begin = position;
+        rows[y].end = lineEnd;
+        position = newline != nullptr ? newline + 1 : cursor.end;
+    }
+
+    cursor.line = firstLine + static_cast<size_t>(height);
+    cursor.position = position;
+    cursor.lineStart = position;
+
+    size_t threadCount = 1;
+    if (grid.CellCount() >= kParallelTileThreshold) {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+        threadCount = std::min(threadCount, static_cast<size_t>(height));
+    }
+
+    if (threadCount == 1) {
+        ParseRows(rows, 0, rows.size(), firstLine, grid, error);
+        return !error.IsSet();
+    }
+
+    // Each thread records its own first error; the earliest one in the file wins
+    std::vector<ParseError> errors(threadCount);
+    std::vector<std::thread> threads;
+    size_t rowsPerThread = (rows.size() + threadCount - 1) / threadCount;
+    rowsPerThread = (rowsPerThread + kLevelChunkSize - 1) / kLevelChunkSize * kLevelChunkSize;
+
+    for (size_t i = 0; i < threadCount; i++) {
+        size_t first = i * rowsPerThread;
+        size_t last = std::min(rows.size(), first + rowsPerThread);
+        if (first >= last) {
+            break;
+        }
+
+        threads.emplace_back(ParseRows, std::cref(rows), first, last, firstLine, std::ref(grid), std::ref(errors[i]));
+    }
+
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    for (const ParseError& threadError : errors) {
+        if (threadError.IsSet()) {
+            error = threadError;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool ParseSpawns(Cursor& cursor, std::vector<EnemySpawnLocation>& enemySpawnLocations, ParseError& error) {
+    // Levels saved before enemies existed stop after the tiles
+    cursor.SkipWhitespace();
+    if (cursor.AtEnd()) {
+        return true;
+    }
+
+    long count;
+    if (!ReadInteger(cursor, 0, 1L << 24, "enemy spawn count", count, error) || !cursor.EndLine(error)) {
+        return false;
+    }
+
+    enemySpawnLocations.reserve(static_cast<size_t>(count));
+
+    for (long i = 0; i < count; i++) {
+        cursor.SkipWhitespace();
+        if (cursor.AtEnd()) {
+            SetError(error, cursor.line, cursor.Column(),
+                     "expected " + std::to_string(count) + " enemy spawns, found " + std::to_string(i));
+            return false;
+        }
+
+        long textureId;
+        EnemySpawnLocation location;
+        if (!ReadInteger(cursor, -2147483647L - 1, 2147483647L, "enemy texture id", textureId, error) ||
+            !ReadFloat(cursor, "enemy x position", location.x, error) ||
+            !ReadFloat(cursor, "enemy y position", location.y, error) ||
+            !cursor.EndLine(error)) {
+            return false;
+        }
+
+        location.textureId = static_cast<int>(textureId);
+        enemySpawnLocations.push_back(location);
+    }
+
+    return true;
+}
+
+static bool ParseTextureNames(Cursor& cursor, std::map<std::string, short>& textureNameToTextureIdMap, ParseError& error) {
+    for (;;) {
+        cursor.SkipWhitespace();
+        if (cursor.AtEnd()) {
+            return true;
+        }
+
+        long id;
+        if (!ReadInteger(cursor, -32768, 32767, "texture id", id, error)) {
+            return false;
+        }
+
+        cursor.SkipBlanks();
+        const char* nameStart = cursor.position;
+        while (!cursor.AtEnd() && !IsBlank(*cursor.position) && *cursor.position != '\n') {
+            cursor.position++;
+        }
+
+        if (cursor.position == nameStart) {
+            SetError(error, cursor.line, cursor.Column(), "expected texture name");
+            return false;
+        }
+
+        textureNameToTextureIdMap[std::string(nameStart, cursor.position)] = static_cast<short>(id);
+
+        if (!cursor.EndLine(error)) {
+            return false;
+        }
+    }
+}
+
+bool ParseTextLevel(const char* data, size_t size, Level& level, std::string& error, LevelGridLayout layout) {
+    Cursor cursor = {data, data + size, data, data, 1};
+    ParseError parseError;
+
+    long width;
+    long height;
+    if (!ReadInteger(cursor, 1, kMaxLevelDimension, "map width", width, parseError) ||
+        !ReadInteger(cursor, 1, kMaxLevelDimension, "map height", height, parseError) ||
+        !cursor.EndLine(parseError)) {
+        error = FormatError(parseError);
+        return false;
+    }
+
+    if (static_cast<size_t>(width) * height > kChunkedLayoutCellThreshold) {
+        layout = LevelGridLayout::Chunked;
+    }
+
+    level.grid.Reset(static_cast<int>(width), static_cast<int>(height), layout);
+    level.enemySpawnLocations.clear();
+    level.textureNameToTextureIdMap.clear();
+
+    if (!ParseTiles(cursor, level.grid, parseError) ||
+        !ParseSpawns(cursor, level.enemySpawnLocations, parseError) ||
+        !ParseTextureNames(cursor, level.textureNameToTextureIdMap, parseError)) {
+        error = FormatError(parseError);
+        return false;
+    }
+
+    return true;
+}
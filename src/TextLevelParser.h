@@ -0,0 +1,12 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include "Level.h"
+
+// Parses a legacy text level held entirely in memory (usually a mapped file).
+// The tile rows are located first and then parsed in parallel. Malformed input, including a
+// header that doesn't match the rows that follow, fails with "line L, column C: ..." in error.
+// Levels bigger than kChunkedLayoutCellThreshold always get a chunked grid.
+bool ParseTextLevel(const char* data, size_t size, Level& level, std::string& error,
+                    LevelGridLayout layout = LevelGridLayout::Dense);
@@ -1,21 +1,18 @@
 #pragma once
 
+#include <string>
 #include "SDL.h"
+#include "TextureAtlas.h"
 
+// A tile image. Its pixels live in the application's TextureAtlas, which owns the SDL textures.
 struct Texture {
-//    ~Texture() {
-//        // Deallocate the texture data
-//        // id, name, width, height, channels are automatically deallocated
-//        if (sdlTexture != nullptr) {
-//            SDL_DestroyTexture(sdlTexture);
-//            sdlTexture = nullptr;
-//        }
-//    }
-
     short id;
     std::string name;
-    SDL_Texture* sdlTexture;
-    SDL_Renderer* sdlRenderer;
+    // Where the image is in the TextureStreamer, or -1 for one loaded directly, like the fallback
+    int streamIndex = -1;
+    // The fallback's region until the streamer has loaded the image
+    AtlasRegion atlasRegion;
+    // Mean of the image's pixels, for the zoomed-out map overview
+    ImU32 averageColor;
     int width, height, channels;
 };
-
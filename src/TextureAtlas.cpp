@@ -0,0 +1,144 @@
+#include "TextureAtlas.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+// imgui_draw.cpp compiles its copy of the packer as static, so this file needs its own
+#define STBRP_STATIC
+#define STB_RECT_PACK_IMPLEMENTATION
+#include "imstb_rectpack.h"
+
+static const int kPadding = 1;
+
+struct TextureAtlas::Page {
+    SDL_Texture* texture = nullptr;
+    int width = 0;
+    int height = 0;
+    stbrp_context context;
+    std::vector<stbrp_node> nodes;
+};
+
+// Out of line so Page is complete wherever pages gets constructed and destroyed
+TextureAtlas::TextureAtlas() {
+}
+
+TextureAtlas::~TextureAtlas() {
+    Clear();
+}
+
+void TextureAtlas::SetRenderer(SDL_Renderer* renderer) {
+    this->renderer = renderer;
+
+    SDL_RendererInfo info;
+    if (renderer != nullptr && SDL_GetRendererInfo(renderer, &info) == 0 && info.max_texture_width > 0 && info.max_texture_height > 0) {
+        pageSize = std::min(kMaxAtlasPageSize, std::min(info.max_texture_width, info.max_texture_height));
+    }
+}
+
+SDL_Texture* TextureAtlas::PageTexture(int page) const {
+    return pages[page]->texture;
+}
+
+void TextureAtlas::Clear() {
+    for (const std::unique_ptr<Page>& page : pages) {
+        if (page->texture != nullptr) {
+            SDL_DestroyTexture(page->texture);
+        }
+    }
+
+    pages.clear();
+}
+
+void TextureAtlas::RemovePage(SDL_Texture* texture) {
+    for (size_t i = 0; i < pages.size(); i++) {
+        if (pages[i]->texture == texture) {
+            SDL_DestroyTexture(texture);
+            pages.erase(pages.begin() + i);
+            return;
+        }
+    }
+}
+
+size_t TextureAtlas::MemoryUsage() const {
+    size_t usage = 0;
+    for (const std::unique_ptr<Page>& page : pages) {
+        usage += static_cast<size_t>(page->width) * page->height * 4;
+    }
+    return usage;
+}
+
+bool TextureAtlas::AddPage(int width, int height) {
+    SDL_Texture* texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_STATIC, width, height);
+    if (texture == nullptr) {
+        fprintf(stderr, "Failed to create atlas page: %s\n", SDL_GetError());
+        return false;
+    }
+
+    SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+
+    // Clear it so the gaps between images are transparent rather than whatever the driver left there
+    std::vector<unsigned char> transparent(static_cast<size_t>(width) * height * 4, 0);
+    SDL_UpdateTexture(texture, nullptr, transparent.data(), width * 4);
+
+    std::unique_ptr<Page> page(new Page());
+    page->texture = texture;
+    page->width = width;
+    page->height = height;
+    page->nodes.resize(static_cast<size_t>(width));
+    stbrp_init_target(&page->context, width, height, page->nodes.data(), width);
+
+    pages.push_back(std::move(page));
+    return true;
+}
+
+bool TextureAtlas::Pack(Page& page, const unsigned char* pixels, int width, int height, AtlasRegion& region) {
+    stbrp_rect rect = {};
+    rect.w = width + 2 * kPadding;
+    rect.h = height + 2 * kPadding;
+
+    if (!stbrp_pack_rects(&page.context, &rect, 1) || !rect.was_packed) {
+        return false;
+    }
+
+    // Copy the image into the middle of a padded buffer and repeat its edge pixels into the border
+    padded.resize(static_cast<size_t>(rect.w) * rect.h * 4);
+    for (int y = 0; y < rect.h; y++) {
+        int sourceY = std::min(std::max(y - kPadding, 0), height - 1);
+        for (int x = 0; x < rect.w; x++) {
+            int sourceX = std::min(std::max(x - kPadding, 0), width - 1);
+            memcpy(&padded[(static_cast<size_t>(y) * rect.w + x) * 4], pixels + (static_cast<size_t>(sourceY) * width + sourceX) * 4, 4);
+        }
+    }
+
+    SDL_Rect destination = {rect.x, rect.y, rect.w, rect.h};
+    if (SDL_UpdateTexture(page.texture, &destination, padded.data(), rect.w * 4) != 0) {
+        fprintf(stderr, "Failed to update atlas page: %s\n", SDL_GetError());
+        return false;
+    }
+
+    region.texture = page.texture;
+    region.uv0 = ImVec2(static_cast<float>(rect.x + kPadding) / page.width, static_cast<float>(rect.y + kPadding) / page.height);
+    region.uv1 = ImVec2(static_cast<float>(rect.x + kPadding + width) / page.width, static_cast<float>(rect.y + kPadding + height) / page.height);
+    region.rect.x = rect.x + kPadding;
+    region.rect.y = rect.y + kPadding;
+    region.rect.w = width;
+    region.rect.h = height;
+    return true;
+}
+
+bool TextureAtlas::Add(const unsigned char* pixels, int width, int height, AtlasRegion& region) {
+    if (renderer == nullptr || width <= 0 || height <= 0) {
+        return false;
+    }
+
+    for (const std::unique_ptr<Page>& page : pages) {
+        if (Pack(*page, pixels, width, height, region)) {
+            return true;
+        }
+    }
+
+    // Images bigger than a normal page get a page of their own
+    int pageWidth = std::max(pageSize, width + 2 * kPadding);
+    int pageHeight = std::max(pageSize, height + 2 * kPadding);
+    return AddPage(pageWidth, pageHeight) && Pack(*pages.back(), pixels, width, height, region);
+}
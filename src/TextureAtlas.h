@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+#include "SDL.h"
+#include "imgui.h"
+
+// Largest atlas page; smaller if the renderer can't do textures this big
+static const int kMaxAtlasPageSize = 2048;
+
+// Where one image ended up inside the atlas
+struct AtlasRegion {
+    SDL_Texture* texture = nullptr;
+    ImVec2 uv0 = ImVec2(0.0f, 0.0f);
+    ImVec2 uv1 = ImVec2(1.0f, 1.0f);
+    // The same area in page pixels, for SDL_RenderCopy
+    SDL_Rect rect = {0, 0, 0, 0};
+};
+
+// Packs tile and palette images into a few large SDL textures, so everything drawn from the atlas
+// shares a texture and ImGui can batch it into one draw call per page.
+//
+// Images are placed with imstb_rectpack's skyline packer, which is online: adding an image packs it
+// around the ones already placed without moving them, so regions handed out earlier stay valid.
+// When an image doesn't fit any page a new page is opened. Each image gets a 1 pixel border copied
+// from its edges so filtering never samples a neighbour.
+class TextureAtlas {
+public:
+    TextureAtlas();
+    ~TextureAtlas();
+    TextureAtlas(const TextureAtlas&) = delete;
+    TextureAtlas& operator=(const TextureAtlas&) = delete;
+
+    // Must be set before the first Add; pages are sized to what the renderer supports, up to kMaxAtlasPageSize
+    void SetRenderer(SDL_Renderer* renderer);
+
+    // Copies width x height RGBA pixels into the atlas
+    bool Add(const unsigned char* pixels, int width, int height, AtlasRegion& region);
+
+    // Destroys every page; must run while the renderer is still alive
+    void Clear();
+    // Destroys one page; regions on it must not be drawn again. Later images are packed into the remaining pages or new ones.
+    void RemovePage(SDL_Texture* texture);
+
+    int PageCount() const { return static_cast<int>(pages.size()); }
+    SDL_Texture* PageTexture(int page) const;
+    // Bytes of texture memory the pages take
+    size_t MemoryUsage() const;
+
+private:
+    struct Page;
+
+    bool AddPage(int width, int height);
+    bool Pack(Page& page, const unsigned char* pixels, int width, int height, AtlasRegion& region);
+
+    SDL_Renderer* renderer = nullptr;
+    int pageSize = kMaxAtlasPageSize;
+    std::vector<std::unique_ptr<Page>> pages;
+    std::vector<unsigned char> padded;
+};
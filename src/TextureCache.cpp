@@ -0,0 +1,377 @@
+#include "TextureCache.h"
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+#include "BufferedFileWriter.h"
+#include "ContentHash.h"
+
+// Size, hash and the fixed fields, up to the path
+static const size_t kRecordPrefixSize = 8;
+static const size_t kRecordFieldsSize = 50;
+static const size_t kRecordAlignment = 16;
+// Larger sides are taken for a damaged record rather than an image
+static const uint32_t kMaxCachedTextureSide = 16384;
+
+static uint16_t Load16(const unsigned char* p) {
+    return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+
+static uint32_t Load32(const unsigned char* p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+static uint64_t Load64(const unsigned char* p) {
+    return Load32(p) | (static_cast<uint64_t>(Load32(p + 4)) << 32);
+}
+
+static void Store16(unsigned char* p, uint16_t value) {
+    p[0] = static_cast<unsigned char>(value);
+    p[1] = static_cast<unsigned char>(value >> 8);
+}
+
+static void Store32(unsigned char* p, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        p[i] = static_cast<unsigned char>(value >> (8 * i));
+    }
+}
+
+static void Store64(unsigned char* p, uint64_t value) {
+    Store32(p, static_cast<uint32_t>(value));
+    Store32(p + 4, static_cast<uint32_t>(value >> 32));
+}
+
+static size_t Align(size_t offset) {
+    return (offset + kRecordAlignment - 1) & ~(kRecordAlignment - 1);
+}
+
+static uint32_t HashFields(const unsigned char* data, size_t size) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ data[i]) * 16777619u;
+    }
+
+    return hash;
+}
+
+// Nanoseconds, since a hot-reloaded file is often rewritten within a second at the same size
+static int64_t ModifiedTime(const struct stat& fileStat) {
+#ifdef __APPLE__
+    return static_cast<int64_t>(fileStat.st_mtimespec.tv_sec) * 1000000000 + fileStat.st_mtimespec.tv_nsec;
+#else
+    return static_cast<int64_t>(fileStat.st_mtim.tv_sec) * 1000000000 + fileStat.st_mtim.tv_nsec;
+#endif
+}
+
+static bool WriteAll(int fd, const unsigned char* data, size_t size) {
+    while (size > 0) {
+        ssize_t written = write(fd, data, size);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+
+        data += written;
+        size -= static_cast<size_t>(written);
+    }
+
+    return true;
+}
+
+TextureCache::~TextureCache() {
+    Close();
+}
+
+bool TextureCache::Open(const std::string& filePath, std::string& error) {
+    Close();
+    this->filePath = filePath;
+
+    size_t validSize = 0;
+    struct stat packStat;
+    if (stat(filePath.c_str(), &packStat) == 0 && packStat.st_size >= static_cast<off_t>(kTextureCacheHeaderSize)) {
+        if (!mapping.Open(filePath.c_str(), false, error)) {
+            return false;
+        }
+
+        if (memcmp(mapping.Data(), kTextureCacheMagic, sizeof(kTextureCacheMagic)) == 0 && Load32(mapping.Data() + 4) == kTextureCacheVersion) {
+            size_t liveBytes = 0;
+            validSize = Scan(liveBytes);
+
+            // Mostly replaced records; rewrite the pack with just the live ones
+            if ((validSize - kTextureCacheHeaderSize) / 2 > liveBytes) {
+                if (!Compact(filePath, error)) {
+                    return false;
+                }
+                validSize = Scan(liveBytes);
+            }
+        } else {
+            fprintf(stderr, "Ignoring %s: not a texture cache of this version\n", filePath.c_str());
+            mapping.Close();
+        }
+    }
+
+    if (validSize == 0) {
+        unsigned char header[kTextureCacheHeaderSize] = {};
+        memcpy(header, kTextureCacheMagic, sizeof(kTextureCacheMagic));
+        Store32(header + 4, kTextureCacheVersion);
+
+        // Readable as well, so appended records can be mapped
+        fd = open(filePath.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_APPEND, 0644);
+        if (fd != -1 && !WriteAll(fd, header, sizeof(header))) {
+            error = "Could not write " + filePath + ": " + strerror(errno);
+            Close();
+            return false;
+        }
+        validSize = kTextureCacheHeaderSize;
+    } else {
+        fd = open(filePath.c_str(), O_RDWR | O_APPEND);
+        // Cut off a torn record so new ones aren't appended after it, where Scan would never reach them
+        if (fd != -1 && validSize != mapping.Size() && ftruncate(fd, static_cast<off_t>(validSize)) != 0) {
+            error = "Could not truncate " + filePath + ": " + strerror(errno);
+            Close();
+            return false;
+        }
+    }
+
+    if (fd == -1) {
+        error = "Could not open " + filePath + ": " + strerror(errno);
+        Close();
+        return false;
+    }
+
+    fileSize = validSize;
+    return true;
+}
+
+void TextureCache::Close() {
+    for (const std::pair<void*, size_t>& appendedMapping : appendedMappings) {
+        munmap(appendedMapping.first, appendedMapping.second);
+    }
+    appendedMappings.clear();
+    appendedEntries.clear();
+
+    if (fd != -1) {
+        close(fd);
+        fd = -1;
+    }
+
+    entries.clear();
+    mapping.Close();
+    fileSize = 0;
+}
+
+size_t TextureCache::Scan(size_t& liveBytes) {
+    entries.clear();
+    std::unordered_map<std::string, size_t> recordSizes;
+
+    const unsigned char* data = mapping.Data();
+    size_t size = mapping.Size();
+    size_t offset = kTextureCacheHeaderSize;
+
+    while (size - offset >= kRecordPrefixSize + kRecordFieldsSize) {
+        const unsigned char* record = data + offset;
+        size_t recordSize = Load32(record);
+        const unsigned char* fields = record + kRecordPrefixSize;
+        if (recordSize < kRecordFieldsSize || recordSize > size - offset - kRecordPrefixSize) {
+            break;
+        }
+
+        size_t pathLength = Load16(fields + 48);
+        if (kRecordFieldsSize + pathLength > recordSize || HashFields(fields, kRecordFieldsSize + pathLength) != Load32(record + 4)) {
+            break;
+        }
+
+        uint32_t width = Load32(fields + 24);
+        uint32_t height = Load32(fields + 28);
+        size_t pixelOffset = Align(offset + kRecordPrefixSize + kRecordFieldsSize + pathLength);
+        size_t end = offset + kRecordPrefixSize + recordSize;
+        if (width == 0 || height == 0 || width > kMaxCachedTextureSide || height > kMaxCachedTextureSide ||
+            pixelOffset + static_cast<size_t>(width) * height * 4 > end || end != Align(end)) {
+            break;
+        }
+
+        std::string path(reinterpret_cast<const char*>(fields + kRecordFieldsSize), pathLength);
+        Entry& entry = entries[path];
+        entry.fileSize = Load64(fields);
+        entry.mtime = static_cast<int64_t>(Load64(fields + 8));
+        entry.contentHash = Load64(fields + 16);
+        entry.texture.pixels = data + pixelOffset;
+        entry.texture.width = static_cast<int>(width);
+        entry.texture.height = static_cast<int>(height);
+        entry.texture.channels = static_cast<int>(Load32(fields + 32));
+        entry.texture.averageColor = Load32(fields + 36);
+        entry.texture.pixelHash = Load64(fields + 40);
+        entry.recordOffset = offset;
+        entry.recordSize = kRecordPrefixSize + recordSize;
+
+        offset = end;
+    }
+
+    liveBytes = 0;
+    for (const auto& entry : entries) {
+        liveBytes += entry.second.recordSize;
+    }
+
+    return offset;
+}
+
+bool TextureCache::Compact(const std::string& filePath, std::string& error) {
+    std::string temporaryPath = filePath + ".tmp";
+    BufferedFileWriter writer;
+    if (!writer.Open(temporaryPath.c_str(), error)) {
+        return false;
+    }
+
+    // Records start aligned and end where the next one starts, so they stay aligned however they're packed
+    writer.Write(mapping.Data(), kTextureCacheHeaderSize);
+    for (const auto& entry : entries) {
+        writer.Write(mapping.Data() + entry.second.recordOffset, entry.second.recordSize);
+    }
+
+    if (!writer.Close(error)) {
+        unlink(temporaryPath.c_str());
+        return false;
+    }
+
+    if (rename(temporaryPath.c_str(), filePath.c_str()) != 0) {
+        error = "Could not replace " + filePath + ": " + strerror(errno);
+        unlink(temporaryPath.c_str());
+        return false;
+    }
+
+    entries.clear();
+    return mapping.Open(filePath.c_str(), false, error);
+}
+
+bool TextureCache::IsCurrent(const std::string& path, const Entry& entry) const {
+    struct stat fileStat;
+    if (stat(path.c_str(), &fileStat) != 0 || static_cast<uint64_t>(fileStat.st_size) != entry.fileSize) {
+        return false;
+    }
+
+    uint64_t contentHash;
+    return ModifiedTime(fileStat) == entry.mtime ||
+           (ContentHashFile(path.c_str(), contentHash) && contentHash == entry.contentHash);
+}
+
+bool TextureCache::Find(const std::string& path, CachedTexture& texture) const {
+    // A record appended this session is newer than any in the mapping
+    {
+        std::lock_guard<std::mutex> lock(appendedMutex);
+        if (appendedEntries.count(path) != 0) {
+            return FindAppended(path, texture);
+        }
+    }
+
+    std::unordered_map<std::string, Entry>::const_iterator entry = entries.find(path);
+    if (entry == entries.end() || !IsCurrent(path, entry->second)) {
+        return false;
+    }
+
+    texture = entry->second.texture;
+    return true;
+}
+
+// Called with appendedMutex held
+bool TextureCache::FindAppended(const std::string& path, CachedTexture& texture) const {
+    Entry& entry = appendedEntries[path];
+    if (!IsCurrent(path, entry)) {
+        return false;
+    }
+
+    if (entry.texture.pixels == nullptr) {
+        size_t pixelOffset = Align(entry.recordOffset + kRecordPrefixSize + kRecordFieldsSize + path.size());
+        size_t pixelBytes = static_cast<size_t>(entry.texture.width) * entry.texture.height * 4;
+        size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        size_t mapOffset = pixelOffset / pageSize * pageSize;
+        size_t mapSize = pixelOffset + pixelBytes - mapOffset;
+
+        void* mapped = mmap(nullptr, mapSize, PROT_READ, MAP_SHARED, fd, static_cast<off_t>(mapOffset));
+        if (mapped == MAP_FAILED) {
+            fprintf(stderr, "Could not map %s's record in %s: %s\n", path.c_str(), filePath.c_str(), strerror(errno));
+            return false;
+        }
+
+        appendedMappings.push_back(std::make_pair(mapped, mapSize));
+        entry.texture.pixels = static_cast<const unsigned char*>(mapped) + (pixelOffset - mapOffset);
+    }
+
+    texture = entry.texture;
+    return true;
+}
+
+bool TextureCache::Add(const std::string& path, const unsigned char* pixels, int width, int height, int channels, uint32_t averageColor, uint64_t pixelHash, std::string& error) {
+    if (!IsOpen()) {
+        error = "The texture cache isn't open";
+        return false;
+    }
+
+    if (width <= 0 || height <= 0 || width > static_cast<int>(kMaxCachedTextureSide) || height > static_cast<int>(kMaxCachedTextureSide) || path.size() > 0xffff) {
+        error = "Can't cache " + path;
+        return false;
+    }
+
+    struct stat fileStat;
+    uint64_t contentHash;
+    if (stat(path.c_str(), &fileStat) != 0 || !ContentHashFile(path.c_str(), contentHash)) {
+        error = "Could not read " + path + ": " + strerror(errno);
+        return false;
+    }
+
+    size_t pixelBytes = static_cast<size_t>(width) * height * 4;
+    size_t pixelOffset = Align(kRecordPrefixSize + kRecordFieldsSize + path.size());
+    std::vector<unsigned char> record(Align(pixelOffset + pixelBytes), 0);
+
+    unsigned char* fields = record.data() + kRecordPrefixSize;
+    Store64(fields, static_cast<uint64_t>(fileStat.st_size));
+    Store64(fields + 8, static_cast<uint64_t>(ModifiedTime(fileStat)));
+    Store64(fields + 16, contentHash);
+    Store32(fields + 24, static_cast<uint32_t>(width));
+    Store32(fields + 28, static_cast<uint32_t>(height));
+    Store32(fields + 32, static_cast<uint32_t>(channels));
+    Store32(fields + 36, averageColor);
+    Store64(fields + 40, pixelHash);
+    Store16(fields + 48, static_cast<uint16_t>(path.size()));
+    memcpy(fields + kRecordFieldsSize, path.data(), path.size());
+    memcpy(record.data() + pixelOffset, pixels, pixelBytes);
+
+    Store32(record.data(), static_cast<uint32_t>(record.size() - kRecordPrefixSize));
+    Store32(record.data() + 4, HashFields(fields, kRecordFieldsSize + path.size()));
+
+    Entry entry;
+    entry.fileSize = static_cast<uint64_t>(fileStat.st_size);
+    entry.mtime = ModifiedTime(fileStat);
+    entry.contentHash = contentHash;
+    entry.texture.pixels = nullptr;
+    entry.texture.width = width;
+    entry.texture.height = height;
+    entry.texture.channels = channels;
+    entry.texture.averageColor = averageColor;
+    entry.texture.pixelHash = pixelHash;
+    entry.recordSize = record.size();
+
+    {
+        std::lock_guard<std::mutex> lock(appendMutex);
+        if (!WriteAll(fd, record.data(), record.size())) {
+            error = "Could not write " + filePath + ": " + strerror(errno);
+            // Drop the partial record so the next one starts where fileSize says
+            if (ftruncate(fd, static_cast<off_t>(fileSize.load())) != 0) {
+                fprintf(stderr, "Could not truncate %s: %s\n", filePath.c_str(), strerror(errno));
+            }
+            return false;
+        }
+
+        entry.recordOffset = static_cast<size_t>(fileSize.load());
+        fileSize += record.size();
+    }
+
+    std::lock_guard<std::mutex> lock(appendedMutex);
+    appendedEntries[path] = entry;
+    return true;
+}
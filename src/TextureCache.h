@@ -0,0 +1,100 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "MappedFile.h"
+
+// Decoded images from earlier runs, so reopening a sprite pack skips decoding its PNGs.
+//
+// Everything is in one append-only pack file that is mapped whole when opened. Images come
+// straight out of the mapping, with the pixels aligned to 16 bytes, so a hit costs a stat of the
+// source file and nothing is copied before the upload.
+//
+// File layout (little-endian):
+//   header: "MFTC", uint32 version, 8 bytes of padding
+//   records, each starting 16-byte aligned:
+//     uint32 record size from the next field on, uint32 FNV-1a hash of the fields up to the path
+//     uint64 source file size, int64 source file mtime in ns, uint64 ContentHash64 of the source file
+//     uint32 width, uint32 height, uint32 channels in the source file, uint32 average colour
+//     uint64 caller's hash of the pixels, uint16 path length, path bytes, zero padding to 16 bytes,
+//     width * height RGBA8 pixels
+//
+// A record is a hit when its source file still has the same size and mtime, or when it has the
+// same size and content hash after all, as when a pack was copied or checked out again. A later
+// record for a path replaces an earlier one. A record cut short by a crash is cut off when the
+// pack is next opened, and a pack where more than half the bytes are replaced records is rewritten.
+//
+// Records appended while the pack is open are found too. They aren't in the mapping, so the pixels of
+// one are mapped on their own the first time it's hit, which only happens when an image is decoded
+// again in the same session, as after its atlas page was evicted.
+static const char kTextureCacheMagic[4] = {'M', 'F', 'T', 'C'};
+static const uint32_t kTextureCacheVersion = 2;
+static const size_t kTextureCacheHeaderSize = 16;
+
+struct CachedTexture {
+    // Inside the cache's mapping; valid until the cache is closed
+    const unsigned char* pixels;
+    int width;
+    int height;
+    int channels;
+    uint32_t averageColor;
+    // Whatever hash of the pixels was passed to Add, so a hit doesn't have to read them to dedupe
+    uint64_t pixelHash;
+};
+
+class TextureCache {
+public:
+    TextureCache() = default;
+    ~TextureCache();
+    TextureCache(const TextureCache&) = delete;
+    TextureCache& operator=(const TextureCache&) = delete;
+
+    // Opens the pack at filePath, creating it if it doesn't exist
+    bool Open(const std::string& filePath, std::string& error);
+    void Close();
+    bool IsOpen() const { return fd != -1; }
+
+    // Both are safe to call from several threads at once
+    bool Find(const std::string& path, CachedTexture& texture) const;
+    bool Add(const std::string& path, const unsigned char* pixels, int width, int height, int channels, uint32_t averageColor, uint64_t pixelHash, std::string& error);
+
+    size_t EntryCount() const { return entries.size(); }
+    // Bytes of the pack, counting records appended since it was opened
+    uint64_t FileSize() const { return fileSize.load(); }
+
+private:
+    struct Entry {
+        uint64_t fileSize;
+        int64_t mtime;
+        uint64_t contentHash;
+        CachedTexture texture;
+        // The whole record, for compaction
+        size_t recordOffset;
+        size_t recordSize;
+    };
+
+    // Indexes the mapped records; returns where the last complete one ends
+    size_t Scan(size_t& liveBytes);
+    // Whether the file at path is still the one entry was made from
+    bool IsCurrent(const std::string& path, const Entry& entry) const;
+    bool FindAppended(const std::string& path, CachedTexture& texture) const;
+    bool Compact(const std::string& filePath, std::string& error);
+
+    std::string filePath;
+    MappedFile mapping;
+    std::unordered_map<std::string, Entry> entries;
+    int fd = -1;
+    std::atomic<uint64_t> fileSize{0};
+    std::mutex appendMutex;
+    // Records appended since the pack was opened; their pixels are null until first mapped
+    mutable std::unordered_map<std::string, Entry> appendedEntries;
+    // Each mapped appended record's pixels, by address and length
+    mutable std::vector<std::pair<void*, size_t>> appendedMappings;
+    mutable std::mutex appendedMutex;
+};
@@ -0,0 +1,179 @@
+#include "TextureDecoder.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include "ContentHash.h"
+#include "stb_image.h"
+
+void StbiDeleter::operator()(unsigned char* pixels) const {
+    stbi_image_free(pixels);
+}
+
+static uint64_t HashPixels(const DecodedTexture& texture) {
+    // Images of different sizes never match, even if their pixel bytes do
+    uint64_t seed = static_cast<uint64_t>(texture.width) << 32 | static_cast<uint32_t>(texture.height);
+    return ContentHash64(texture.pixels, static_cast<size_t>(texture.width) * texture.height * 4, seed);
+}
+
+bool DecodeTexture(DecodedTexture& texture) {
+    // Always decode to RGBA, the atlas pages' format, whatever the file stores
+    unsigned char* data = stbi_load(texture.path.c_str(), &texture.width, &texture.height, &texture.channels, 4);
+    if (data == nullptr) {
+        texture.error = stbi_failure_reason();
+        return false;
+    }
+    texture.decodedPixels.reset(data);
+    texture.pixels = data;
+
+    size_t pixelCount = static_cast<size_t>(texture.width) * texture.height;
+    if (pixelCount > 0) {
+        uint64_t sums[4] = {0, 0, 0, 0};
+        for (size_t i = 0; i < pixelCount * 4; i++) {
+            sums[i % 4] += data[i];
+        }
+        texture.averageColor = IM_COL32(sums[0] / pixelCount, sums[1] / pixelCount, sums[2] / pixelCount, sums[3] / pixelCount);
+    }
+    texture.contentHash = HashPixels(texture);
+
+    return true;
+}
+
+bool DecodeTexture(DecodedTexture& texture, TextureCache& cache) {
+    CachedTexture cached;
+    if (cache.Find(texture.path, cached)) {
+        texture.pixels = cached.pixels;
+        texture.width = cached.width;
+        texture.height = cached.height;
+        texture.channels = cached.channels;
+        texture.averageColor = cached.averageColor;
+        texture.contentHash = cached.pixelHash;
+        return true;
+    }
+
+    if (!DecodeTexture(texture)) {
+        return false;
+    }
+
+    // Not being able to cache an image doesn't stop it from being used
+    std::string error;
+    if (!cache.Add(texture.path, texture.pixels, texture.width, texture.height, texture.channels, texture.averageColor, texture.contentHash, error)) {
+        fprintf(stderr, "Error caching %s: %s\n", texture.path.c_str(), error.c_str());
+    }
+    return true;
+}
+
+TextureDecoder::TextureDecoder(unsigned threadCount) : threadCount(threadCount) {
+    if (this->threadCount == 0) {
+        unsigned cores = std::thread::hardware_concurrency();
+        this->threadCount = std::max(1u, cores > 1 ? cores - 1 : 1u);
+    }
+}
+
+TextureDecoder::~TextureDecoder() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    workAvailable.notify_all();
+
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+void TextureDecoder::Enqueue(const std::vector<std::string>& paths) {
+    if (paths.empty()) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (slots.empty()) {
+            batchStart = firstSlot;
+        }
+
+        for (const std::string& path : paths) {
+            slots.emplace_back();
+            slots.back().texture.path = path;
+        }
+    }
+    workAvailable.notify_all();
+
+    // Started on first use, so an editor that never imports anything runs no extra threads
+    while (workers.size() < threadCount) {
+        workers.emplace_back(&TextureDecoder::Work, this);
+    }
+}
+
+void TextureDecoder::Work() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        workAvailable.wait(lock, [this]() {
+            return stopping || (nextToDecode < firstSlot + slots.size() && nextToDecode - firstSlot < kMaxWaitingDecodedTextures);
+        });
+        if (stopping) {
+            return;
+        }
+
+        size_t index = nextToDecode++;
+        // Slots aren't popped until decoded, and a deque keeps references to its other elements valid
+        Slot& slot = slots[index - firstSlot];
+        lock.unlock();
+
+        if (cache != nullptr) {
+            DecodeTexture(slot.texture, *cache);
+        } else {
+            DecodeTexture(slot.texture);
+        }
+
+        lock.lock();
+        slot.decoded = true;
+        slotDecoded.notify_all();
+    }
+}
+
+void TextureDecoder::PopFront(DecodedTexture& texture) {
+    texture = std::move(slots.front().texture);
+    slots.pop_front();
+    firstSlot++;
+    // A slot freed up under the waiting limit
+    workAvailable.notify_one();
+}
+
+bool TextureDecoder::TakeNext(DecodedTexture& texture) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (slots.empty() || !slots.front().decoded) {
+        return false;
+    }
+
+    PopFront(texture);
+    return true;
+}
+
+bool TextureDecoder::WaitNext(DecodedTexture& texture) {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (slots.empty()) {
+        return false;
+    }
+
+    slotDecoded.wait(lock, [this]() {
+        return slots.front().decoded;
+    });
+    PopFront(texture);
+    return true;
+}
+
+bool TextureDecoder::IsBusy() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return !slots.empty();
+}
+
+size_t TextureDecoder::BatchTaken() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return firstSlot - batchStart;
+}
+
+size_t TextureDecoder::BatchSize() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return firstSlot + slots.size() - batchStart;
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "imgui.h"
+#include "TextureCache.h"
+
+// Decoded images allowed to wait for upload before the workers pause, which bounds the memory an
+// import holds when decoding outruns uploading
+static const size_t kMaxWaitingDecodedTextures = 256;
+
+struct StbiDeleter {
+    void operator()(unsigned char* pixels) const;
+};
+
+// An image file decoded to RGBA, ready to go into the texture atlas
+struct DecodedTexture {
+    std::string path;
+    // RGBA pixels, null if the file couldn't be decoded, and error says why. Either decodedPixels or
+    // inside the texture cache's mapping.
+    const unsigned char* pixels = nullptr;
+    std::unique_ptr<unsigned char, StbiDeleter> decodedPixels;
+    int width = 0;
+    int height = 0;
+    int channels = 0;
+    // Mean of the pixels, for the map overview
+    ImU32 averageColor = IM_COL32_WHITE;
+    // ContentHash64 of the pixels, seeded with the size, so identical images can share atlas space
+    uint64_t contentHash = 0;
+    std::string error;
+};
+
+// Decodes texture.path on the calling thread
+bool DecodeTexture(DecodedTexture& texture);
+// Takes texture.path from the cache if it's there and still current, otherwise decodes it and adds it to the cache
+bool DecodeTexture(DecodedTexture& texture, TextureCache& cache);
+
+// Decodes image files on a pool of worker threads.
+//
+// Decoding is the slow part of opening a sprite pack and needs nothing from SDL, so the workers do
+// it while the main thread keeps drawing and picks up finished images a few at a time for upload.
+// Images come back in the order their paths were queued, whichever worker finishes first, so the
+// palette's order doesn't depend on thread timing. With a TextureCache set, the workers check it
+// before decoding and add what they decode to it.
+class TextureDecoder {
+public:
+    // threadCount 0 means one per core, less one for the main thread
+    explicit TextureDecoder(unsigned threadCount = 0);
+    ~TextureDecoder();
+    TextureDecoder(const TextureDecoder&) = delete;
+    TextureDecoder& operator=(const TextureDecoder&) = delete;
+
+    // Must be open, and set before the first Enqueue
+    void SetCache(TextureCache* cache) { this->cache = cache; }
+    void Enqueue(const std::vector<std::string>& paths);
+
+    // Moves out the next image in queue order if it's finished; never blocks
+    bool TakeNext(DecodedTexture& texture);
+    // Blocks until the next image is finished; false if nothing is queued
+    bool WaitNext(DecodedTexture& texture);
+
+    bool IsBusy() const;
+    // Images taken and images queued since the decoder was last idle, for a progress bar
+    size_t BatchTaken() const;
+    size_t BatchSize() const;
+
+private:
+    struct Slot {
+        DecodedTexture texture;
+        bool decoded = false;
+    };
+
+    void Work();
+    // With the lock held
+    void PopFront(DecodedTexture& texture);
+
+    unsigned threadCount;
+    TextureCache* cache = nullptr;
+    std::vector<std::thread> workers;
+    mutable std::mutex mutex;
+    std::condition_variable workAvailable;
+    std::condition_variable slotDecoded;
+    // Queued images from the oldest not yet taken; slots[0] is image number firstSlot
+    std::deque<Slot> slots;
+    size_t firstSlot = 0;
+    size_t nextToDecode = 0;
+    size_t batchStart = 0;
+    bool stopping = false;
+};
@@ -0,0 +1,363 @@
+#include "TextureFolderWatcher.h"
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <dirent.h>
+#include <set>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#endif
+
+// Marks a file to be reported as changed by the next scan whatever its size and time say
+static const uint64_t kUnknownFileSize = UINT64_MAX;
+static const size_t kInotifyBufferSize = 64 * 1024;
+
+bool IsTextureFile(const std::string& path) {
+    // What stb_image decodes, less the formats nobody draws sprites in
+    static const char* const kExtensions[] = {".png", ".bmp", ".tga", ".jpg", ".jpeg"};
+
+    std::string lowered(path);
+    std::transform(lowered.begin(), lowered.end(), lowered.begin(), [](char c) {
+        return static_cast<char>(tolower(static_cast<unsigned char>(c)));
+    });
+
+    for (const char* extension : kExtensions) {
+        size_t length = strlen(extension);
+        if (lowered.size() > length && lowered.compare(lowered.size() - length, length, extension) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static int64_t ModifiedTime(const struct stat& fileStat) {
+#ifdef __APPLE__
+    return static_cast<int64_t>(fileStat.st_mtimespec.tv_sec) * 1000000000 + fileStat.st_mtimespec.tv_nsec;
+#else
+    return static_cast<int64_t>(fileStat.st_mtim.tv_sec) * 1000000000 + fileStat.st_mtim.tv_nsec;
+#endif
+}
+
+TextureFolderWatcher::~TextureFolderWatcher() {
+    Close();
+}
+
+bool TextureFolderWatcher::Open(const std::string& folder, std::vector<std::string>& paths, std::string& error) {
+    Close();
+
+    struct stat folderStat;
+    if (stat(folder.c_str(), &folderStat) != 0) {
+        error = "Could not open " + folder + ": " + strerror(errno);
+        return false;
+    }
+    if (!S_ISDIR(folderStat.st_mode)) {
+        error = folder + " is not a folder";
+        return false;
+    }
+
+    root = folder;
+    while (root.size() > 1 && root.back() == '/') {
+        root.pop_back();
+    }
+
+#ifdef __linux__
+    inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotifyFd == -1) {
+        fprintf(stderr, "Rescanning %s for changes, inotify is unavailable: %s\n", root.c_str(), strerror(errno));
+    } else {
+        eventBuffer.resize(kInotifyBufferSize);
+        WatchDirectory(root);
+    }
+#endif
+
+    std::vector<std::string> changed;
+    Scan(root, true, paths, changed);
+    lastScan = std::chrono::steady_clock::now();
+    StartWakeThread();
+    return true;
+}
+
+void TextureFolderWatcher::Close() {
+    StopWakeThread();
+    if (inotifyFd != -1) {
+        close(inotifyFd);
+        inotifyFd = -1;
+    }
+    watchedDirectories.clear();
+    files.clear();
+    root.clear();
+}
+
+void TextureFolderWatcher::Poll(std::vector<std::string>& added, std::vector<std::string>& changed) {
+    if (!IsOpen()) {
+        return;
+    }
+
+    if (inotifyFd != -1) {
+        ReadEvents(added, changed);
+        {
+            std::lock_guard<std::mutex> lock(wakeMutex);
+            wakePending = false;
+        }
+        wakeCondition.notify_one();
+        return;
+    }
+
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    if (now - lastScan >= std::chrono::milliseconds(kTextureFolderPollIntervalMs)) {
+        Rescan(root, true, added, changed);
+        lastScan = now;
+    }
+}
+
+void TextureFolderWatcher::Rescan(const std::string& directory, bool recursive, std::vector<std::string>& added, std::vector<std::string>& changed) {
+    // The files under directory sort together, so they're one run of the map
+    std::string prefix = directory + "/";
+    std::map<std::string, FileState>::iterator begin = files.lower_bound(prefix);
+    std::map<std::string, FileState>::iterator end = begin;
+    for (; end != files.end() && end->first.compare(0, prefix.size(), prefix) == 0; ++end) {
+        end->second.seen = false;
+    }
+
+    Scan(directory, recursive, added, changed);
+
+    // Files in subdirectories that weren't scanned are neither seen nor gone
+    for (std::map<std::string, FileState>::iterator file = begin; file != end;) {
+        bool inScope = recursive || file->first.find('/', prefix.size()) == std::string::npos;
+        if (inScope && !file->second.seen) {
+            file = files.erase(file);
+        } else {
+            ++file;
+        }
+    }
+}
+
+void TextureFolderWatcher::Scan(const std::string& directory, bool recursive, std::vector<std::string>& added, std::vector<std::string>& changed) {
+    DIR* handle = opendir(directory.c_str());
+    if (handle == nullptr) {
+        // A directory deleted since its event was queued
+        return;
+    }
+
+    std::vector<std::string> names;
+    while (dirent* entry = readdir(handle)) {
+        if (entry->d_name[0] != '.') {
+            names.push_back(entry->d_name);
+        }
+    }
+    closedir(handle);
+    std::sort(names.begin(), names.end());
+
+    for (const std::string& name : names) {
+        std::string path = directory + "/" + name;
+        struct stat fileStat;
+        if (lstat(path.c_str(), &fileStat) != 0) {
+            continue;
+        }
+
+        // Symlinked images are loaded, but symlinked directories aren't followed: one pointing at an
+        // ancestor would otherwise be walked until the path got too long, finding the same images
+        // under ever longer paths
+        if (S_ISLNK(fileStat.st_mode) && (stat(path.c_str(), &fileStat) != 0 || S_ISDIR(fileStat.st_mode))) {
+            continue;
+        }
+
+        if (S_ISDIR(fileStat.st_mode)) {
+            if (recursive) {
+                WatchDirectory(path);
+                Scan(path, true, added, changed);
+            }
+            continue;
+        }
+
+        if (!S_ISREG(fileStat.st_mode) || !IsTextureFile(name)) {
+            continue;
+        }
+
+        uint64_t size = static_cast<uint64_t>(fileStat.st_size);
+        int64_t modifiedTime = ModifiedTime(fileStat);
+        std::map<std::string, FileState>::iterator file = files.find(path);
+        if (file == files.end()) {
+            FileState state = {size, modifiedTime, true};
+            files.insert(std::make_pair(path, state));
+            added.push_back(path);
+        } else {
+            if (file->second.size != size || file->second.modifiedTime != modifiedTime) {
+                file->second.size = size;
+                file->second.modifiedTime = modifiedTime;
+                changed.push_back(path);
+            }
+            file->second.seen = true;
+        }
+    }
+}
+
+void TextureFolderWatcher::WatchDirectory(const std::string& directory) {
+#ifdef __linux__
+    if (inotifyFd == -1) {
+        return;
+    }
+
+    // Files are only looked at once they're closed after writing, so half-written images aren't loaded
+    uint32_t mask = IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_CREATE | IN_DELETE | IN_ONLYDIR;
+    int watch = inotify_add_watch(inotifyFd, directory.c_str(), mask);
+    if (watch == -1) {
+        // Most likely the per-user watch limit, fs.inotify.max_user_watches
+        StopInotify(strerror(errno));
+        return;
+    }
+    watchedDirectories[watch] = directory;
+#else
+    (void)directory;
+#endif
+}
+
+void TextureFolderWatcher::StopInotify(const char* reason) {
+    fprintf(stderr, "Rescanning %s for changes, it can't be watched: %s\n", root.c_str(), reason);
+    StopWakeThread();
+    close(inotifyFd);
+    inotifyFd = -1;
+    watchedDirectories.clear();
+}
+
+void TextureFolderWatcher::ReadEvents(std::vector<std::string>& added, std::vector<std::string>& changed) {
+#ifdef __linux__
+    std::set<std::string> directories;
+    std::set<std::string> trees;
+    bool overflowed = false;
+
+    while (true) {
+        ssize_t length = read(inotifyFd, eventBuffer.data(), eventBuffer.size());
+        if (length <= 0) {
+            break;
+        }
+
+        for (ssize_t offset = 0; offset < length;) {
+            const inotify_event* event = reinterpret_cast<const inotify_event*>(eventBuffer.data() + offset);
+            offset += static_cast<ssize_t>(sizeof(inotify_event) + event->len);
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                overflowed = true;
+                continue;
+            }
+
+            std::map<int, std::string>::iterator watched = watchedDirectories.find(event->wd);
+            if (watched == watchedDirectories.end()) {
+                continue;
+            }
+            if (event->mask & IN_IGNORED) {
+                watchedDirectories.erase(watched);
+                continue;
+            }
+            if (event->len == 0) {
+                continue;
+            }
+
+            std::string path = watched->second + "/" + event->name;
+            if (event->mask & IN_ISDIR) {
+                // A new directory may have been filled before its watch was added, so it's scanned whole
+                trees.insert(path);
+            } else if (!(event->mask & IN_CREATE)) {
+                directories.insert(watched->second);
+                // Rewritten in place, possibly with the same size within the clock's resolution
+                std::map<std::string, FileState>::iterator file = files.find(path);
+                if (file != files.end() && (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO))) {
+                    file->second.size = kUnknownFileSize;
+                }
+            }
+        }
+    }
+
+    if (overflowed) {
+        // Events were lost; only a full rescan knows what changed
+        Rescan(root, true, added, changed);
+        return;
+    }
+
+    for (const std::string& tree : trees) {
+        Rescan(tree, true, added, changed);
+    }
+    for (const std::string& directory : directories) {
+        Rescan(directory, false, added, changed);
+    }
+#else
+    (void)added;
+    (void)changed;
+#endif
+}
+
+void TextureFolderWatcher::StartWakeThread() {
+#ifdef __linux__
+    if (!wakeCallback || inotifyFd == -1) {
+        return;
+    }
+
+    if (pipe2(stopPipe, O_CLOEXEC) != 0) {
+        StopInotify(strerror(errno));
+        return;
+    }
+
+    wakePending = false;
+    stopping = false;
+    wakeThread = std::thread(&TextureFolderWatcher::WaitForEvents, this);
+#endif
+}
+
+void TextureFolderWatcher::StopWakeThread() {
+    if (!wakeThread.joinable()) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        stopping = true;
+    }
+    wakeCondition.notify_one();
+    char byte = 0;
+    if (write(stopPipe[1], &byte, 1) != 1) {
+        fprintf(stderr, "Could not stop watching %s: %s\n", root.c_str(), strerror(errno));
+    }
+    wakeThread.join();
+
+    close(stopPipe[0]);
+    close(stopPipe[1]);
+    stopPipe[0] = -1;
+    stopPipe[1] = -1;
+}
+
+void TextureFolderWatcher::WaitForEvents() {
+#ifdef __linux__
+    pollfd descriptors[2] = {{inotifyFd, POLLIN, 0}, {stopPipe[0], POLLIN, 0}};
+    while (true) {
+        if (poll(descriptors, 2, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return;
+        }
+
+        if (descriptors[1].revents != 0 || !(descriptors[0].revents & POLLIN)) {
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(wakeMutex);
+            wakePending = true;
+        }
+        wakeCallback();
+
+        // The events stay readable until Poll reads them, so poll() would return straight away
+        std::unique_lock<std::mutex> lock(wakeMutex);
+        wakeCondition.wait(lock, [this]() { return !wakePending || stopping; });
+        if (stopping) {
+            return;
+        }
+    }
+#endif
+}
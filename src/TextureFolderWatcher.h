@@ -0,0 +1,95 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// How often the folder is rescanned where inotify isn't available
+static const int kTextureFolderPollIntervalMs = 1000;
+
+// Image files the editor can load as textures, by extension
+bool IsTextureFile(const std::string& path);
+
+// Lists the images under a folder and reports the ones that are added or changed afterwards.
+//
+// Open walks the folder recursively, following symlinks to images but not to directories. On Linux
+// it then puts an inotify watch on every directory and Poll only rescans the directories that had
+// events, so a change costs a readdir of one directory however big the folder is. Files are picked
+// up when they're closed after writing or moved in, not while they're still being written.
+// Elsewhere, or if inotify can't be set up, Poll rescans the whole folder every
+// kTextureFolderPollIntervalMs. Either way a file counts as changed when its size or modification
+// time differ from the last scan.
+//
+// Poll never blocks, so the main loop can call it every frame. A main loop that sleeps until its next
+// event sets a wake callback: with inotify, a thread of the watcher's own waits on the inotify
+// descriptor and calls it once events arrive, then waits for Poll to read them before watching again.
+// Only when rescanning does the loop have to wake on a timer. Removed files are forgotten without
+// being reported; the textures loaded from them stay as they are.
+class TextureFolderWatcher {
+public:
+    TextureFolderWatcher() = default;
+    ~TextureFolderWatcher();
+    TextureFolderWatcher(const TextureFolderWatcher&) = delete;
+    TextureFolderWatcher& operator=(const TextureFolderWatcher&) = delete;
+
+    // Stops watching any earlier folder and appends the images under folder to paths, sorted by name within each directory
+    bool Open(const std::string& folder, std::vector<std::string>& paths, std::string& error);
+    void Close();
+    bool IsOpen() const { return !root.empty(); }
+    const std::string& Folder() const { return root; }
+    // Whether changes come from inotify rather than rescans
+    bool IsUsingInotify() const { return inotifyFd != -1; }
+    // Called from the watcher's thread when there are inotify events for Poll; set before Open
+    void SetWakeCallback(std::function<void()> callback) { wakeCallback = callback; }
+    // Whether the wake callback reports changes, so Poll doesn't need calling on a timer
+    bool WakesOnChange() const { return wakeThread.joinable(); }
+
+    // Appends images added since Open or the last Poll to added and images rewritten since to changed
+    void Poll(std::vector<std::string>& added, std::vector<std::string>& changed);
+
+private:
+    struct FileState {
+        uint64_t size;
+        // Nanoseconds, since a file rewritten within a second often keeps its size
+        int64_t modifiedTime;
+        // Found by the scan in progress
+        bool seen;
+    };
+
+    // Brings files up to date with the images in directory, and in its subdirectories too if
+    // recursive, appending the ones that are new or differ from what files held
+    void Rescan(const std::string& directory, bool recursive, std::vector<std::string>& added, std::vector<std::string>& changed);
+    void Scan(const std::string& directory, bool recursive, std::vector<std::string>& added, std::vector<std::string>& changed);
+    void WatchDirectory(const std::string& directory);
+    // Switches to rescanning after inotify failed
+    void StopInotify(const char* reason);
+    void ReadEvents(std::vector<std::string>& added, std::vector<std::string>& changed);
+    void StartWakeThread();
+    void StopWakeThread();
+    void WaitForEvents();
+
+    std::string root;
+    std::map<std::string, FileState> files;
+    std::chrono::steady_clock::time_point lastScan;
+
+    int inotifyFd = -1;
+    // Directory each inotify watch descriptor is on
+    std::map<int, std::string> watchedDirectories;
+    std::vector<char> eventBuffer;
+
+    std::function<void()> wakeCallback;
+    std::thread wakeThread;
+    // Written to stop the wake thread's poll()
+    int stopPipe[2] = {-1, -1};
+    std::mutex wakeMutex;
+    std::condition_variable wakeCondition;
+    // The callback ran and Poll hasn't read the events yet
+    bool wakePending = false;
+    bool stopping = false;
+};
@@ -0,0 +1,128 @@
+#include "TexturePalette.h"
+#include <algorithm>
+
+static const ImU32 kSelectedTileBorderColor = IM_COL32(255, 200, 0, 255);
+
+void TexturePalette::AddUnassigned(const Texture& texture) {
+    unassigned.push_back(texture);
+    dirty = true;
+}
+
+void TexturePalette::RemoveUnassigned(size_t index) {
+    if (index >= unassigned.size()) {
+        return;
+    }
+
+    if (index != unassigned.size() - 1) {
+        std::swap(unassigned[index], unassigned.back());
+    }
+    unassigned.pop_back();
+    dirty = true;
+}
+
+void TexturePalette::ClearUnassigned() {
+    unassigned.clear();
+    dirty = true;
+}
+
+void TexturePalette::Refilter(const TextureRegistry& registry) {
+    filteredAssigned.clear();
+    for (int id = 0; id < registry.IdLimit(); id++) {
+        if (registry.IsAssigned(static_cast<short>(id)) && filter.PassFilter(registry.Get(static_cast<short>(id)).name.c_str())) {
+            filteredAssigned.push_back(id);
+        }
+    }
+
+    filteredUnassigned.clear();
+    for (size_t i = 0; i < unassigned.size(); i++) {
+        if (filter.PassFilter(unassigned[i].name.c_str())) {
+            filteredUnassigned.push_back(static_cast<int>(i));
+        }
+    }
+
+    dirty = false;
+    registryRevision = registry.Revision();
+}
+
+bool TexturePalette::Draw(const TextureRegistry& registry, TextureStreamer& streamer, float tileSize, short currentTile, PaletteClick& click) {
+    if (filter.Draw("Filter")) {
+        dirty = true;
+    }
+
+    if (dirty || registry.Revision() != registryRevision) {
+        Refilter(registry);
+    }
+
+    bool clicked = false;
+
+    ImGui::Text("Assigned textures (%d)", static_cast<int>(filteredAssigned.size()));
+    clicked |= DrawGrid("assigned", filteredAssigned, true, registry, streamer, tileSize, currentTile, click);
+
+    if (!unassigned.empty()) {
+        ImGui::NewLine();
+        ImGui::Text("Unassigned textures (%d)", static_cast<int>(filteredUnassigned.size()));
+        clicked |= DrawGrid("unassigned", filteredUnassigned, false, registry, streamer, tileSize, currentTile, click);
+    }
+
+    return clicked;
+}
+
+bool TexturePalette::DrawGrid(const char* label, const std::vector<int>& items, bool assigned, const TextureRegistry& registry, TextureStreamer& streamer, float tileSize, short currentTile, PaletteClick& click) {
+    if (items.empty()) {
+        return false;
+    }
+
+    const ImGuiStyle& style = ImGui::GetStyle();
+    float cellWidth = tileSize + style.ItemSpacing.x;
+    int columns = std::max(1, static_cast<int>((ImGui::GetContentRegionAvail().x + style.ItemSpacing.x) / cellWidth));
+    int rows = (static_cast<int>(items.size()) + columns - 1) / columns;
+    bool clicked = false;
+
+    ImGui::PushID(label);
+    ImGuiListClipper clipper;
+    clipper.Begin(rows, tileSize + style.ItemSpacing.y);
+    while (clipper.Step()) {
+        for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; row++) {
+            for (int column = 0; column < columns; column++) {
+                size_t index = static_cast<size_t>(row) * columns + column;
+                if (index >= items.size()) {
+                    break;
+                }
+
+                int item = items[index];
+                const Texture& texture = assigned ? registry.Get(static_cast<short>(item)) : unassigned[static_cast<size_t>(item)];
+                // Copies of a texture don't see it being loaded, so its region comes from the streamer
+                streamer.MarkVisible(texture.streamIndex);
+                const AtlasRegion& region = texture.streamIndex >= 0 ? streamer.Region(texture.streamIndex) : texture.atlasRegion;
+
+                if (column > 0) {
+                    ImGui::SameLine();
+                }
+
+                ImGui::PushID(item);
+                ImGui::Image(region.texture, ImVec2(tileSize, tileSize), region.uv0, region.uv1);
+                if (ImGui::IsItemHovered()) {
+                    if (assigned) {
+                        ImGui::SetTooltip("%d: %s", item, texture.name.c_str());
+                    } else {
+                        ImGui::SetTooltip("%s", texture.name.c_str());
+                    }
+                }
+                if (assigned && item == currentTile) {
+                    ImGui::GetWindowDrawList()->AddRect(ImGui::GetItemRectMin(), ImGui::GetItemRectMax(), kSelectedTileBorderColor, 0.0f, 0, 2.0f);
+                }
+                if (ImGui::IsItemClicked()) {
+                    click.assigned = assigned;
+                    click.id = assigned ? static_cast<short>(item) : -1;
+                    click.unassignedIndex = assigned ? 0 : static_cast<size_t>(item);
+                    clicked = true;
+                }
+                ImGui::PopID();
+            }
+        }
+    }
+    clipper.End();
+    ImGui::PopID();
+
+    return clicked;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <vector>
+#include "imgui.h"
+#include "Texture.h"
+#include "TextureRegistry.h"
+#include "TextureStreamer.h"
+
+// What was clicked in the palette
+struct PaletteClick {
+    // True for an assigned texture, which sets id; false for an unassigned one, which sets unassignedIndex
+    bool assigned;
+    short id;
+    size_t unassignedIndex;
+};
+
+// The texture palette: a name filter and two grids of thumbnails, the textures assigned to tile ids
+// and the ones still waiting for an id.
+//
+// Both grids are virtualized with ImGuiListClipper, so only the rows scrolled into view submit
+// widgets, however many textures there are, and only their textures are marked visible for the
+// streamer to load. The filtered lists are rebuilt only when the filter
+// text, the registry's revision or the unassigned set changes, not every frame. Unassigned textures
+// are kept unordered, so removing one swaps the last one into its place.
+class TexturePalette {
+public:
+    void AddUnassigned(const Texture& texture);
+    void RemoveUnassigned(size_t index);
+    void ClearUnassigned();
+    const std::vector<Texture>& Unassigned() const { return unassigned; }
+
+    // Draws into the current window, tileSize pixels per thumbnail; true if a texture was clicked
+    bool Draw(const TextureRegistry& registry, TextureStreamer& streamer, float tileSize, short currentTile, PaletteClick& click);
+
+private:
+    void Refilter(const TextureRegistry& registry);
+    // Lays items out in as many columns as fit; items are ids for assigned textures, indices otherwise
+    bool DrawGrid(const char* label, const std::vector<int>& items, bool assigned, const TextureRegistry& registry, TextureStreamer& streamer, float tileSize, short currentTile, PaletteClick& click);
+
+    std::vector<Texture> unassigned;
+    ImGuiTextFilter filter;
+    std::vector<int> filteredAssigned;
+    std::vector<int> filteredUnassigned;
+    bool dirty = true;
+    unsigned registryRevision = 0;
+};
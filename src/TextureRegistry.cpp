@@ -0,0 +1,51 @@
+#include "TextureRegistry.h"
+
+void TextureRegistry::SetFallback(const Texture& texture) {
+    fallback.atlasRegion = texture.atlasRegion;
+    fallback.averageColor = texture.averageColor;
+    revision++;
+
+    for (size_t id = 0; id < textures.size(); id++) {
+        if (textures[id].id == -1) {
+            tiles[id] = fallback;
+        }
+    }
+}
+
+void TextureRegistry::Assign(short id, const Texture& texture) {
+    if (id < 0) {
+        return;
+    }
+
+    size_t index = static_cast<size_t>(id);
+    if (index >= textures.size()) {
+        Texture unassigned = Texture();
+        unassigned.id = -1;
+        tiles.resize(index + 1, fallback);
+        textures.resize(index + 1, unassigned);
+    }
+
+    tiles[index].atlasRegion = texture.atlasRegion;
+    tiles[index].averageColor = texture.averageColor;
+    textures[index] = texture;
+    textures[index].id = id;
+    revision++;
+}
+
+void TextureRegistry::Clear() {
+    tiles.clear();
+    textures.clear();
+    revision++;
+}
+
+bool TextureRegistry::IsAssigned(short id) const {
+    return id >= 0 && static_cast<size_t>(id) < textures.size() && textures[static_cast<size_t>(id)].id != -1;
+}
+
+short TextureRegistry::FreeId() const {
+    short id = 1;
+    while (IsAssigned(id)) {
+        id++;
+    }
+    return id;
+}
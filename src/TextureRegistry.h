@@ -0,0 +1,49 @@
+#pragma once
+
+#include <vector>
+#include "imgui.h"
+#include "Texture.h"
+
+// The part of a texture the map view reads for every visible cell
+struct TileTexture {
+    AtlasRegion atlasRegion;
+    ImU32 averageColor = IM_COL32_WHITE;
+};
+
+// The textures assigned to tile ids.
+//
+// Render data lives in a dense array indexed by tile id, so the map view's per-cell lookup is a
+// bounds check and an array load instead of a tree walk. Names and sizes sit in a separate array
+// that only the palette and the level's texture names touch. Ids with nothing assigned hold a copy
+// of the fallback texture, so Lookup never has to branch on whether an id is assigned.
+class TextureRegistry {
+public:
+    // What unassigned ids draw as
+    void SetFallback(const Texture& texture);
+    // Assigns texture to id, replacing whatever had it; negative ids are ignored
+    void Assign(short id, const Texture& texture);
+    void Clear();
+
+    const TileTexture& Lookup(short id) const {
+        size_t index = static_cast<unsigned short>(id);
+        return index < tiles.size() ? tiles[index] : fallback;
+    }
+
+    const TileTexture& Fallback() const { return fallback; }
+    bool IsAssigned(short id) const;
+    // The texture assigned to id; only valid if IsAssigned(id)
+    const Texture& Get(short id) const { return textures[static_cast<size_t>(id)]; }
+    // One past the highest id that has ever been assigned since the last Clear
+    int IdLimit() const { return static_cast<int>(textures.size()); }
+    // The lowest id from 1 up with nothing assigned
+    short FreeId() const;
+    // Changes on every Assign, Clear and SetFallback
+    unsigned Revision() const { return revision; }
+
+private:
+    std::vector<TileTexture> tiles;
+    // Texture::id is -1 for ids with nothing assigned
+    std::vector<Texture> textures;
+    TileTexture fallback;
+    unsigned revision = 0;
+};
@@ -0,0 +1,244 @@
+#include "TextureStreamer.h"
+#include <cstdio>
+#include <map>
+
+TextureStreamer::TextureStreamer(TextureAtlas& atlas) : atlas(atlas) {
+}
+
+void TextureStreamer::SetFallback(const Texture& texture) {
+    fallbackRegion = texture.atlasRegion;
+    fallbackColor = texture.averageColor;
+
+    for (Entry& entry : entries) {
+        if (!entry.resident) {
+            entry.region = fallbackRegion;
+        }
+    }
+}
+
+int TextureStreamer::Register(const std::string& path) {
+    Entry entry;
+    entry.path = path;
+    entry.region = fallbackRegion;
+    entry.averageColor = fallbackColor;
+    entries.push_back(entry);
+    indicesByPath[path] = static_cast<int>(entries.size()) - 1;
+    return static_cast<int>(entries.size()) - 1;
+}
+
+int TextureStreamer::Find(const std::string& path) const {
+    std::unordered_map<std::string, int>::const_iterator index = indicesByPath.find(path);
+    return index != indicesByPath.end() ? index->second : -1;
+}
+
+void TextureStreamer::Reload(int index) {
+    if (index < 0 || static_cast<size_t>(index) >= entries.size()) {
+        return;
+    }
+
+    Entry& entry = entries[static_cast<size_t>(index)];
+    entry.failed = false;
+    // A texture that isn't loaded gets its new colour when it's next needed
+    entry.colorKnown = entry.resident || entry.requested;
+    if (entry.requested) {
+        entry.reloadQueued = true;
+    } else if (entry.resident) {
+        Request(index);
+    }
+}
+
+void TextureStreamer::Request(int index) {
+    Entry& entry = entries[static_cast<size_t>(index)];
+    entry.requested = true;
+    requests.push_back(entry.path);
+    inFlight.push_back(index);
+}
+
+void TextureStreamer::MarkVisible(int index) {
+    if (index < 0 || static_cast<size_t>(index) >= entries.size()) {
+        return;
+    }
+
+    Entry& entry = entries[static_cast<size_t>(index)];
+    entry.lastVisibleTicks = SDL_GetTicks();
+    if (entry.resident || entry.failed) {
+        return;
+    }
+
+    // A decode already queued for the colour alone is uploaded after all
+    entry.colorOnly = false;
+    if (!entry.requested) {
+        Request(index);
+    }
+}
+
+void TextureStreamer::RequestAverageColor(int index) {
+    if (index < 0 || static_cast<size_t>(index) >= entries.size()) {
+        return;
+    }
+
+    Entry& entry = entries[static_cast<size_t>(index)];
+    if (entry.colorKnown || entry.requested || entry.failed) {
+        return;
+    }
+
+    entry.colorOnly = true;
+    Request(index);
+}
+
+void TextureStreamer::Update(Uint64 budgetMs, bool wait, std::vector<int>& changed) {
+    if (!requests.empty()) {
+        decoder.Enqueue(requests);
+        requests.clear();
+    }
+
+    Uint64 start = SDL_GetPerformanceCounter();
+    Uint64 budget = SDL_GetPerformanceFrequency() * budgetMs / 1000;
+
+    DecodedTexture decoded;
+    while (!inFlight.empty()) {
+        if (wait ? !decoder.WaitNext(decoded) : (SDL_GetPerformanceCounter() - start >= budget || !decoder.TakeNext(decoded))) {
+            break;
+        }
+
+        Upload(decoded, changed);
+    }
+
+    if (atlas.MemoryUsage() > memoryBudget) {
+        Evict(changed);
+    }
+}
+
+void TextureStreamer::Upload(const DecodedTexture& decoded, std::vector<int>& changed) {
+    int index = inFlight.front();
+    inFlight.pop_front();
+
+    Entry& entry = entries[static_cast<size_t>(index)];
+    entry.requested = false;
+
+    if (entry.reloadQueued) {
+        entry.reloadQueued = false;
+        Request(index);
+        return;
+    }
+
+    if (decoded.pixels == nullptr) {
+        fprintf(stderr, "Failed to load image %s: %s\n", decoded.path.c_str(), decoded.error.c_str());
+        entry.failed = true;
+        return;
+    }
+
+    if (entry.colorOnly) {
+        entry.colorOnly = false;
+        entry.averageColor = decoded.averageColor;
+        entry.colorKnown = true;
+        changed.push_back(index);
+        return;
+    }
+
+    AtlasRegion region;
+    size_t savedBytes = 0;
+    std::unordered_map<uint64_t, AtlasRegion>::const_iterator shared = regionsByHash.find(decoded.contentHash);
+    if (shared != regionsByHash.end()) {
+        region = shared->second;
+        savedBytes = static_cast<size_t>(decoded.width) * decoded.height * 4;
+    } else {
+        if (!atlas.Add(decoded.pixels, decoded.width, decoded.height, region)) {
+            fprintf(stderr, "Failed to add %s to the texture atlas\n", decoded.path.c_str());
+            entry.failed = true;
+            return;
+        }
+        regionsByHash[decoded.contentHash] = region;
+    }
+
+    // A reload replaces the image of a texture that's already resident, which may have been shared
+    if (entry.sharedBytes > 0) {
+        sharedCount--;
+        sharedBytes -= entry.sharedBytes;
+    }
+    entry.sharedBytes = savedBytes;
+    if (savedBytes > 0) {
+        sharedCount++;
+        sharedBytes += savedBytes;
+    }
+
+    entry.region = region;
+    entry.averageColor = decoded.averageColor;
+    entry.colorKnown = true;
+    if (!entry.resident) {
+        entry.resident = true;
+        residentCount++;
+    }
+    changed.push_back(index);
+}
+
+void TextureStreamer::Evict(std::vector<int>& changed) {
+    // When each page's textures were last on screen
+    std::map<SDL_Texture*, Uint32> pageLastVisible;
+    for (const Entry& entry : entries) {
+        if (entry.resident) {
+            Uint32& lastVisible = pageLastVisible[entry.region.texture];
+            if (lastVisible == 0 || SDL_TICKS_PASSED(entry.lastVisibleTicks, lastVisible)) {
+                lastVisible = entry.lastVisibleTicks;
+            }
+        }
+    }
+
+    // Pages left holding only images that reloads replaced are drawn from by nothing, so they go first
+    std::vector<SDL_Texture*> unusedPages;
+    for (int page = 0; page < atlas.PageCount(); page++) {
+        SDL_Texture* texture = atlas.PageTexture(page);
+        if (texture != fallbackRegion.texture && pageLastVisible.count(texture) == 0) {
+            unusedPages.push_back(texture);
+        }
+    }
+    for (size_t i = 0; i < unusedPages.size() && atlas.MemoryUsage() > memoryBudget; i++) {
+        RemovePage(unusedPages[i], changed);
+    }
+
+    pageLastVisible.erase(fallbackRegion.texture);
+
+    Uint32 now = SDL_GetTicks();
+    while (atlas.MemoryUsage() > memoryBudget) {
+        std::map<SDL_Texture*, Uint32>::iterator oldest = pageLastVisible.end();
+        for (std::map<SDL_Texture*, Uint32>::iterator page = pageLastVisible.begin(); page != pageLastVisible.end(); ++page) {
+            if (now - page->second >= kTextureEvictionDelayMs && (oldest == pageLastVisible.end() || SDL_TICKS_PASSED(oldest->second, page->second))) {
+                oldest = page;
+            }
+        }
+
+        // Everything over the budget is still in use
+        if (oldest == pageLastVisible.end()) {
+            return;
+        }
+
+        SDL_Texture* page = oldest->first;
+        pageLastVisible.erase(oldest);
+        RemovePage(page, changed);
+    }
+}
+
+void TextureStreamer::RemovePage(SDL_Texture* page, std::vector<int>& changed) {
+    for (size_t index = 0; index < entries.size(); index++) {
+        Entry& entry = entries[index];
+        if (entry.resident && entry.region.texture == page) {
+            entry.resident = false;
+            entry.region = fallbackRegion;
+            residentCount--;
+            if (entry.sharedBytes > 0) {
+                sharedCount--;
+                sharedBytes -= entry.sharedBytes;
+                entry.sharedBytes = 0;
+            }
+            changed.push_back(static_cast<int>(index));
+        }
+    }
+    for (std::unordered_map<uint64_t, AtlasRegion>::iterator image = regionsByHash.begin(); image != regionsByHash.end();) {
+        if (image->second.texture == page) {
+            image = regionsByHash.erase(image);
+        } else {
+            ++image;
+        }
+    }
+    atlas.RemovePage(page);
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "SDL.h"
+#include "imgui.h"
+#include "Texture.h"
+#include "TextureAtlas.h"
+#include "TextureDecoder.h"
+
+// Atlas memory kept before pages of textures that are out of view get evicted
+static const size_t kDefaultTextureMemoryBudget = 256 * 1024 * 1024;
+// How long a texture has to have been out of view before its page can be evicted
+static const Uint32 kTextureEvictionDelayMs = 5000;
+
+// Loads textures the first time they're on screen and evicts the ones that haven't been for a while.
+//
+// Textures are registered by path alone. The first time one is marked visible, in the map view or
+// the palette, its file is queued on the TextureDecoder's workers, and Update adds the decoded image
+// to the atlas on a later frame; until then the texture has the fallback's region. Its average
+// colour is kept after the first decode, so the map overview doesn't need it to stay loaded. The
+// zoomed-out overview draws no tiles at all, so RequestAverageColor decodes a texture for its
+// colour alone, which a texture cache hit answers without reading the pixels, and nothing goes
+// into the atlas.
+//
+// The atlas packer can't free single images, so eviction works on whole atlas pages. Past the memory
+// budget, the page whose textures were last on screen longest ago is destroyed once none of them
+// have been visible for kTextureEvictionDelayMs, and its textures go back to the fallback until
+// they're next seen. Pages no resident texture is drawn from any more, left behind by reloads, are
+// evicted before any other. The fallback's own page is never evicted.
+//
+// Packs often hold renamed copies of the same image. Decoded pixels are hashed, and a texture whose
+// pixels match one already resident gets that texture's region instead of a second copy in the
+// atlas; the decoded buffer is dropped right after. The hash is trusted without comparing pixels,
+// since the first image's pixels are only kept on the GPU.
+class TextureStreamer {
+public:
+    explicit TextureStreamer(TextureAtlas& atlas);
+    TextureStreamer(const TextureStreamer&) = delete;
+    TextureStreamer& operator=(const TextureStreamer&) = delete;
+
+    // Looked up before decoding and filled with what is decoded; see TextureDecoder::SetCache
+    void SetCache(TextureCache* cache) { decoder.SetCache(cache); }
+    // What textures show until they're loaded; must already be in the atlas
+    void SetFallback(const Texture& texture);
+    // Returns the new texture's index
+    int Register(const std::string& path);
+    // The index path was registered under, or -1
+    int Find(const std::string& path) const;
+    // The file at index changed on disk. A loaded texture keeps its old image until the new one is
+    // uploaded in its place; one that isn't loaded picks up the new file whenever it's next seen.
+    // The old image's atlas space isn't reused until its page is evicted; a page left with only
+    // replaced images is evicted first once the atlas is over budget.
+    void Reload(int index);
+
+    // The texture at index is on screen this frame; queues its decode the first time
+    void MarkVisible(int index);
+    // Queues a decode of the texture at index for its average colour if that isn't known yet
+    void RequestAverageColor(int index);
+    // Adds decoded textures to the atlas for up to budgetMs, or until every queued decode is done if
+    // wait is set, then evicts pages past the budget. Appends each texture whose region or average
+    // colour changed to changed.
+    void Update(Uint64 budgetMs, bool wait, std::vector<int>& changed);
+
+    const AtlasRegion& Region(int index) const { return entries[static_cast<size_t>(index)].region; }
+    ImU32 AverageColor(int index) const { return entries[static_cast<size_t>(index)].averageColor; }
+
+    size_t MemoryBudget() const { return memoryBudget; }
+    void SetMemoryBudget(size_t bytes) { memoryBudget = bytes; }
+    size_t TextureCount() const { return entries.size(); }
+    size_t ResidentCount() const { return residentCount; }
+    // Resident textures drawn from another texture's region, and the atlas bytes that saves
+    size_t SharedCount() const { return sharedCount; }
+    size_t SharedBytes() const { return sharedBytes; }
+
+    // Decodes are queued or waiting for upload
+    bool IsBusy() const { return !inFlight.empty(); }
+    // Textures loaded and queued since the streamer was last idle, for a progress bar
+    size_t BatchTaken() const { return decoder.BatchTaken(); }
+    size_t BatchSize() const { return decoder.BatchSize(); }
+
+private:
+    struct Entry {
+        std::string path;
+        AtlasRegion region;
+        ImU32 averageColor;
+        bool resident = false;
+        // Queued for decoding and not back yet
+        bool requested = false;
+        // Don't try again after a failed decode
+        bool failed = false;
+        // The file changed while a decode of it was queued, so that decode may have read the old one
+        bool reloadQueued = false;
+        // averageColor is the image's own, not the fallback's
+        bool colorKnown = false;
+        // The queued decode is only for the average colour
+        bool colorOnly = false;
+        Uint32 lastVisibleTicks = 0;
+        // Atlas bytes not spent because the image was already resident, 0 if it has its own region
+        size_t sharedBytes = 0;
+    };
+
+    void Request(int index);
+    void Upload(const DecodedTexture& decoded, std::vector<int>& changed);
+    void Evict(std::vector<int>& changed);
+    // Destroys page, sending the textures on it back to the fallback
+    void RemovePage(SDL_Texture* page, std::vector<int>& changed);
+
+    TextureAtlas& atlas;
+    TextureDecoder decoder;
+    std::vector<Entry> entries;
+    std::unordered_map<std::string, int> indicesByPath;
+    AtlasRegion fallbackRegion;
+    ImU32 fallbackColor = IM_COL32_WHITE;
+    // Marked visible this frame and not yet handed to the decoder
+    std::vector<std::string> requests;
+    // Indices of queued decodes, in the order the decoder returns them
+    std::deque<int> inFlight;
+    size_t residentCount = 0;
+    // The region of each resident image by content hash
+    std::unordered_map<uint64_t, AtlasRegion> regionsByHash;
+    size_t sharedCount = 0;
+    size_t sharedBytes = 0;
+    size_t memoryBudget = kDefaultTextureMemoryBudget;
+};
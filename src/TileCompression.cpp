@@ -0,0 +1,264 @@
+#include "TileCompression.h"
+#include <cstring>
+
+static const size_t kLzMinMatch = 4;
+static const size_t kLzMaxOffset = 65535;
+static const int kLzHashBits = 12;
+
+static uint32_t Load32(const unsigned char* p) {
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static uint32_t HashLz(uint32_t sequence) {
+    return (sequence * 2654435761u) >> (32 - kLzHashBits);
+}
+
+static void AppendLength(std::vector<unsigned char>& out, size_t length) {
+    while (length >= 255) {
+        out.push_back(255);
+        length -= 255;
+    }
+    out.push_back(static_cast<unsigned char>(length));
+}
+
+static void AppendSequence(std::vector<unsigned char>& out, const unsigned char* literals, size_t literalCount,
+                           size_t matchLength, size_t offset) {
+    size_t literalNibble = literalCount < 15 ? literalCount : 15;
+    size_t matchNibble = 0;
+    if (matchLength != 0) {
+        matchNibble = matchLength - kLzMinMatch < 15 ? matchLength - kLzMinMatch : 15;
+    }
+
+    out.push_back(static_cast<unsigned char>((literalNibble << 4) | matchNibble));
+    if (literalNibble == 15) {
+        AppendLength(out, literalCount - 15);
+    }
+
+    out.insert(out.end(), literals, literals + literalCount);
+
+    if (matchLength != 0) {
+        out.push_back(static_cast<unsigned char>(offset));
+        out.push_back(static_cast<unsigned char>(offset >> 8));
+        if (matchNibble == 15) {
+            AppendLength(out, matchLength - kLzMinMatch - 15);
+        }
+    }
+}
+
+void LzCompress(const unsigned char* data, size_t size, std::vector<unsigned char>& out) {
+    // Positions are stored +1 so 0 means "never seen"
+    uint32_t table[1 << kLzHashBits] = {};
+    size_t literalStart = 0;
+    size_t position = 0;
+
+    while (position + kLzMinMatch <= size) {
+        uint32_t sequence = Load32(data + position);
+        uint32_t hash = HashLz(sequence);
+        size_t candidate = table[hash];
+        table[hash] = static_cast<uint32_t>(position + 1);
+
+        if (candidate == 0 || position - (candidate - 1) > kLzMaxOffset || Load32(data + candidate - 1) != sequence) {
+            position++;
+            continue;
+        }
+
+        size_t matchStart = candidate - 1;
+        size_t matchLength = kLzMinMatch;
+        while (position + matchLength < size && data[matchStart + matchLength] == data[position + matchLength]) {
+            matchLength++;
+        }
+
+        AppendSequence(out, data + literalStart, position - literalStart, matchLength, position - matchStart);
+        position += matchLength;
+        literalStart = position;
+    }
+
+    AppendSequence(out, data + literalStart, size - literalStart, 0, 0);
+}
+
+static bool ReadLength(const unsigned char*& p, const unsigned char* end, size_t& length) {
+    for (;;) {
+        if (p == end) {
+            return false;
+        }
+
+        unsigned char byte = *p++;
+        length += byte;
+        if (byte != 255) {
+            return true;
+        }
+    }
+}
+
+bool LzDecompress(const unsigned char* data, size_t size, unsigned char* out, size_t outSize) {
+    const unsigned char* p = data;
+    const unsigned char* end = data + size;
+    size_t written = 0;
+
+    while (p != end) {
+        unsigned char token = *p++;
+
+        size_t literalCount = token >> 4;
+        if (literalCount == 15 && !ReadLength(p, end, literalCount)) {
+            return false;
+        }
+
+        if (literalCount > static_cast<size_t>(end - p) || literalCount > outSize - written) {
+            return false;
+        }
+
+        memcpy(out + written, p, literalCount);
+        p += literalCount;
+        written += literalCount;
+
+        // Only the final sequence may end after its literals
+        if (p == end) {
+            break;
+        }
+
+        if (end - p < 2) {
+            return false;
+        }
+
+        size_t offset = p[0] | (p[1] << 8);
+        p += 2;
+
+        size_t matchLength = token & 0x0f;
+        if (matchLength == 15 && !ReadLength(p, end, matchLength)) {
+            return false;
+        }
+        matchLength += kLzMinMatch;
+
+        if (offset == 0 || offset > written || matchLength > outSize - written) {
+            return false;
+        }
+
+        // Byte by byte: matches may overlap the bytes they produce
+        unsigned char* destination = out + written;
+        const unsigned char* source = destination - offset;
+        for (size_t i = 0; i < matchLength; i++) {
+            destination[i] = source[i];
+        }
+        written += matchLength;
+    }
+
+    return written == outSize;
+}
+
+static void RleEncode(const short* tiles, std::vector<unsigned char>& out) {
+    int i = 0;
+    while (i < kLevelChunkCells) {
+        short value = tiles[i];
+        int run = 1;
+        while (i + run < kLevelChunkCells && run < 256 && tiles[i + run] == value) {
+            run++;
+        }
+
+        out.push_back(static_cast<unsigned char>(run - 1));
+        out.push_back(static_cast<unsigned char>(value));
+        out.push_back(static_cast<unsigned char>(static_cast<uint16_t>(value) >> 8));
+        i += run;
+    }
+}
+
+static bool RleDecode(const unsigned char* data, size_t size, short* tiles) {
+    if (size % 3 != 0) {
+        return false;
+    }
+
+    int written = 0;
+    for (size_t i = 0; i < size; i += 3) {
+        int run = data[i] + 1;
+        short value = static_cast<short>(data[i + 1] | (data[i + 2] << 8));
+
+        if (run > kLevelChunkCells - written) {
+            return false;
+        }
+
+        for (int j = 0; j < run; j++) {
+            tiles[written++] = value;
+        }
+    }
+
+    return written == kLevelChunkCells;
+}
+
+TileChunkMethod EncodeTileChunk(const short* tiles, std::vector<unsigned char>& out) {
+    bool empty = true;
+    for (int i = 0; i < kLevelChunkCells && empty; i++) {
+        empty = tiles[i] == 0;
+    }
+
+    if (empty) {
+        return TileChunkMethod_Empty;
+    }
+
+    std::vector<unsigned char> rle;
+    rle.reserve(kLevelChunkCells);
+    RleEncode(tiles, rle);
+
+    std::vector<unsigned char> lz;
+    LzCompress(rle.data(), rle.size(), lz);
+
+    const size_t rawSize = kLevelChunkCells * sizeof(int16_t);
+    size_t rleLzSize = 4 + lz.size();
+
+    if (rleLzSize < rle.size() && rleLzSize < rawSize) {
+        uint32_t rleSize = static_cast<uint32_t>(rle.size());
+        for (int i = 0; i < 4; i++) {
+            out.push_back(static_cast<unsigned char>(rleSize >> (8 * i)));
+        }
+        out.insert(out.end(), lz.begin(), lz.end());
+        return TileChunkMethod_RleLz;
+    }
+
+    if (rle.size() < rawSize) {
+        out.insert(out.end(), rle.begin(), rle.end());
+        return TileChunkMethod_Rle;
+    }
+
+    for (int i = 0; i < kLevelChunkCells; i++) {
+        out.push_back(static_cast<unsigned char>(tiles[i]));
+        out.push_back(static_cast<unsigned char>(static_cast<uint16_t>(tiles[i]) >> 8));
+    }
+    return TileChunkMethod_Raw;
+}
+
+bool DecodeTileChunk(TileChunkMethod method, const unsigned char* data, size_t size, short* tiles) {
+    switch (method) {
+        case TileChunkMethod_Empty:
+            memset(tiles, 0, kLevelChunkCells * sizeof(short));
+            return size == 0;
+
+        case TileChunkMethod_Raw:
+            if (size != kLevelChunkCells * sizeof(int16_t)) {
+                return false;
+            }
+            for (int i = 0; i < kLevelChunkCells; i++) {
+                tiles[i] = static_cast<short>(data[i * 2] | (data[i * 2 + 1] << 8));
+            }
+            return true;
+
+        case TileChunkMethod_Rle:
+            return RleDecode(data, size, tiles);
+
+        case TileChunkMethod_RleLz: {
+            if (size < 4) {
+                return false;
+            }
+
+            uint32_t rleSize = data[0] | (data[1] << 8) | (data[2] << 16) | (static_cast<uint32_t>(data[3]) << 24);
+            // The longest run-length stream is one pair per cell
+            if (rleSize > kLevelChunkCells * 3) {
+                return false;
+            }
+
+            unsigned char rle[kLevelChunkCells * 3];
+            return LzDecompress(data + 4, size - 4, rle, rleSize) && RleDecode(rle, rleSize, tiles);
+        }
+    }
+
+    return false;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "LevelGrid.h"
+
+// Per-chunk codec for the compressed tile block of binary levels.
+// A chunk is always kLevelChunkCells tiles, row-major, with cells past the map edge set to 0.
+enum TileChunkMethod : uint8_t {
+    // Every tile is 0; no payload
+    TileChunkMethod_Empty = 0,
+    // kLevelChunkCells little-endian int16s
+    TileChunkMethod_Raw = 1,
+    // Run-length pairs: (run length - 1 as uint8, tile id as little-endian int16)
+    TileChunkMethod_Rle = 2,
+    // uint32 run-length stream size, then that stream LZ-compressed
+    TileChunkMethod_RleLz = 3
+};
+
+// Picks the smallest of the methods above for tiles and appends the payload to out
+TileChunkMethod EncodeTileChunk(const short* tiles, std::vector<unsigned char>& out);
+
+// Decodes one payload into kLevelChunkCells tiles; false if the payload is malformed
+bool DecodeTileChunk(TileChunkMethod method, const unsigned char* data, size_t size, short* tiles);
+
+// Byte-oriented LZ77 in the style of LZ4 blocks: each sequence is a token (literal count in the
+// high nibble, match length - 4 in the low nibble, 15 meaning "more length bytes follow"), the
+// literals, then a little-endian uint16 match offset. The last sequence has literals only.
+void LzCompress(const unsigned char* data, size_t size, std::vector<unsigned char>& out);
+bool LzDecompress(const unsigned char* data, size_t size, unsigned char* out, size_t outSize);
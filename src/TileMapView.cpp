@@ -0,0 +1,610 @@
+#include "TileMapView.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+static const float kTileGap = 1.0f;
+static const ImU32 kEmptyTileColor = IM_COL32_WHITE;
+// Quads per PrimReserve; with 16-bit indices a single reservation has to stay under 64k vertices
+static const int kQuadsPerReserve = 16384 - 1;
+// Past this many changed cells in a frame, redrawing the whole target is cheaper than cell by cell
+static const size_t kMaxInvalidCells = 4096;
+// Zoom factor per mouse wheel notch and per +/- key press
+static const float kWheelZoomFactor = 1.25f;
+static const float kKeyZoomFactor = 1.5f;
+// Arrow key panning speed in pixels per second, four times that with Shift
+static const float kKeyboardPanSpeed = 900.0f;
+// How quickly the zoom catches up with its target; higher is snappier
+static const float kZoomEasing = 18.0f;
+// A frame after a long idle wait shouldn't make the camera jump
+static const float kMaxCameraTimeStep = 1.0f / 30.0f;
+
+// Width of a cell plus the gap after it; zoomed out the gaps would cover more of the map than the tiles
+static float CellStep(float tileSize) {
+    return tileSize >= kOverviewTileSize ? tileSize + kTileGap : tileSize;
+}
+
+TileMapView::~TileMapView() {
+    ReleaseRenderTarget();
+}
+
+void TileMapView::SetRenderer(SDL_Renderer* renderer) {
+    ReleaseRenderTarget();
+    this->renderer = renderer != nullptr && SDL_RenderTargetSupported(renderer) ? renderer : nullptr;
+}
+
+void TileMapView::ReleaseRenderTarget() {
+    if (renderTarget != nullptr) {
+        SDL_DestroyTexture(renderTarget);
+        renderTarget = nullptr;
+    }
+
+    renderTargetWidth = 0;
+    renderTargetHeight = 0;
+    allInvalid = true;
+
+    if (overviewTexture != nullptr) {
+        SDL_DestroyTexture(overviewTexture);
+        overviewTexture = nullptr;
+    }
+
+    overviewTextureWidth = 0;
+    overviewTextureHeight = 0;
+    overviewTextureLevel = -1;
+}
+
+void TileMapView::InvalidateAll() {
+    allInvalid = true;
+    invalidCells.clear();
+    overview.InvalidateAll();
+}
+
+void TileMapView::InvalidateCell(int x, int y) {
+    overview.InvalidateCell(x, y);
+    InvalidateTargetCell(x, y);
+}
+
+void TileMapView::InvalidateTileTextures(const LevelGrid& grid, const std::vector<short>& ids) {
+    // Without a cached target every visible cell is drawn each frame anyway
+    if (allInvalid || renderTarget == nullptr || ids.empty()) {
+        return;
+    }
+
+    if (seenIds.empty()) {
+        seenIds.assign(65536, 0);
+    }
+    for (short id : ids) {
+        seenIds[static_cast<unsigned short>(id)] = 1;
+    }
+
+    int lastX = std::min(cachedRange.lastX, grid.Width());
+    int lastY = std::min(cachedRange.lastY, grid.Height());
+    for (int y = cachedRange.firstY; y < lastY && !allInvalid; y++) {
+        for (int x = cachedRange.firstX; x < lastX; x++) {
+            if (seenIds[static_cast<unsigned short>(grid.Get(x, y))]) {
+                InvalidateTargetCell(x, y);
+            }
+        }
+    }
+
+    for (short id : ids) {
+        seenIds[static_cast<unsigned short>(id)] = 0;
+    }
+}
+
+void TileMapView::InvalidateTargetCell(int x, int y) {
+    if (allInvalid) {
+        return;
+    }
+
+    if (invalidCells.size() >= kMaxInvalidCells) {
+        allInvalid = true;
+        invalidCells.clear();
+        return;
+    }
+
+    TileCoordinate cell = {x, y};
+    invalidCells.push_back(cell);
+}
+
+void TileMapView::SetCamera(const MapCamera& camera) {
+    this->camera = camera;
+    this->camera.zoom = std::min(std::max(camera.zoom, kMinMapZoom), kMaxMapZoom);
+    targetZoom = this->camera.zoom;
+    fitPending = false;
+}
+
+void TileMapView::SetZoom(float zoom) {
+    ImVec2 centre(viewSize.x * 0.5f, viewSize.y * 0.5f);
+    float centreX = camera.x + centre.x / CellStep(camera.zoom);
+    float centreY = camera.y + centre.y / CellStep(camera.zoom);
+
+    camera.zoom = targetZoom = std::min(std::max(zoom, kMinMapZoom), kMaxMapZoom);
+    camera.x = centreX - centre.x / CellStep(camera.zoom);
+    camera.y = centreY - centre.y / CellStep(camera.zoom);
+}
+
+void TileMapView::ZoomTowards(float zoom, ImVec2 anchor) {
+    targetZoom = std::min(std::max(zoom, kMinMapZoom), kMaxMapZoom);
+    zoomAnchor = anchor;
+}
+
+void TileMapView::ClampCamera(const LevelGrid& grid) {
+    // Half the view can hang past each edge of the map, so the map can't be lost off screen
+    float step = CellStep(camera.zoom);
+    float halfWidth = viewSize.x * 0.5f / step;
+    float halfHeight = viewSize.y * 0.5f / step;
+    camera.x = std::min(std::max(camera.x, -halfWidth), grid.Width() - halfWidth);
+    camera.y = std::min(std::max(camera.y, -halfHeight), grid.Height() - halfHeight);
+}
+
+void TileMapView::UpdateCamera(const LevelGrid& grid, ImVec2 viewMin, bool active) {
+    ImGuiIO& io = ImGui::GetIO();
+
+    if (fitPending && grid.CellCount() > 0) {
+        fitPending = false;
+        float zoom = std::min(viewSize.x / grid.Width(), viewSize.y / grid.Height());
+        if (zoom >= kOverviewTileSize + kTileGap) {
+            zoom -= kTileGap;
+        }
+        camera.zoom = targetZoom = std::min(std::max(zoom, kMinMapZoom), kMaxMapZoom);
+
+        float step = CellStep(camera.zoom);
+        camera.x = (grid.Width() - viewSize.x / step) * 0.5f;
+        camera.y = (grid.Height() - viewSize.y / step) * 0.5f;
+    }
+
+    if (hovered && io.MouseWheel != 0.0f) {
+        ZoomTowards(targetZoom * std::pow(kWheelZoomFactor, io.MouseWheel), ImVec2(io.MousePos.x - viewMin.x, io.MousePos.y - viewMin.y));
+    }
+
+    keyPanning = false;
+    if (ImGui::IsWindowFocused() && !io.WantTextInput && !io.KeyCtrl) {
+        float pan = kKeyboardPanSpeed * std::min(io.DeltaTime, kMaxCameraTimeStep) * (io.KeyShift ? 4.0f : 1.0f) / CellStep(camera.zoom);
+        ImVec2 direction(0.0f, 0.0f);
+        direction.x -= ImGui::IsKeyDown(ImGuiKey_LeftArrow) ? 1.0f : 0.0f;
+        direction.x += ImGui::IsKeyDown(ImGuiKey_RightArrow) ? 1.0f : 0.0f;
+        direction.y -= ImGui::IsKeyDown(ImGuiKey_UpArrow) ? 1.0f : 0.0f;
+        direction.y += ImGui::IsKeyDown(ImGuiKey_DownArrow) ? 1.0f : 0.0f;
+        camera.x += direction.x * pan;
+        camera.y += direction.y * pan;
+        keyPanning = direction.x != 0.0f || direction.y != 0.0f;
+
+        ImVec2 centre(viewSize.x * 0.5f, viewSize.y * 0.5f);
+        if (ImGui::IsKeyPressed(ImGuiKey_Equal) || ImGui::IsKeyPressed(ImGuiKey_KeypadAdd)) {
+            ZoomTowards(targetZoom * kKeyZoomFactor, centre);
+        }
+        if (ImGui::IsKeyPressed(ImGuiKey_Minus) || ImGui::IsKeyPressed(ImGuiKey_KeypadSubtract)) {
+            ZoomTowards(targetZoom / kKeyZoomFactor, centre);
+        }
+        if (ImGui::IsKeyPressed(ImGuiKey_Home, false)) {
+            fitPending = true;
+        }
+    }
+
+    if (active && ImGui::IsMouseDown(ImGuiMouseButton_Middle)) {
+        float step = CellStep(camera.zoom);
+        camera.x -= io.MouseDelta.x / step;
+        camera.y -= io.MouseDelta.y / step;
+    }
+
+    // Ease towards the target zoom in log space, so zooming in and out feel the same
+    if (camera.zoom != targetZoom) {
+        float anchorX = camera.x + zoomAnchor.x / CellStep(camera.zoom);
+        float anchorY = camera.y + zoomAnchor.y / CellStep(camera.zoom);
+
+        float t = 1.0f - std::exp(-kZoomEasing * std::min(io.DeltaTime, kMaxCameraTimeStep));
+        float zoom = std::exp(std::log(camera.zoom) + (std::log(targetZoom) - std::log(camera.zoom)) * t);
+        if (std::fabs(zoom - targetZoom) < targetZoom * 0.005f) {
+            zoom = targetZoom;
+        }
+
+        camera.zoom = zoom;
+        camera.x = anchorX - zoomAnchor.x / CellStep(camera.zoom);
+        camera.y = anchorY - zoomAnchor.y / CellStep(camera.zoom);
+    }
+
+    ClampCamera(grid);
+}
+
+void TileMapView::Draw(const LevelGrid& grid, const TextureRegistry& textures, std::vector<TileCoordinate>& painted) {
+    ImGuiIO& io = ImGui::GetIO();
+    ImVec2 viewMin = ImGui::GetCursorScreenPos();
+    ImVec2 available = ImGui::GetContentRegionAvail();
+    viewSize = ImVec2(std::max(available.x, 1.0f), std::max(available.y, 1.0f));
+    ImVec2 viewMax(viewMin.x + viewSize.x, viewMin.y + viewSize.y);
+
+    ImGui::InvisibleButton("##tilemap", viewSize, ImGuiButtonFlags_MouseButtonLeft | ImGuiButtonFlags_MouseButtonMiddle);
+    bool active = ImGui::IsItemActive();
+    hovered = ImGui::IsItemHovered();
+
+    UpdateCamera(grid, viewMin, active);
+
+    pixelScale = io.DisplayFramebufferScale.x;
+    float tileSize = camera.zoom;
+    float step = CellStep(tileSize);
+    // Snap the map to whole device pixels so the cached target isn't resampled between them
+    ImVec2 origin(std::floor((viewMin.x - camera.x * step) * pixelScale) / pixelScale,
+                  std::floor((viewMin.y - camera.y * step) * pixelScale) / pixelScale);
+
+    ImDrawList* drawList = ImGui::GetWindowDrawList();
+    drawList->PushClipRect(viewMin, viewMax, true);
+    ImVec2 clipMin = drawList->GetClipRectMin();
+    ImVec2 clipMax = drawList->GetClipRectMax();
+
+    // Only the cells that overlap the view
+    CellRange range;
+    range.firstX = std::max(0, static_cast<int>(std::floor((clipMin.x - origin.x) / step)));
+    range.firstY = std::max(0, static_cast<int>(std::floor((clipMin.y - origin.y) / step)));
+    range.lastX = std::min(grid.Width(), static_cast<int>(std::ceil((clipMax.x - origin.x) / step)));
+    range.lastY = std::min(grid.Height(), static_cast<int>(std::ceil((clipMax.y - origin.y) / step)));
+
+    visibleCellCount = 0;
+    drawnCellCount = 0;
+    overviewLevel = -1;
+    tileRange = tileSize < kOverviewTileSize ? CellRange{0, 0, 0, 0} : range;
+
+    if (range.firstX < range.lastX && range.firstY < range.lastY) {
+        visibleCellCount = (range.lastX - range.firstX) * (range.lastY - range.firstY);
+
+        // While the zoom eases, every frame has a new tile size; redrawing the whole cached target
+        // for each would cost more than drawing the quads directly
+        bool zooming = camera.zoom != targetZoom;
+
+        if (tileSize < kOverviewTileSize) {
+            DrawOverview(grid, range, origin, tileSize, textures);
+        } else if (renderer != nullptr && !zooming && UpdateRenderTarget(grid, range, tileSize, textures)) {
+            ImVec2 min(origin.x + range.firstX * step, origin.y + range.firstY * step);
+            ImVec2 max(origin.x + range.lastX * step, origin.y + range.lastY * step);
+            ImVec2 uv1(std::lround((max.x - min.x) * pixelScale) / static_cast<float>(renderTargetWidth),
+                       std::lround((max.y - min.y) * pixelScale) / static_cast<float>(renderTargetHeight));
+            drawList->AddImage(renderTarget, min, max, ImVec2(0.0f, 0.0f), uv1);
+        } else {
+            DrawQuads(grid, range, origin, tileSize, textures);
+        }
+    }
+
+    drawList->PopClipRect();
+
+    ImVec2 mouse = io.MousePos;
+    int mouseX = static_cast<int>(std::floor((mouse.x - origin.x) / step));
+    int mouseY = static_cast<int>(std::floor((mouse.y - origin.y) / step));
+    hovered = hovered && grid.InBounds(mouseX, mouseY);
+    hoveredCell.x = mouseX;
+    hoveredCell.y = mouseY;
+
+    if (!active || !ImGui::IsMouseDown(ImGuiMouseButton_Left) || grid.CellCount() == 0) {
+        painting = false;
+        return;
+    }
+
+    // Keep painting while the button is held, even once the mouse leaves the map
+    mouseX = std::min(std::max(mouseX, 0), grid.Width() - 1);
+    mouseY = std::min(std::max(mouseY, 0), grid.Height() - 1);
+
+    if (!painting) {
+        painting = true;
+        lastPainted.x = mouseX;
+        lastPainted.y = mouseY;
+        painted.push_back(lastPainted);
+        return;
+    }
+
+    PaintLine(mouseX, mouseY, painted);
+}
+
+void TileMapView::CollectVisibleTileIds(const LevelGrid& grid, std::vector<short>& ids) {
+    ids.clear();
+    int lastX = std::min(tileRange.lastX, grid.Width());
+    int lastY = std::min(tileRange.lastY, grid.Height());
+    if (tileRange.firstX >= lastX || tileRange.firstY >= lastY) {
+        return;
+    }
+
+    if (seenIds.empty()) {
+        seenIds.assign(65536, 0);
+    }
+
+    scratchRow.resize(static_cast<size_t>(grid.Width()));
+    for (int y = tileRange.firstY; y < lastY; y++) {
+        const short* row = grid.ReadRow(y, scratchRow.data());
+        for (int x = tileRange.firstX; x < lastX; x++) {
+            unsigned char& seen = seenIds[static_cast<unsigned short>(row[x])];
+            if (!seen) {
+                seen = 1;
+                ids.push_back(row[x]);
+            }
+        }
+    }
+
+    for (short id : ids) {
+        seenIds[static_cast<unsigned short>(id)] = 0;
+    }
+}
+
+void TileMapView::DrawQuads(const LevelGrid& grid, const CellRange& range, ImVec2 origin, float tileSize, const TextureRegistry& textures) {
+    ImDrawList* drawList = ImGui::GetWindowDrawList();
+    float step = CellStep(tileSize);
+
+    // Get rather than ReadRow: a chunked row read copies the whole width of the map
+    visibleTiles.clear();
+    for (int y = range.firstY; y < range.lastY; y++) {
+        for (int x = range.firstX; x < range.lastX; x++) {
+            VisibleTile tile = {grid.Get(x, y), x, y};
+            visibleTiles.push_back(tile);
+        }
+    }
+    drawnCellCount = static_cast<int>(visibleTiles.size());
+
+    // One run per tile id; consecutive runs on the same atlas page end up in the same draw command
+    std::sort(visibleTiles.begin(), visibleTiles.end(), [](const VisibleTile& a, const VisibleTile& b) {
+        return a.id < b.id;
+    });
+
+    ImVec2 uvWhite = ImGui::GetFontTexUvWhitePixel();
+
+    for (size_t start = 0; start < visibleTiles.size();) {
+        short id = visibleTiles[start].id;
+        size_t end = start;
+        while (end < visibleTiles.size() && visibleTiles[end].id == id) {
+            end++;
+        }
+
+        bool empty = id == 0;
+        ImVec2 uv0 = uvWhite;
+        ImVec2 uv1 = uvWhite;
+        if (!empty) {
+            const AtlasRegion& region = textures.Lookup(id).atlasRegion;
+            drawList->PushTextureID(region.texture);
+            uv0 = region.uv0;
+            uv1 = region.uv1;
+        }
+
+        for (size_t i = start; i < end; i++) {
+            if ((i - start) % kQuadsPerReserve == 0) {
+                int count = static_cast<int>(std::min(end - i, static_cast<size_t>(kQuadsPerReserve)));
+                drawList->PrimReserve(count * 6, count * 4);
+            }
+
+            ImVec2 min(origin.x + visibleTiles[i].x * step, origin.y + visibleTiles[i].y * step);
+            ImVec2 max(min.x + tileSize, min.y + tileSize);
+            drawList->PrimRectUV(min, max, uv0, uv1, empty ? kEmptyTileColor : IM_COL32_WHITE);
+        }
+
+        if (!empty) {
+            drawList->PopTextureID();
+        }
+
+        start = end;
+    }
+}
+
+bool TileMapView::UpdateRenderTarget(const LevelGrid& grid, const CellRange& range, float tileSize, const TextureRegistry& textures) {
+    float step = CellStep(tileSize);
+    int width = static_cast<int>(std::lround((range.lastX - range.firstX) * step * pixelScale));
+    int height = static_cast<int>(std::lround((range.lastY - range.firstY) * step * pixelScale));
+
+    // Grow the target in 256 pixel steps so resizing the window doesn't recreate it every frame
+    if (renderTarget == nullptr || width > renderTargetWidth || height > renderTargetHeight) {
+        ReleaseRenderTarget();
+
+        int targetWidth = (width + 255) & ~255;
+        int targetHeight = (height + 255) & ~255;
+        renderTarget = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_TARGET, targetWidth, targetHeight);
+        if (renderTarget == nullptr) {
+            return false;
+        }
+
+        SDL_SetTextureBlendMode(renderTarget, SDL_BLENDMODE_BLEND);
+        renderTargetWidth = targetWidth;
+        renderTargetHeight = targetHeight;
+    }
+
+    bool rangeChanged = range.firstX != cachedRange.firstX || range.firstY != cachedRange.firstY ||
+                        range.lastX != cachedRange.lastX || range.lastY != cachedRange.lastY ||
+                        tileSize != cachedTileSize || pixelScale != cachedScale;
+
+    if (!allInvalid && !rangeChanged && invalidCells.empty()) {
+        return true;
+    }
+
+    SDL_Texture* previousTarget = SDL_GetRenderTarget(renderer);
+    float previousScaleX;
+    float previousScaleY;
+    SDL_RenderGetScale(renderer, &previousScaleX, &previousScaleY);
+
+    SDL_SetRenderTarget(renderer, renderTarget);
+    SDL_RenderSetScale(renderer, 1.0f, 1.0f);
+    SDL_RenderSetClipRect(renderer, nullptr);
+    // Tiles are copied into the target as they are, alpha included, so the cached quad blends just
+    // like the tiles would have drawn directly
+    SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_NONE);
+
+    cachedTileSize = tileSize;
+    cachedScale = pixelScale;
+
+    if (allInvalid || rangeChanged) {
+        cachedRange = range;
+
+        // The gaps between cells stay transparent so the window shows through, as before
+        SDL_SetRenderDrawColor(renderer, 0, 0, 0, 0);
+        SDL_RenderClear(renderer);
+
+        for (int y = range.firstY; y < range.lastY; y++) {
+            for (int x = range.firstX; x < range.lastX; x++) {
+                RenderCell(x, y, grid.Get(x, y), textures);
+            }
+        }
+        drawnCellCount = visibleCellCount;
+    } else {
+        for (const TileCoordinate& cell : invalidCells) {
+            if (cell.x >= range.firstX && cell.x < range.lastX && cell.y >= range.firstY && cell.y < range.lastY) {
+                RenderCell(cell.x, cell.y, grid.Get(cell.x, cell.y), textures);
+                drawnCellCount++;
+            }
+        }
+    }
+
+    for (SDL_Texture* texture : copiedTextures) {
+        SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+    }
+    copiedTextures.clear();
+
+    SDL_SetRenderTarget(renderer, previousTarget);
+    SDL_RenderSetScale(renderer, previousScaleX, previousScaleY);
+
+    allInvalid = false;
+    invalidCells.clear();
+    return true;
+}
+
+void TileMapView::RenderCell(int x, int y, short id, const TextureRegistry& textures) {
+    float step = CellStep(cachedTileSize);
+    float left = (x - cachedRange.firstX) * step;
+    float top = (y - cachedRange.firstY) * step;
+
+    SDL_Rect destination;
+    destination.x = static_cast<int>(std::lround(left * pixelScale));
+    destination.y = static_cast<int>(std::lround(top * pixelScale));
+    destination.w = static_cast<int>(std::lround((left + cachedTileSize) * pixelScale)) - destination.x;
+    destination.h = static_cast<int>(std::lround((top + cachedTileSize) * pixelScale)) - destination.y;
+
+    if (id == 0) {
+        SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
+        SDL_RenderFillRect(renderer, &destination);
+        return;
+    }
+
+    const AtlasRegion& region = textures.Lookup(id).atlasRegion;
+    if (std::find(copiedTextures.begin(), copiedTextures.end(), region.texture) == copiedTextures.end()) {
+        SDL_SetTextureBlendMode(region.texture, SDL_BLENDMODE_NONE);
+        copiedTextures.push_back(region.texture);
+    }
+
+    SDL_RenderCopy(renderer, region.texture, &region.rect, &destination);
+}
+
+void TileMapView::DrawOverview(const LevelGrid& grid, const CellRange& range, ImVec2 origin, float tileSize, const TextureRegistry& textures) {
+    TileColorLookup lookupColor = [&](short id) -> uint32_t {
+        return id == 0 ? kEmptyTileColor : textures.Lookup(id).averageColor;
+    };
+    overview.Update(grid, lookupColor);
+
+    // The finest level with at least a pixel per cell; without a texture every cell is a quad, so
+    // those have to be bigger
+    bool textured = renderer != nullptr;
+    float minimumCellSize = textured ? 1.0f : kOverviewTileSize;
+    float cellSize = tileSize * (textured ? pixelScale : 1.0f);
+    int level = 0;
+    while (level + 1 < overview.LevelCount() && cellSize * (1 << level) < minimumCellSize) {
+        level++;
+    }
+    overviewLevel = level;
+
+    int cellTiles = 1 << level;
+    CellRange cells;
+    cells.firstX = range.firstX >> level;
+    cells.firstY = range.firstY >> level;
+    cells.lastX = (range.lastX + cellTiles - 1) >> level;
+    cells.lastY = (range.lastY + cellTiles - 1) >> level;
+    int width = cells.lastX - cells.firstX;
+    int height = cells.lastY - cells.firstY;
+
+    bool changed = level != overviewTextureLevel || overview.Revision() != overviewRevision ||
+                   cells.firstX != overviewRange.firstX || cells.firstY != overviewRange.firstY ||
+                   cells.lastX != overviewRange.lastX || cells.lastY != overviewRange.lastY;
+    if (changed || !textured) {
+        overviewPixels.resize(static_cast<size_t>(width) * height);
+        overview.ReadRegion(grid, level, cells.firstX, cells.firstY, width, height, overviewPixels.data(), width, lookupColor);
+        drawnCellCount = width * height;
+    }
+
+    // The last row and column of cells can hang over the edge of the map, so clip them to it
+    float cellStep = tileSize * cellTiles;
+    ImVec2 min(origin.x + cells.firstX * cellStep, origin.y + cells.firstY * cellStep);
+    ImVec2 max(std::min(origin.x + cells.lastX * cellStep, origin.x + grid.Width() * tileSize),
+               std::min(origin.y + cells.lastY * cellStep, origin.y + grid.Height() * tileSize));
+
+    ImDrawList* drawList = ImGui::GetWindowDrawList();
+    if (textured && (!changed || UpdateOverviewTexture(width, height))) {
+        overviewRange = cells;
+        overviewTextureLevel = level;
+        overviewRevision = overview.Revision();
+
+        ImVec2 uv1((max.x - min.x) / cellStep / overviewTextureWidth, (max.y - min.y) / cellStep / overviewTextureHeight);
+        drawList->AddImage(overviewTexture, min, max, ImVec2(0.0f, 0.0f), uv1);
+        return;
+    }
+
+    ImVec2 uvWhite = ImGui::GetFontTexUvWhitePixel();
+    int rowsPerReserve = std::max(1, kQuadsPerReserve / width);
+    for (int y = 0; y < height; y++) {
+        if (y % rowsPerReserve == 0) {
+            int rows = std::min(height - y, rowsPerReserve);
+            drawList->PrimReserve(rows * width * 6, rows * width * 4);
+        }
+
+        for (int x = 0; x < width; x++) {
+            ImVec2 cellMin(min.x + x * cellStep, min.y + y * cellStep);
+            ImVec2 cellMax(std::min(cellMin.x + cellStep, max.x), std::min(cellMin.y + cellStep, max.y));
+            drawList->PrimRectUV(cellMin, cellMax, uvWhite, uvWhite, overviewPixels[static_cast<size_t>(y) * width + x]);
+        }
+    }
+}
+
+bool TileMapView::UpdateOverviewTexture(int width, int height) {
+    if (overviewTexture == nullptr || width > overviewTextureWidth || height > overviewTextureHeight) {
+        if (overviewTexture != nullptr) {
+            SDL_DestroyTexture(overviewTexture);
+        }
+
+        int textureWidth = (width + 255) & ~255;
+        int textureHeight = (height + 255) & ~255;
+        overviewTexture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_STREAMING, textureWidth, textureHeight);
+        if (overviewTexture == nullptr) {
+            overviewTextureWidth = 0;
+            overviewTextureHeight = 0;
+            return false;
+        }
+
+        // Each cell is a flat colour; filtering would smear neighbouring cells into each other
+        SDL_SetTextureBlendMode(overviewTexture, SDL_BLENDMODE_BLEND);
+        SDL_SetTextureScaleMode(overviewTexture, SDL_ScaleModeNearest);
+        overviewTextureWidth = textureWidth;
+        overviewTextureHeight = textureHeight;
+    }
+
+    SDL_Rect rect = {0, 0, width, height};
+    return SDL_UpdateTexture(overviewTexture, &rect, overviewPixels.data(), width * 4) == 0;
+}
+
+bool TileMapView::HoveredCell(TileCoordinate& cell) const {
+    if (!hovered) {
+        return false;
+    }
+
+    cell = hoveredCell;
+    return true;
+}
+
+void TileMapView::PaintLine(int x, int y, std::vector<TileCoordinate>& painted) {
+    int deltaX = std::abs(x - lastPainted.x);
+    int deltaY = -std::abs(y - lastPainted.y);
+    int stepX = lastPainted.x < x ? 1 : -1;
+    int stepY = lastPainted.y < y ? 1 : -1;
+    int error = deltaX + deltaY;
+
+    while (lastPainted.x != x || lastPainted.y != y) {
+        int doubled = 2 * error;
+        if (doubled >= deltaY) {
+            error += deltaY;
+            lastPainted.x += stepX;
+        }
+        if (doubled <= deltaX) {
+            error += deltaX;
+            lastPainted.y += stepY;
+        }
+
+        painted.push_back(lastPainted);
+    }
+}
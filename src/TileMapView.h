@@ -0,0 +1,172 @@
+#pragma once
+
+#include <vector>
+#include "SDL.h"
+#include "imgui.h"
+#include "LevelGrid.h"
+#include "MapOverview.h"
+#include "TextureRegistry.h"
+
+struct TileCoordinate {
+    int x;
+    int y;
+};
+
+// Below this many pixels per tile the map is drawn from the overview pyramid, without cell gaps
+static const float kOverviewTileSize = 4.0f;
+static const float kMinMapZoom = 0.125f;
+static const float kMaxMapZoom = 128.0f;
+
+// Which part of the map the view shows
+struct MapCamera {
+    // The map position at the view's top-left corner, in cells
+    float x = 0.0f;
+    float y = 0.0f;
+    // Pixels per tile
+    float zoom = 16.0f;
+};
+
+// Draws a level grid into the current ImGui window without a widget per cell.
+//
+// The view fills the window's content region with one invisible button and shows the map through
+// a MapCamera: the mouse wheel zooms around the cursor, easing towards the new zoom over a few
+// frames, the middle button drags the map, and while the window has focus the arrow keys pan,
+// +/- zoom and Home fits the map to the view. Only the cells inside the view are drawn, and clicks
+// are mapped back to cells arithmetically.
+//
+// With a renderer set, the visible cells are drawn once into a cached SDL render target, which is
+// then shown as a single textured quad. The cache is redrawn in full only when the visible range
+// or tile size changes; otherwise just the cells passed to InvalidateCell are redrawn, so a frame
+// where nothing changed costs one quad. Without a renderer, or when render targets aren't
+// available, the visible cells are sorted by tile id and emitted as quads into the window's draw
+// list instead, where tiles on the same atlas page merge into one draw command. Either way a
+// frame costs at most O(visible cells), however big the map is.
+//
+// Zoomed out below kOverviewTileSize, a single tile covers too few pixels to be worth drawing, so
+// the view draws the coarsest MapOverview level that still has a cell per pixel instead, uploaded
+// to a streaming texture when it changes. That keeps a zoomed-out frame at O(window pixels) rather
+// than O(visible cells).
+class TileMapView {
+public:
+    TileMapView() = default;
+    ~TileMapView();
+    TileMapView(const TileMapView&) = delete;
+    TileMapView& operator=(const TileMapView&) = delete;
+
+    // Enables the cached render target and overview texture; pass nullptr to go back to emitting quads
+    void SetRenderer(SDL_Renderer* renderer);
+    // Frees the render target and overview texture; must run while the renderer is still alive
+    void ReleaseRenderTarget();
+
+    // Shows the map in the rest of the window, camera zoom pixels per cell plus a 1 pixel gap from
+    // kOverviewTileSize up, and appends every cell the mouse painted over this frame to painted.
+    void Draw(const LevelGrid& grid, const TextureRegistry& textures, std::vector<TileCoordinate>& painted);
+
+    const MapCamera& Camera() const { return camera; }
+    void SetCamera(const MapCamera& camera);
+    // Zooms around the middle of the view right away
+    void SetZoom(float zoom);
+    // Centres the whole map in the view, as big as it fits, on the next Draw
+    void FitToMap() { fitPending = true; }
+    // The camera is still moving without input, so another frame is needed
+    bool IsAnimating() const { return camera.zoom != targetZoom || keyPanning; }
+
+    // The cell's tile changed and has to be redrawn
+    void InvalidateCell(int x, int y);
+    // Everything has to be redrawn, e.g. after a load or when tile ids were mapped to other textures
+    void InvalidateAll();
+    // The cells showing these ids have to be redrawn, e.g. after their textures were loaded or
+    // evicted; costs a pass over the cached cells instead of redrawing them all
+    void InvalidateTileTextures(const LevelGrid& grid, const std::vector<short>& ids);
+    // These ids' average colours changed, so the overview cells that use them have to be recomputed
+    void InvalidateTileColors(const std::vector<short>& ids) { overview.InvalidateTileColors(ids); }
+
+    int VisibleCellCount() const { return visibleCellCount; }
+    // Cells drawn last frame: every visible cell without the cache, only the changed ones with it
+    int DrawnCellCount() const { return drawnCellCount; }
+    bool IsCached() const { return renderTarget != nullptr; }
+    // The pyramid level drawn last frame, or -1 when the tiles themselves were drawn
+    int OverviewLevel() const { return overviewLevel; }
+    size_t OverviewMemoryUsage() const { return overview.MemoryUsage(); }
+    // The cell under the mouse, if it's over the map
+    bool HoveredCell(TileCoordinate& cell) const;
+    // Sets ids to the distinct tile ids in the cells drawn last frame; empty when the overview was drawn
+    void CollectVisibleTileIds(const LevelGrid& grid, std::vector<short>& ids);
+
+private:
+    struct VisibleTile {
+        short id;
+        int x;
+        int y;
+    };
+
+    struct CellRange {
+        int firstX;
+        int firstY;
+        int lastX;
+        int lastY;
+    };
+
+    // Queues one cell of the render target for redrawing
+    void InvalidateTargetCell(int x, int y);
+    void UpdateCamera(const LevelGrid& grid, ImVec2 viewMin, bool active);
+    // Eases the zoom towards zoom, keeping the map point under anchor (relative to the view) in place
+    void ZoomTowards(float zoom, ImVec2 anchor);
+    void ClampCamera(const LevelGrid& grid);
+
+    void DrawQuads(const LevelGrid& grid, const CellRange& range, ImVec2 origin, float tileSize, const TextureRegistry& textures);
+    // Brings the render target up to date with the grid; false if the target can't be used
+    bool UpdateRenderTarget(const LevelGrid& grid, const CellRange& range, float tileSize, const TextureRegistry& textures);
+    void RenderCell(int x, int y, short id, const TextureRegistry& textures);
+    void DrawOverview(const LevelGrid& grid, const CellRange& range, ImVec2 origin, float tileSize, const TextureRegistry& textures);
+    // Uploads a width x height block of overviewPixels; false if the texture can't be used
+    bool UpdateOverviewTexture(int width, int height);
+
+    // Steps from the last painted cell to (x, y) so a fast drag doesn't leave gaps
+    void PaintLine(int x, int y, std::vector<TileCoordinate>& painted);
+
+    MapCamera camera;
+    float targetZoom = camera.zoom;
+    ImVec2 zoomAnchor = ImVec2(0.0f, 0.0f);
+    ImVec2 viewSize = ImVec2(1.0f, 1.0f);
+    bool fitPending = false;
+    bool keyPanning = false;
+
+    std::vector<VisibleTile> visibleTiles;
+    // The cells drawn as tiles last frame
+    CellRange tileRange = {0, 0, 0, 0};
+    std::vector<unsigned char> seenIds;
+    std::vector<short> scratchRow;
+    int visibleCellCount = 0;
+    int drawnCellCount = 0;
+    bool hovered = false;
+    TileCoordinate hoveredCell = {0, 0};
+    bool painting = false;
+    TileCoordinate lastPainted = {0, 0};
+
+    SDL_Renderer* renderer = nullptr;
+    SDL_Texture* renderTarget = nullptr;
+    int renderTargetWidth = 0;
+    int renderTargetHeight = 0;
+    // What the render target currently shows
+    CellRange cachedRange = {0, 0, 0, 0};
+    float cachedTileSize = 0.0f;
+    float cachedScale = 0.0f;
+    // Pixels of the render target per ImGui unit, for high-DPI displays
+    float pixelScale = 1.0f;
+    std::vector<TileCoordinate> invalidCells;
+    bool allInvalid = true;
+    // Atlas pages whose blend mode was switched off while copying tiles into the target
+    std::vector<SDL_Texture*> copiedTextures;
+
+    MapOverview overview;
+    int overviewLevel = -1;
+    std::vector<uint32_t> overviewPixels;
+    SDL_Texture* overviewTexture = nullptr;
+    int overviewTextureWidth = 0;
+    int overviewTextureHeight = 0;
+    // What the overview texture currently shows
+    CellRange overviewRange = {0, 0, 0, 0};
+    int overviewTextureLevel = -1;
+    unsigned overviewRevision = 0;
+};
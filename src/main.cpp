@@ -1,5 +1,80 @@
 #include "Application.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 
-int main() {
-    Application application(1280, 720);
-}
\ No newline at end of file
+static void PrintUsage() {
+    fprintf(stderr,
+            "Usage: mini-fps-level-editor [--size WxH] [--level FILE] [--textures PNG...]\n"
+            "                             [--texture-cache FILE | --no-texture-cache]\n"
+            "                             [--headless [--scenario idle|pan|zoom|paint] [--frames N]\n"
+            "                              [--timings CSV] [--captures DIR] [--capture-every N]]\n");
+}
+
+static bool ParseOptions(int argc, char** argv, EditorOptions& options) {
+    bool textureCacheGiven = false;
+    for (int i = 1; i < argc; i++) {
+        const char* argument = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if (strcmp(argument, "--size") == 0 && hasValue) {
+            if (sscanf(argv[++i], "%dx%d", &options.width, &options.height) != 2 || options.width <= 0 || options.height <= 0) {
+                fprintf(stderr, "Invalid size: %s\n", argv[i]);
+                return false;
+            }
+        } else if (strcmp(argument, "--level") == 0 && hasValue) {
+            options.levelPath = argv[++i];
+        } else if (strcmp(argument, "--textures") == 0) {
+            // Every path up to the next option
+            while (i + 1 < argc && argv[i + 1][0] != '-') {
+                options.texturePaths.push_back(argv[++i]);
+            }
+        } else if (strcmp(argument, "--texture-cache") == 0 && hasValue) {
+            options.textureCachePath = argv[++i];
+            textureCacheGiven = true;
+        } else if (strcmp(argument, "--no-texture-cache") == 0) {
+            options.textureCachePath.clear();
+            textureCacheGiven = true;
+        } else if (strcmp(argument, "--headless") == 0) {
+            options.headless = true;
+        } else if (strcmp(argument, "--scenario") == 0 && hasValue) {
+            if (!ParseHeadlessScenario(argv[++i], options.scenario)) {
+                fprintf(stderr, "Unknown scenario: %s\n", argv[i]);
+                return false;
+            }
+        } else if (strcmp(argument, "--frames") == 0 && hasValue) {
+            options.frameCount = atoi(argv[++i]);
+            if (options.frameCount <= 0) {
+                fprintf(stderr, "Invalid frame count: %s\n", argv[i]);
+                return false;
+            }
+        } else if (strcmp(argument, "--timings") == 0 && hasValue) {
+            options.timingsPath = argv[++i];
+        } else if (strcmp(argument, "--captures") == 0 && hasValue) {
+            options.captureDirectory = argv[++i];
+        } else if (strcmp(argument, "--capture-every") == 0 && hasValue) {
+            options.captureInterval = atoi(argv[++i]);
+        } else {
+            fprintf(stderr, "Unknown option: %s\n", argument);
+            return false;
+        }
+    }
+
+    // A cache left warm by an earlier run would make frame times depend on what ran before
+    if (options.headless && !textureCacheGiven) {
+        options.textureCachePath.clear();
+    }
+
+    return true;
+}
+
+int main(int argc, char** argv) {
+    EditorOptions options;
+    if (!ParseOptions(argc, argv, options)) {
+        PrintUsage();
+        return 2;
+    }
+
+    Application application(options);
+    return application.ExitCode();
+}
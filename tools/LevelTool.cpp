@@ -0,0 +1,558 @@
+// Headless level tool for the asset pipeline: converts, validates, summarises and dumps level files
+// without SDL. Directories are expanded to the .lvl files inside them, and files are processed in
+// parallel. Every command but dump and region ends with a throughput line for CI logs.
+//
+// Usage:
+//   lvltool convert [--to text|binary|compressed] [--output DIR] [-j N] PATH...
+//   lvltool validate [-j N] PATH...
+//   lvltool stats [-j N] PATH...
+//   lvltool dump [--tiles] FILE
+//   lvltool region X Y WIDTH HEIGHT FILE
+
+#include "LevelFile.h"
+#include "MappedFile.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <string>
+#include <sys/stat.h>
+#include <thread>
+#include <vector>
+
+enum class Command {
+    Convert,
+    Validate,
+    Stats,
+    Dump,
+    Region
+};
+
+struct Options {
+    Command command = Command::Validate;
+    LevelFormat convertFormat = LevelFormat::Binary;
+    std::string outputDirectory;
+    unsigned threadCount = 0;
+    bool dumpTiles = false;
+    // x, y, width and height of the tiles region prints
+    int region[4] = {0, 0, 0, 0};
+    std::vector<std::string> paths;
+};
+
+// What one worker found out about one file; printed in input order once every file is done
+struct FileResult {
+    bool succeeded = false;
+    std::string report;
+    unsigned long long bytesRead = 0;
+    unsigned long long cells = 0;
+};
+
+static double SecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static unsigned long long FileSize(const std::string& filePath) {
+    struct stat fileStat;
+    return stat(filePath.c_str(), &fileStat) == 0 ? static_cast<unsigned long long>(fileStat.st_size) : 0;
+}
+
+static bool EndsWith(const std::string& text, const char* suffix) {
+    size_t length = strlen(suffix);
+    return text.size() >= length && text.compare(text.size() - length, length, suffix) == 0;
+}
+
+static const char* FormatName(LevelFormat format) {
+    switch (format) {
+        case LevelFormat::Text:
+            return "text";
+        case LevelFormat::Binary:
+            return "binary";
+        case LevelFormat::CompressedBinary:
+            return "compressed";
+    }
+
+    return "unknown";
+}
+
+static bool ParseFormat(const char* name, LevelFormat& format) {
+    const LevelFormat formats[] = {LevelFormat::Text, LevelFormat::Binary, LevelFormat::CompressedBinary};
+    for (LevelFormat candidate : formats) {
+        if (strcmp(name, FormatName(candidate)) == 0) {
+            format = candidate;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static void PrintUsage() {
+    fprintf(stderr,
+            "Usage:\n"
+            "  lvltool convert [--to text|binary|compressed] [--output DIR] [-j N] PATH...\n"
+            "  lvltool validate [-j N] PATH...\n"
+            "  lvltool stats [-j N] PATH...\n"
+            "  lvltool dump [--tiles] FILE\n"
+            "  lvltool region X Y WIDTH HEIGHT FILE\n"
+            "Directories are searched recursively for .lvl files. --output keeps each file's path below the\n"
+            "directory it was found under.\n");
+}
+
+static bool ParseOptions(int argc, char** argv, Options& options) {
+    if (argc < 3) {
+        return false;
+    }
+
+    const char* command = argv[1];
+    if (strcmp(command, "convert") == 0) {
+        options.command = Command::Convert;
+    } else if (strcmp(command, "validate") == 0) {
+        options.command = Command::Validate;
+    } else if (strcmp(command, "stats") == 0) {
+        options.command = Command::Stats;
+    } else if (strcmp(command, "dump") == 0) {
+        options.command = Command::Dump;
+    } else if (strcmp(command, "region") == 0) {
+        options.command = Command::Region;
+    } else {
+        fprintf(stderr, "Unknown command: %s\n", command);
+        return false;
+    }
+
+    for (int i = 2; i < argc; i++) {
+        const char* argument = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if (strcmp(argument, "--to") == 0 && hasValue && options.command == Command::Convert) {
+            if (!ParseFormat(argv[++i], options.convertFormat)) {
+                fprintf(stderr, "Unknown format: %s\n", argv[i]);
+                return false;
+            }
+        } else if (strcmp(argument, "--output") == 0 && hasValue && options.command == Command::Convert) {
+            options.outputDirectory = argv[++i];
+        } else if (strcmp(argument, "-j") == 0 && hasValue) {
+            options.threadCount = static_cast<unsigned>(atoi(argv[++i]));
+        } else if (strcmp(argument, "--tiles") == 0 && options.command == Command::Dump) {
+            options.dumpTiles = true;
+        } else if (argument[0] == '-') {
+            fprintf(stderr, "Unknown option: %s\n", argument);
+            return false;
+        } else {
+            options.paths.push_back(argument);
+        }
+    }
+
+    if (options.command == Command::Dump && options.paths.size() != 1) {
+        fprintf(stderr, "dump takes exactly one file\n");
+        return false;
+    }
+
+    if (options.command == Command::Region) {
+        if (options.paths.size() != 5) {
+            fprintf(stderr, "region takes a position, a size and one file\n");
+            return false;
+        }
+
+        for (int i = 0; i < 4; i++) {
+            char* end;
+            errno = 0;
+            long value = strtol(options.paths[i].c_str(), &end, 10);
+            if (*end != '\0' || end == options.paths[i].c_str() || errno != 0 || value < 0 || value > INT_MAX) {
+                fprintf(stderr, "Not a tile count: %s\n", options.paths[i].c_str());
+                return false;
+            }
+            options.region[i] = static_cast<int>(value);
+        }
+        options.paths.erase(options.paths.begin(), options.paths.begin() + 4);
+    }
+
+    return !options.paths.empty();
+}
+
+// Level files are .lvl; the editor's journals and half-written saves sit next to them under other names.
+// Each file's path relative to the directory argument it was found under goes to relativePaths, or
+// its name alone if it was given as a file.
+static void CollectLevelFiles(const std::string& path, const std::string& relativePath, std::vector<std::string>& files,
+                              std::vector<std::string>& relativePaths) {
+    struct stat pathStat;
+    if (stat(path.c_str(), &pathStat) != 0 || !S_ISDIR(pathStat.st_mode)) {
+        size_t slash = path.find_last_of('/');
+        files.push_back(path);
+        relativePaths.push_back(!relativePath.empty() ? relativePath : slash == std::string::npos ? path : path.substr(slash + 1));
+        return;
+    }
+
+    DIR* directory = opendir(path.c_str());
+    if (directory == nullptr) {
+        fprintf(stderr, "Could not open directory %s: %s\n", path.c_str(), strerror(errno));
+        return;
+    }
+
+    std::vector<std::string> entries;
+    while (dirent* entry = readdir(directory)) {
+        if (entry->d_name[0] != '.') {
+            entries.push_back(entry->d_name);
+        }
+    }
+    closedir(directory);
+
+    // Sorted so reports come out in the same order on every machine
+    std::sort(entries.begin(), entries.end());
+
+    for (const std::string& name : entries) {
+        std::string entryPath = path + "/" + name;
+        std::string entryRelativePath = relativePath.empty() ? name : relativePath + "/" + name;
+        struct stat entryStat;
+        if (stat(entryPath.c_str(), &entryStat) != 0) {
+            continue;
+        }
+
+        if (S_ISDIR(entryStat.st_mode)) {
+            CollectLevelFiles(entryPath, entryRelativePath, files, relativePaths);
+        } else if (S_ISREG(entryStat.st_mode) && EndsWith(name, ".lvl")) {
+            files.push_back(entryPath);
+            relativePaths.push_back(entryRelativePath);
+        }
+    }
+}
+
+// Creates the directory at path and any missing parents
+static bool CreateDirectories(const std::string& path, std::string& error) {
+    for (size_t slash = path.find('/', 1); ; slash = path.find('/', slash + 1)) {
+        std::string prefix = path.substr(0, slash);
+        if (!prefix.empty() && mkdir(prefix.c_str(), 0777) != 0 && errno != EEXIST) {
+            error = "Could not create directory " + prefix + ": " + strerror(errno);
+            return false;
+        }
+        if (slash == std::string::npos) {
+            return true;
+        }
+    }
+}
+
+// Where each file is converted to: in place, or its path under the directory argument it was found
+// under, mirrored into the output directory. Fails if two files would be written to the same place.
+static bool PlanOutputPaths(const Options& options, const std::vector<std::string>& files, const std::vector<std::string>& relativePaths,
+                            std::vector<std::string>& outputPaths) {
+    outputPaths.clear();
+    for (size_t i = 0; i < files.size(); i++) {
+        outputPaths.push_back(options.outputDirectory.empty() ? files[i] : options.outputDirectory + "/" + relativePaths[i]);
+    }
+
+    std::vector<size_t> order(files.size());
+    for (size_t i = 0; i < order.size(); i++) {
+        order[i] = i;
+    }
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return outputPaths[a] < outputPaths[b]; });
+    for (size_t i = 1; i < order.size(); i++) {
+        if (outputPaths[order[i]] == outputPaths[order[i - 1]]) {
+            fprintf(stderr, "%s and %s would both be converted to %s\n", files[order[i - 1]].c_str(), files[order[i]].c_str(),
+                    outputPaths[order[i]].c_str());
+            return false;
+        }
+    }
+
+    // Made up front so workers don't race to create the same directories
+    for (const std::string& outputPath : outputPaths) {
+        size_t slash = outputPath.find_last_of('/');
+        std::string error;
+        if (slash != std::string::npos && slash != 0 && !CreateDirectories(outputPath.substr(0, slash), error)) {
+            fprintf(stderr, "%s\n", error.c_str());
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool LoadForTool(const std::string& filePath, Level& level, LevelFormat& format, FileResult& result) {
+    std::string error;
+    if (!DetectLevelFormat(filePath.c_str(), format, error) || !LoadLevelFile(filePath.c_str(), level, error)) {
+        result.report = filePath + ": " + error;
+        return false;
+    }
+
+    result.bytesRead = FileSize(filePath);
+    result.cells = level.grid.CellCount();
+    return true;
+}
+
+static void ConvertFile(const std::string& filePath, const std::string& outputPath, const Options& options, FileResult& result) {
+    Level level;
+    LevelFormat format;
+    if (!LoadForTool(filePath, level, format, result)) {
+        return;
+    }
+
+    // SaveLevelFile renames a finished temporary file into place, so converting in place is safe
+    std::string error;
+    if (!SaveLevelFile(outputPath.c_str(), level, options.convertFormat, error)) {
+        result.report = filePath + ": " + error;
+        return;
+    }
+
+    result.succeeded = true;
+    result.report = filePath + ": " + FormatName(format) + " -> " + FormatName(options.convertFormat) + " " + outputPath +
+                    " (" + std::to_string(result.bytesRead) + " -> " + std::to_string(FileSize(outputPath)) + " bytes)";
+}
+
+// Loading already checks the file's structure; this checks that what it describes makes sense
+static void ValidateFile(const std::string& filePath, FileResult& result) {
+    Level level;
+    LevelFormat format;
+    if (!LoadForTool(filePath, level, format, result)) {
+        return;
+    }
+
+    std::vector<bool> mappedIds(65536, false);
+    std::vector<std::string> problems;
+
+    for (const auto& entry : level.textureNameToTextureIdMap) {
+        uint16_t id = static_cast<uint16_t>(entry.second);
+        if (entry.second <= 0) {
+            problems.push_back("texture \"" + entry.first + "\" has id " + std::to_string(entry.second) + ", which tiles can't use");
+        } else if (mappedIds[id]) {
+            problems.push_back("texture id " + std::to_string(entry.second) + " is used by more than one texture");
+        }
+        mappedIds[id] = true;
+    }
+
+    const LevelGrid& grid = level.grid;
+    std::vector<short> scratch(static_cast<size_t>(grid.Width()));
+    std::vector<bool> reportedIds(65536, false);
+
+    for (int y = 0; y < grid.Height(); y++) {
+        const short* row = grid.ReadRow(y, scratch.data());
+        for (int x = 0; x < grid.Width(); x++) {
+            uint16_t id = static_cast<uint16_t>(row[x]);
+            if (row[x] != 0 && !mappedIds[id] && !reportedIds[id]) {
+                reportedIds[id] = true;
+                problems.push_back("tile id " + std::to_string(row[x]) + " at (" + std::to_string(x) + ", " + std::to_string(y) +
+                                   ") has no texture");
+            }
+        }
+    }
+
+    for (size_t i = 0; i < level.enemySpawnLocations.size(); i++) {
+        const EnemySpawnLocation& location = level.enemySpawnLocations[i];
+        if (!(location.x >= 0.0f && location.y >= 0.0f && location.x <= grid.Width() && location.y <= grid.Height())) {
+            problems.push_back("spawn " + std::to_string(i) + " is outside the map");
+        }
+    }
+
+    result.succeeded = problems.empty();
+    result.report = filePath + ": " + (problems.empty() ? "ok" : std::to_string(problems.size()) + " problem(s)");
+    for (const std::string& problem : problems) {
+        result.report += "\n    " + problem;
+    }
+}
+
+static void StatsFile(const std::string& filePath, FileResult& result) {
+    Level level;
+    LevelFormat format;
+    if (!LoadForTool(filePath, level, format, result)) {
+        return;
+    }
+
+    const LevelGrid& grid = level.grid;
+    std::vector<short> scratch(static_cast<size_t>(grid.Width()));
+    std::vector<bool> seenIds(65536, false);
+    unsigned long long nonEmptyCells = 0;
+    size_t distinctIds = 0;
+
+    for (int y = 0; y < grid.Height(); y++) {
+        const short* row = grid.ReadRow(y, scratch.data());
+        for (int x = 0; x < grid.Width(); x++) {
+            uint16_t id = static_cast<uint16_t>(row[x]);
+            nonEmptyCells += row[x] != 0;
+            if (row[x] != 0 && !seenIds[id]) {
+                seenIds[id] = true;
+                distinctIds++;
+            }
+        }
+    }
+
+    // How much of the map a chunked grid would have to allocate
+    LevelGrid chunked = grid;
+    chunked.SetLayout(LevelGridLayout::Chunked);
+    size_t totalChunks = static_cast<size_t>(chunked.ChunkColumns()) * chunked.ChunkRows();
+
+    char line[512];
+    snprintf(line, sizeof(line),
+             "%s: %s, %dx%d, %llu bytes, %llu non-empty cells (%.1f%%), %zu tile ids, %zu spawns, %zu textures, %zu/%zu chunks used",
+             filePath.c_str(), FormatName(format), grid.Width(), grid.Height(), result.bytesRead, nonEmptyCells,
+             grid.CellCount() != 0 ? 100.0 * nonEmptyCells / grid.CellCount() : 0.0, distinctIds,
+             level.enemySpawnLocations.size(), level.textureNameToTextureIdMap.size(),
+             chunked.AllocatedChunkCount(), totalChunks);
+
+    result.succeeded = true;
+    result.report = line;
+}
+
+static int Dump(const Options& options) {
+    const std::string& filePath = options.paths[0];
+    Level level;
+    LevelFormat format;
+    FileResult result;
+    if (!LoadForTool(filePath, level, format, result)) {
+        fprintf(stderr, "%s\n", result.report.c_str());
+        return 1;
+    }
+
+    printf("file: %s\n", filePath.c_str());
+    printf("format: %s\n", FormatName(format));
+
+    if (format != LevelFormat::Text) {
+        MappedFile file;
+        std::string error;
+        BinaryLevelHeader header;
+        if (file.Open(filePath.c_str(), false, error) && ReadBinaryLevelHeader(file.Data(), file.Size(), header, error)) {
+            printf("version: %u\n", header.version);
+            printf("tile encoding: %s\n", header.tileEncoding == BinaryTileEncoding_Chunked ? "chunked" : "raw");
+            printf("tile block: offset %llu, %llu bytes\n", static_cast<unsigned long long>(header.tileOffset),
+                   static_cast<unsigned long long>(header.tileSize));
+            printf("spawn table: offset %llu\n", static_cast<unsigned long long>(header.spawnOffset));
+            printf("texture table: offset %llu, %llu bytes\n", static_cast<unsigned long long>(header.textureOffset),
+                   static_cast<unsigned long long>(header.textureSize));
+        }
+    }
+
+    const LevelGrid& grid = level.grid;
+    printf("size: %dx%d\n", grid.Width(), grid.Height());
+
+    printf("spawns: %zu\n", level.enemySpawnLocations.size());
+    for (const EnemySpawnLocation& location : level.enemySpawnLocations) {
+        printf("  texture %d at (%g, %g)\n", location.textureId, location.x, location.y);
+    }
+
+    printf("textures: %zu\n", level.textureNameToTextureIdMap.size());
+    for (const auto& entry : level.textureNameToTextureIdMap) {
+        printf("  %d %s\n", entry.second, entry.first.c_str());
+    }
+
+    if (options.dumpTiles) {
+        std::vector<short> scratch(static_cast<size_t>(grid.Width()));
+        for (int y = 0; y < grid.Height(); y++) {
+            const short* row = grid.ReadRow(y, scratch.data());
+            for (int x = 0; x < grid.Width(); x++) {
+                printf(x == 0 ? "%d" : " %d", row[x]);
+            }
+            printf("\n");
+        }
+    }
+
+    return 0;
+}
+
+// Prints part of a level's tiles, decoding only the chunks it covers
+static int Region(const Options& options) {
+    const std::string& filePath = options.paths[0];
+    LevelGrid region;
+    std::string error;
+    if (!LoadLevelRegion(filePath.c_str(), options.region[0], options.region[1], options.region[2], options.region[3], region, error)) {
+        fprintf(stderr, "%s: %s\n", filePath.c_str(), error.c_str());
+        return 1;
+    }
+
+    std::vector<short> scratch(static_cast<size_t>(region.Width()));
+    for (int y = 0; y < region.Height(); y++) {
+        const short* row = region.ReadRow(y, scratch.data());
+        for (int x = 0; x < region.Width(); x++) {
+            printf(x == 0 ? "%d" : " %d", row[x]);
+        }
+        printf("\n");
+    }
+
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!ParseOptions(argc, argv, options)) {
+        PrintUsage();
+        return 2;
+    }
+
+    if (options.command == Command::Dump) {
+        return Dump(options);
+    }
+    if (options.command == Command::Region) {
+        return Region(options);
+    }
+
+    std::vector<std::string> files;
+    std::vector<std::string> relativePaths;
+    for (const std::string& path : options.paths) {
+        CollectLevelFiles(path, std::string(), files, relativePaths);
+    }
+
+    if (files.empty()) {
+        fprintf(stderr, "No level files found\n");
+        return 1;
+    }
+
+    std::vector<std::string> outputPaths;
+    if (options.command == Command::Convert && !PlanOutputPaths(options, files, relativePaths, outputPaths)) {
+        return 1;
+    }
+
+    unsigned threadCount = options.threadCount != 0 ? options.threadCount : std::thread::hardware_concurrency();
+    threadCount = std::max(1u, std::min(threadCount, static_cast<unsigned>(files.size())));
+
+    std::vector<FileResult> results(files.size());
+    std::atomic<size_t> nextFile(0);
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    // Files vary a lot in size, so workers take the next file as they finish rather than a fixed share
+    auto work = [&]() {
+        for (size_t i = nextFile++; i < files.size(); i = nextFile++) {
+            switch (options.command) {
+                case Command::Convert:
+                    ConvertFile(files[i], outputPaths[i], options, results[i]);
+                    break;
+                case Command::Validate:
+                    ValidateFile(files[i], results[i]);
+                    break;
+                case Command::Stats:
+                    StatsFile(files[i], results[i]);
+                    break;
+                case Command::Dump:
+                case Command::Region:
+                    break;
+            }
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (unsigned i = 1; i < threadCount; i++) {
+        workers.emplace_back(work);
+    }
+    work();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+
+    double seconds = SecondsSince(start);
+
+    size_t failures = 0;
+    unsigned long long bytesRead = 0;
+    unsigned long long cells = 0;
+    for (const FileResult& result : results) {
+        fprintf(result.succeeded ? stdout : stderr, "%s\n", result.report.c_str());
+        failures += !result.succeeded;
+        bytesRead += result.bytesRead;
+        cells += result.cells;
+    }
+
+    printf("%zu files, %zu failed, %.3f s on %u threads: %.1f files/s, %.1f MiB/s, %.1f Mcells/s\n",
+           files.size(), failures, seconds, threadCount, files.size() / seconds,
+           bytesRead / (1024.0 * 1024.0) / seconds, cells / 1e6 / seconds);
+
+    return failures == 0 ? 0 : 1;
+}